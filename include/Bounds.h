@@ -0,0 +1,62 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm/glm.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// Axis-aligned bounding box. A default-constructed box is empty (min > max).
+struct AABB {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    bool isEmpty() const { return min.x > max.x; }
+
+    void expand(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void expand(const AABB& other) {
+        if (other.isEmpty()) return;
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extents() const { return (max - min) * 0.5f; }
+
+    // The box around this box after transforming it (Arvo's method: no corner loop)
+    AABB transformed(const glm::mat4& matrix) const {
+        if (isEmpty()) return *this;
+        glm::vec3 c = glm::vec3(matrix * glm::vec4(center(), 1.0f));
+        glm::vec3 e = extents();
+        glm::vec3 worldExtents;
+        for (int row = 0; row < 3; ++row) {
+            worldExtents[row] = std::abs(matrix[0][row]) * e.x + std::abs(matrix[1][row]) * e.y + std::abs(matrix[2][row]) * e.z;
+        }
+        AABB result;
+        result.min = c - worldExtents;
+        result.max = c + worldExtents;
+        return result;
+    }
+};
+
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+
+    // The sphere after transforming it; non-uniform scale grows it by the largest axis
+    BoundingSphere transformed(const glm::mat4& matrix) const {
+        float scaleX = glm::dot(glm::vec3(matrix[0]), glm::vec3(matrix[0]));
+        float scaleY = glm::dot(glm::vec3(matrix[1]), glm::vec3(matrix[1]));
+        float scaleZ = glm::dot(glm::vec3(matrix[2]), glm::vec3(matrix[2]));
+        BoundingSphere result;
+        result.center = glm::vec3(matrix * glm::vec4(center, 1.0f));
+        result.radius = radius * std::sqrt(std::max(scaleX, std::max(scaleY, scaleZ)));
+        return result;
+    }
+};
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "Component.h"
 #include "Entity.h"
+#include "Reflection.h"
 #include <glm/glm/glm.hpp>
 #include <glm/glm/gtc/matrix_transform.hpp>
 #include <GLFW/glfw3.h> // Added GLFW include for deserialization
@@ -31,23 +32,12 @@ public:
         return glm::perspective(glm::radians(fov), aspectRatio, nearPlane, farPlane);
     }
 
-    static std::shared_ptr<Component> deserialize(std::istringstream& iss, GLFWwindow* window) {
-        float fov = 45.0f;
-        float aspect = 800.0f / 600.0f;
-        float nearP = 0.1f;
-        float farP = 100.0f;
-        
-        // Read up to 4 values
-        if (iss >> fov) {
-            if (iss >> aspect) {
-                if (iss >> nearP) {
-                    iss >> farP;
-                }
-            }
-        }
-        
-        return std::make_shared<CameraComponent>(fov, aspect, nearP, farP);
-    }
+    // Scene file: [fov [aspectRatio [nearPlane [farPlane]]]]
+    REFLECT_COMPONENT(CameraComponent,
+        REFLECT_FIELD(CameraComponent, fov),
+        REFLECT_FIELD(CameraComponent, aspectRatio),
+        REFLECT_FIELD(CameraComponent, nearPlane),
+        REFLECT_FIELD(CameraComponent, farPlane))
 };
 
 #endif
@@ -3,6 +3,7 @@
 
 #include "Component.h"
 #include "Entity.h"
+#include "Reflection.h"
 #include <vector>
 #include <algorithm>
 #include <glm/glm/glm.hpp>
@@ -14,10 +15,12 @@ public:
     static std::vector<ColliderComponent*> allColliders;
     
     // The width, height, and depth of the bounding box
-    glm::vec3 size; 
+    glm::vec3 size = glm::vec3(1.0f);
     
     // An optional flag so the bird doesn't check collision against itself
-    bool isTrigger; 
+    bool isTrigger = false;
+
+    ColliderComponent() {}
 
     ColliderComponent(glm::vec3 boundingBoxSize, bool trigger = false) 
         : size(boundingBoxSize), isTrigger(trigger) {}
@@ -49,16 +52,10 @@ public:
         return collisionX && collisionY;
     }
 
-    static std::shared_ptr<Component> deserialize(std::istringstream& iss, GLFWwindow* window) {
-        glm::vec3 size(1.0f);
-        bool isTrigger = false;
-        // The scene file will provide: width height depth [isTrigger]
-        iss >> size.x >> size.y >> size.z;
-        if (!iss.eof()) {
-            iss >> isTrigger;
-        }
-        return std::make_shared<ColliderComponent>(size, isTrigger);
-    }
+    // Scene file: width height depth [isTrigger]
+    REFLECT_COMPONENT(ColliderComponent,
+        REFLECT_FIELD(ColliderComponent, size),
+        REFLECT_FIELD(ColliderComponent, isTrigger))
 };
 
 #endif
\ No newline at end of file
@@ -1,8 +1,13 @@
 #ifndef COMPONENT_H
 #define COMPONENT_H
 
+#include <cstdint>
+
 // Forward declaration to avoid circular includes
-class Entity; 
+class Entity;
+struct GLFWwindow;
+struct AABB;
+namespace Reflection { struct TypeInfo; }
 
 class Component {
 public:
@@ -11,10 +16,25 @@ public:
     virtual ~Component() = default;
 
     // Called once when the component is attached to the entity
-    virtual void awake() {} 
+    virtual void awake() {}
 
     // Called every frame
-    virtual void update(float deltaTime) {} 
+    virtual void update(float deltaTime) {}
+
+    // Reflection table of the concrete component (see REFLECT_COMPONENT), or null if it has none
+    virtual const Reflection::TypeInfo* getTypeInfo() const { return nullptr; }
+
+    // Called after reflected fields were loaded from text or binary, before awake().
+    // loadedFields has one bit per field that was present in the source.
+    // Return false to reject the component (e.g. a required field was missing).
+    virtual bool onDeserialized(uint32_t loadedFields, GLFWwindow* window) { return true; }
+
+    // Components with a visible extent (like RendererComponent) fill in their
+    // local-space box and return true. Entity merges these into its subtree bounds.
+    virtual bool getLocalBounds(AABB& bounds) const { return false; }
+
+    // Called by Entity::updateSelfAndChild when the owner's world transform changed
+    virtual void onTransformChanged() {}
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -2,33 +2,82 @@
 #define COMPONENT_REGISTRY_H
 
 #include "Component.h"
+#include "Reflection.h"
 #include <functional>
 #include <map>
 #include <string>
 #include <memory>
 #include <sstream>
+#include <vector>
 #include <GLFW/glfw3.h> // Needed for components like FlapController
 
 // The signature for our creation functions
 using ComponentFactoryFunc = std::function<std::shared_ptr<Component>(std::istringstream&, GLFWwindow*)>;
 
+// Everything the registry needs to build a reflected component without knowing its type
+struct ReflectedComponentType {
+    const Reflection::TypeInfo* info;
+    std::shared_ptr<Component> (*construct)();
+};
+
 class ComponentRegistry {
 public:
     static std::map<std::string, ComponentFactoryFunc> map;
+    static std::map<std::string, ReflectedComponentType> types;
 
+    // Hand-written factory (for components that don't declare REFLECT_COMPONENT)
     static void registerComponent(const std::string& name, ComponentFactoryFunc func) {
         map[name] = func;
     }
 
+    // Reflected component: text and binary loading are generated from T's field table
+    template <typename T>
+    static void registerComponent(const std::string& name) {
+        types[name] = { &T::staticTypeInfo(), []() -> std::shared_ptr<Component> { return std::make_shared<T>(); } };
+    }
+
     static std::shared_ptr<Component> create(const std::string& name, std::istringstream& iss, GLFWwindow* window) {
+        auto reflected = types.find(name);
+        if (reflected != types.end()) {
+            auto component = reflected->second.construct();
+            uint32_t loaded = Reflection::readText(*reflected->second.info, dynamic_cast<void*>(component.get()), iss);
+            return component->onDeserialized(loaded, window) ? component : nullptr;
+        }
+
         if (map.find(name) != map.end()) {
             return map[name](iss, window); // Call the specific component's static function
         }
         return nullptr;
     }
+
+    static const ReflectedComponentType* findType(const std::string& name) {
+        auto it = types.find(name);
+        return it != types.end() ? &it->second : nullptr;
+    }
+
+    // Appends the component's binary blob (only fields that differ from its defaults).
+    // Returns false for components without a reflection table.
+    static bool writeBinary(const Component& component, std::vector<uint8_t>& out) {
+        const Reflection::TypeInfo* info = component.getTypeInfo();
+        if (!info) return false;
+        Reflection::writeBinary(*info, dynamic_cast<const void*>(&component), out);
+        return true;
+    }
+
+    // Builds a component from a blob written by writeBinary. No text is parsed:
+    // every stored field is copied straight into place.
+    static std::shared_ptr<Component> createFromBinary(const ReflectedComponentType& type, const uint8_t*& cursor, const uint8_t* end, GLFWwindow* window) {
+        auto component = type.construct();
+        uint32_t loaded = 0;
+        if (!Reflection::readBinary(*type.info, dynamic_cast<void*>(component.get()), cursor, end, &loaded)) {
+            return nullptr;
+        }
+        return component->onDeserialized(loaded, window) ? component : nullptr;
+    }
 };
 
-// Define the static map
+// Define the static maps
 inline std::map<std::string, ComponentFactoryFunc> ComponentRegistry::map;
+inline std::map<std::string, ReflectedComponentType> ComponentRegistry::types;
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,81 @@
+#ifndef DEFERRED_SHADING_H
+#define DEFERRED_SHADING_H
+
+#include <glm/glm/glm.hpp>
+#include <memory>
+#include <vector>
+#include "Shader.h"
+#include "ShaderVariants.h"
+#include "LightClusters.h"
+
+class Material;
+
+// The deferred pipeline of the Renderer (Renderer::deferredShading).
+//
+// Opaque meshes are drawn once with the geometry program, which writes what the
+// lighting needs into a G-buffer instead of shading: albedo and specular
+// intensity, the world normal and shininess, and depth. Then every light is
+// drawn as a box around its range, added up in a half-float buffer, and only
+// the pixels the box covers whose surface is within range are lit. A light costs the
+// pixels it covers, however many meshes are under it, instead of one loop
+// iteration in every fragment of every draw.
+//
+// The lit image and the G-buffer's depth end up in the framebuffer that was
+// bound before, so whatever is drawn forward afterwards (transparent packets,
+// impostors, debug wireframes) depth tests against the scene as usual.
+// Everything is GL 3.3; on 4.3 the geometry program reads TransformData, so the
+// Renderer's instancing, meshlet runs and GPU culling keep working.
+class DeferredShading {
+public:
+    // Reflection of the surface in the ambient term of the lighting pass
+    static constexpr float Ambient = 0.1f;
+
+    // Builds the programs and the light box on first use. False if they didn't compile.
+    bool init();
+
+    // The program a material's opaque meshes are drawn with during the geometry pass: the
+    // variant for the maps it has, built on first use. It reads the material the same way
+    // material shaders do (see Material::apply).
+    Shader& getGeometryShader(const Material& material);
+
+    // Binds the G-buffer (sized to cover the current viewport), clears it and turns the
+    // stencil test on for light() to turn off. False if the framebuffer can't be made,
+    // in which case nothing is bound.
+    bool beginGeometry();
+
+    // Lights the G-buffer into the previous framebuffer: instanced draws of boxes sum the
+    // lights (one draw for the boxes the camera is outside of, one for those around it),
+    // then a full-screen pass adds the ambient term and copies the depth. Returns how
+    // many lights were drawn. Leaves the depth test as GL_LESS.
+    unsigned int light(const std::vector<ClusterLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+                       const glm::vec3& viewPos, float nearPlane, float farPlane);
+
+private:
+    bool resize(int width, int height);
+
+    // Deletes the G-buffer and light framebuffers with their attachments
+    void deleteTargets();
+
+    std::shared_ptr<ShaderVariants> m_geometryShaders;
+    std::shared_ptr<Shader> m_compositeShader;
+    std::shared_ptr<Shader> m_lightShader;
+
+    unsigned int m_framebuffer = 0;
+    unsigned int m_albedoSpecular = 0;  // RGBA8: albedo, specular intensity
+    unsigned int m_normalShininess = 0; // RGBA16F: world normal, shininess
+    unsigned int m_depth = 0;           // DEPTH24_STENCIL8, stencil 1 where something was drawn
+    unsigned int m_lightFramebuffer = 0;
+    unsigned int m_lightSum = 0;        // RGBA16F: the lights added up
+    unsigned int m_lightDepth = 0;      // Copy of the depth and stencil the light boxes test against
+    int m_width = 0, m_height = 0;
+    int m_previousFramebuffer = 0;
+
+    unsigned int m_emptyVAO = 0;                   // The composite pass's triangle comes from gl_VertexID
+    unsigned int m_boxVAO = 0, m_boxVBO = 0, m_boxEBO = 0;
+    unsigned int m_instanceVBO = 0;                // One ClusterLight per box
+    std::vector<ClusterLight> m_volumes;           // Lights that reach anything, ranges clamped
+    std::vector<ClusterLight> m_insideVolumes;     // Those whose box holds the camera, appended last
+    bool m_initialized = false;
+};
+
+#endif
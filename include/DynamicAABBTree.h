@@ -0,0 +1,130 @@
+#ifndef DYNAMIC_AABB_TREE_H
+#define DYNAMIC_AABB_TREE_H
+
+#include "Bounds.h"
+#include "Frustum.h"
+#include <vector>
+
+// A dynamic bounding volume hierarchy over boxes (a port of the Box2D b2DynamicTree idea to 3D).
+// Every object is a leaf ("proxy") whose box is fattened by a margin, so small moves
+// don't touch the tree at all; only an object that leaves its fat box is reinserted.
+// Insertion picks the cheapest sibling by surface area, and AVL rotations keep the
+// tree balanced, so a frustum query visits far fewer nodes than there are objects.
+class DynamicAABBTree {
+public:
+    static constexpr int Null = -1;
+
+    explicit DynamicAABBTree(float margin = 0.1f) : margin(margin) {}
+
+    // Adds an object and returns its proxy ID
+    int createProxy(const AABB& box, void* userData);
+    void destroyProxy(int proxy);
+
+    // Updates the object's box. Returns true if it left its fat box and was reinserted.
+    bool moveProxy(int proxy, const AABB& box);
+
+    void* getUserData(int proxy) const { return nodes[proxy].userData; }
+    const AABB& getFatAABB(int proxy) const { return nodes[proxy].box; }
+
+    int getProxyCount() const { return proxyCount; }
+    int getHeight() const { return root == Null ? 0 : nodes[root].height; }
+
+    // Nodes looked at by the last query (for the render stats)
+    int getNodesVisited() const { return nodesVisited; }
+
+    // Calls callback(userData) for every proxy whose fat box touches the frustum.
+    // Subtrees completely inside are reported without testing their nodes.
+    template <typename Callback>
+    void query(const Frustum& frustum, Callback&& callback) const {
+        nodesVisited = 0;
+        if (root == Null) return;
+
+        queryStack.clear();
+        queryStack.push_back(root);
+        while (!queryStack.empty()) {
+            int index = queryStack.back();
+            queryStack.pop_back();
+            const TreeNode& node = nodes[index];
+            nodesVisited++;
+
+            Frustum::Containment containment = frustum.classify(node.box);
+            if (containment == Frustum::Outside) continue;
+
+            if (node.isLeaf()) {
+                callback(node.userData);
+            } else if (containment == Frustum::Inside) {
+                reportAll(index, callback);
+            } else {
+                queryStack.push_back(node.child1);
+                queryStack.push_back(node.child2);
+            }
+        }
+    }
+
+private:
+    struct TreeNode {
+        AABB box;
+        void* userData = nullptr;
+        int parent = Null;    // Next free node while the node is unused
+        int child1 = Null;
+        int child2 = Null;
+        int height = -1;      // 0 for leaves, -1 for free nodes
+
+        bool isLeaf() const { return child1 == Null; }
+    };
+
+    std::vector<TreeNode> nodes;
+    int root = Null;
+    int freeList = Null;
+    int proxyCount = 0;
+    float margin;
+
+    // Scratch space for queries, kept to avoid allocating every frame
+    mutable std::vector<int> queryStack;
+    mutable int nodesVisited = 0;
+
+    int allocateNode();
+    void freeNode(int index);
+
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+
+    // Rotates the subtree at index if it is out of balance; returns the new subtree root
+    int balance(int index);
+
+    // Half the surface area, the cost measure for choosing where to insert
+    static float cost(const AABB& box) {
+        glm::vec3 d = box.max - box.min;
+        return d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+
+    static AABB combine(const AABB& a, const AABB& b) {
+        AABB result = a;
+        result.expand(b);
+        return result;
+    }
+
+    static bool contains(const AABB& outer, const AABB& inner) {
+        return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+               inner.max.x <= outer.max.x && inner.max.y <= outer.max.y && inner.max.z <= outer.max.z;
+    }
+
+    template <typename Callback>
+    void reportAll(int start, Callback& callback) const {
+        size_t base = queryStack.size();
+        queryStack.push_back(start);
+        while (queryStack.size() > base) {
+            int index = queryStack.back();
+            queryStack.pop_back();
+            const TreeNode& node = nodes[index];
+            if (node.isLeaf()) {
+                callback(node.userData);
+            } else {
+                queryStack.push_back(node.child1);
+                queryStack.push_back(node.child2);
+            }
+        }
+    }
+};
+
+#endif
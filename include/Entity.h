@@ -7,6 +7,7 @@
 #include <glm/glm/gtc/matrix_transform.hpp>
 #include <string>
 #include "Component.h" // <-- NEW: We need to know what a Component is
+#include "Bounds.h"
 
 class Entity : public std::enable_shared_from_this<Entity> {
 public:
@@ -31,6 +32,10 @@ public:
 
     bool pendingDestroy = false;
 
+    // World-space box around this entity's components and all of its children,
+    // rebuilt by updateSelfAndChild. Empty if nothing in the subtree has bounds.
+    AABB subtreeBounds;
+
     Entity() : position(0.0f), rotation(0.0f), scale(1.0f),
         localTransform(1.0f), worldTransform(1.0f), parent(nullptr) {}
 
@@ -94,16 +99,37 @@ public:
         localTransform = glm::scale(localTransform, scale);
 
         // 2. Calculate World Transform (Parent's World * My Local)
+        glm::mat4 previousWorld = worldTransform;
         if (parent) {
             worldTransform = parent->worldTransform * localTransform;
         } else {
             worldTransform = localTransform; // If no parent, local is world
         }
 
+        // Let components that cache world-space data (like the renderer's spatial index) know
+        if (worldTransform != previousWorld) {
+            for (auto& component : components) {
+                component->onTransformChanged();
+            }
+        }
+
         // 3. Recursively update all children
         for (auto& child : children) {
             child->updateSelfAndChild();
         }
+
+        // 4. Grow the subtree box from our own components and the children's boxes,
+        // so the renderer can skip a whole hierarchy with one test
+        subtreeBounds = AABB();
+        AABB localBounds;
+        for (auto& component : components) {
+            if (component->getLocalBounds(localBounds)) {
+                subtreeBounds.expand(localBounds.transformed(worldTransform));
+            }
+        }
+        for (auto& child : children) {
+            subtreeBounds.expand(child->subtreeBounds);
+        }
     }
 
     // --- REPLACED: The Engine Loop ---
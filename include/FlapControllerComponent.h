@@ -4,17 +4,20 @@
 #include "Component.h"
 #include "Entity.h"
 #include "PhysicsComponent.h"
+#include "Reflection.h"
 #include <GLFW/glfw3.h> // Assuming you are using GLFW for your window
 #include <iostream>
 
 class FlapControllerComponent : public Component {
 public:
-    GLFWwindow* window;
-    float flapForce;
+    GLFWwindow* window = nullptr;
+    float flapForce = 7.0f;
     
     // We use this to ensure the player has to let go of the spacebar before flapping again
     bool spaceWasPressed = false;
 
+    FlapControllerComponent() {}
+
     FlapControllerComponent(GLFWwindow* win, float force = 7.0f) 
         : window(win), flapForce(force) {}
 
@@ -41,13 +44,14 @@ public:
         spaceWasPressed = spaceIsPressed;
     }
 
-    static std::shared_ptr<Component> deserialize(std::istringstream& iss, GLFWwindow* window) {
-        float force = 7.0f;
-        if (!iss.eof()) {
-            iss >> force;
-        }
-        return std::make_shared<FlapControllerComponent>(window, force);
+    bool onDeserialized(uint32_t loadedFields, GLFWwindow* win) override {
+        window = win;
+        return true;
     }
+
+    // Scene file: [flapForce]
+    REFLECT_COMPONENT(FlapControllerComponent,
+        REFLECT_FIELD(FlapControllerComponent, flapForce))
 };
 
 #endif
\ No newline at end of file
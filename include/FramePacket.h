@@ -0,0 +1,61 @@
+#ifndef FRAME_PACKET_H
+#define FRAME_PACKET_H
+
+#include <glm/glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+class Model;
+
+struct PointLightData {
+    glm::vec3 position;
+    glm::vec3 color;
+    float intensity;
+    float constant, linear, quadratic; // Attenuation terms of the LightComponent
+};
+
+// Everything the renderer needs from the scene for one frame, copied out of it
+// on the simulation thread (Renderer::extractFrame). Drawing only reads the
+// packet, never the entities, so the next frame can be simulated while this
+// one is drawn (see RenderThread). Once handed over it isn't changed.
+struct FramePacket {
+    // A renderer the camera may see
+    struct Renderable {
+        Model* model;            // Models outlive the packets: ResourceManager or their owners keep them
+        glm::mat4 worldTransform;
+        int transformSlot;       // The renderer's TransformBuffer slot, which also keys its LOD state
+        float impostorDistance;
+        bool occluder;
+    };
+
+    uint64_t frame = 0;
+
+    // Camera
+    bool hasCamera = false;
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::vec3 viewPos = glm::vec3(0.0f);
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
+
+    std::vector<PointLightData> lights;
+
+    // Renderers whose box touched the view (all of them with frustum culling off).
+    // On GPU culling frames only the ones GpuCuller can't draw.
+    std::vector<Renderable> renderables;
+    bool gpuCulling = false;
+    unsigned int renderersCulled = 0; // Left out by the spatial index query
+    unsigned int subtreesCulled = 0;
+    unsigned int bvhNodesVisited = 0;
+
+    // Collider boxes for the debug wireframes (extracted only while debug drawing is on)
+    bool debug = false;
+    std::vector<glm::mat4> debugBoxes;
+
+    // Game requests carried over to the thread that draws
+    bool printStats = false;
+    bool toggleDeferredShading = false;
+    bool toggleDepthPrepass = false;
+};
+
+#endif
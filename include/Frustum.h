@@ -0,0 +1,130 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "Bounds.h"
+#include <glm/glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FORCE_FRUSTUM_SSE 1
+#endif
+
+// The six planes of a view-projection matrix, normals pointing inwards.
+// A point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0.
+class Frustum {
+public:
+    enum Plane { Left, Right, Bottom, Top, Near, Far, PlaneCount };
+    glm::vec4 planes[PlaneCount];
+
+    Frustum() {
+        for (auto& plane : planes) plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f); // Accepts everything
+    }
+
+    // Gribb/Hartmann extraction: each plane is the last row of the matrix plus or minus another row
+    explicit Frustum(const glm::mat4& viewProjection) {
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; ++i) {
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        }
+        planes[Left] = rows[3] + rows[0];
+        planes[Right] = rows[3] - rows[0];
+        planes[Bottom] = rows[3] + rows[1];
+        planes[Top] = rows[3] - rows[1];
+        planes[Near] = rows[3] + rows[2];
+        planes[Far] = rows[3] - rows[2];
+
+        // Normalized planes give real distances, which the sphere test needs
+        for (auto& plane : planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+    }
+
+    bool intersects(const BoundingSphere& sphere) const {
+        for (const auto& plane : planes) {
+            if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) return false;
+        }
+        return true;
+    }
+
+    bool intersects(const AABB& box) const {
+        if (box.isEmpty()) return false;
+        for (const auto& plane : planes) {
+            // The corner furthest along the plane normal; if even that one is outside, the whole box is
+            glm::vec3 corner(plane.x >= 0.0f ? box.max.x : box.min.x,
+                             plane.y >= 0.0f ? box.max.y : box.min.y,
+                             plane.z >= 0.0f ? box.max.z : box.min.z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) return false;
+        }
+        return true;
+    }
+
+    enum Containment { Outside, Intersecting, Inside };
+
+    // Like intersects(), but also tells boxes that are completely inside apart,
+    // so a hierarchy can accept everything below them without more tests
+    Containment classify(const AABB& box) const {
+        if (box.isEmpty()) return Outside;
+        Containment result = Inside;
+        for (const auto& plane : planes) {
+            glm::vec3 normal = glm::vec3(plane);
+            glm::vec3 farCorner(plane.x >= 0.0f ? box.max.x : box.min.x,
+                                plane.y >= 0.0f ? box.max.y : box.min.y,
+                                plane.z >= 0.0f ? box.max.z : box.min.z);
+            if (glm::dot(normal, farCorner) + plane.w < 0.0f) return Outside;
+
+            glm::vec3 nearCorner(plane.x >= 0.0f ? box.min.x : box.max.x,
+                                 plane.y >= 0.0f ? box.min.y : box.max.y,
+                                 plane.z >= 0.0f ? box.min.z : box.max.z);
+            if (glm::dot(normal, nearCorner) + plane.w < 0.0f) result = Intersecting;
+        }
+        return result;
+    }
+
+    // Tests many spheres stored as separate x/y/z/radius arrays, four per step with SSE.
+    // visible[i] becomes 1 if sphere i is at least partly inside, otherwise 0.
+    void testSpheres(const float* x, const float* y, const float* z, const float* radius, size_t count, uint8_t* visible) const {
+        size_t i = 0;
+#ifdef FORCE_FRUSTUM_SSE
+        __m128 planeX[PlaneCount], planeY[PlaneCount], planeZ[PlaneCount], planeW[PlaneCount];
+        for (int p = 0; p < PlaneCount; ++p) {
+            planeX[p] = _mm_set1_ps(planes[p].x);
+            planeY[p] = _mm_set1_ps(planes[p].y);
+            planeZ[p] = _mm_set1_ps(planes[p].z);
+            planeW[p] = _mm_set1_ps(planes[p].w);
+        }
+        const __m128 zero = _mm_setzero_ps();
+
+        for (; i + 4 <= count; i += 4) {
+            __m128 sx = _mm_loadu_ps(x + i);
+            __m128 sy = _mm_loadu_ps(y + i);
+            __m128 sz = _mm_loadu_ps(z + i);
+            __m128 negativeRadius = _mm_sub_ps(zero, _mm_loadu_ps(radius + i));
+
+            // A lane stays set while its sphere is on the inner side of every plane so far
+            __m128 inside = _mm_cmpeq_ps(zero, zero); // All bits set
+            for (int p = 0; p < PlaneCount; ++p) {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], sx), _mm_mul_ps(planeY[p], sy)),
+                                             _mm_add_ps(_mm_mul_ps(planeZ[p], sz), planeW[p]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+            }
+
+            int mask = _mm_movemask_ps(inside);
+            visible[i + 0] = (mask >> 0) & 1;
+            visible[i + 1] = (mask >> 1) & 1;
+            visible[i + 2] = (mask >> 2) & 1;
+            visible[i + 3] = (mask >> 3) & 1;
+        }
+#endif
+        // The remainder (or everything, without SSE)
+        for (; i < count; ++i) {
+            BoundingSphere sphere;
+            sphere.center = glm::vec3(x[i], y[i], z[i]);
+            sphere.radius = radius[i];
+            visible[i] = intersects(sphere) ? 1 : 0;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+// Bind counters since the last resetStats()
+struct GLStateStats {
+    unsigned int binds = 0;   // Bind calls that reached the driver
+    unsigned int skipped = 0; // Bind calls dropped because the object was already bound
+};
+
+// Remembers what is bound and drops binds that wouldn't change anything.
+// All engine code binds programs, VAOs, textures and buffers through here, so
+// the cache is always right. Code that calls GL directly must call invalidate()
+// afterwards. Build with FORCE_GL_STATE_VALIDATION (on in Debug builds) to
+// check every skipped bind against glGet.
+class GLState {
+public:
+    static constexpr int MaxTextureUnits = 32;
+    static constexpr int MaxIndexedBindings = 16;
+
+    static void useProgram(GLuint program);
+    static void bindVertexArray(GLuint vao);
+
+    // Binds to the given unit. glActiveTexture is only issued when a bind is actually needed.
+    static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+    // GL_ELEMENT_ARRAY_BUFFER belongs to the bound VAO, so it is passed through uncached
+    static void bindBuffer(GLenum target, GLuint buffer);
+
+    // Also sets the generic binding of the target, like GL does
+    static void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+    // Always goes through (the range isn't cached); a later bindBufferBase of the same
+    // buffer to the same index is then not skipped
+    static void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+    // Forget everything (after raw GL calls, or when a deleted name may come back)
+    static void invalidate();
+
+    static GLStateStats stats;
+    static void resetStats() { stats = GLStateStats(); }
+
+private:
+    // Textures and buffers are cached per target; these map a target to its slot (-1 = not cached)
+    static int textureTargetSlot(GLenum target);
+    static int bufferTargetSlot(GLenum target);
+    static int indexedTargetSlot(GLenum target);
+
+    static constexpr int TextureTargets = 3; // 2D, 2D array, cube map
+    static constexpr int BufferTargets = 5;  // Array, uniform, storage, indirect, copy write
+    static constexpr int IndexedTargets = 2; // Uniform, storage
+
+    // ~0u means unknown (after invalidate()): the next bind always goes through
+    static GLuint program;
+    static GLuint vertexArray;
+    static GLuint activeUnit;
+    static GLuint textures[MaxTextureUnits][TextureTargets];
+    static GLuint buffers[BufferTargets];
+    static GLuint indexedBuffers[IndexedTargets][MaxIndexedBindings];
+
+    // Compares a skipped bind with what GL reports (FORCE_GL_STATE_VALIDATION only)
+    static void validate(const char* what, GLenum query, GLuint expected);
+    static void validateTexture(GLuint unit, GLenum query, GLuint expected);
+    static void validateIndexed(GLenum query, GLuint index, GLuint expected);
+};
+
+#endif
@@ -23,6 +23,14 @@ public:
     // Debug state
     bool debugMode = false;
     std::shared_ptr<Model> debugCubeModel;
+    float statsTimer = 0.0f;
+
+    // Renderer switches asked for by input, applied by the thread that draws
+    bool toggleDeferredShading = false;
+    bool toggleDepthPrepass = false;
+
+    // The packet of the synchronous render()
+    FramePacket framePacket;
     
     // Time tracking
     float deltaTime = 0.0f;
@@ -34,7 +42,16 @@ public:
     void init(GLFWwindow* window);
     void processInput(GLFWwindow* window);
     void update();
+
+    // Copies the frame out of the scene (simulation thread)
+    void extractFrame(FramePacket& packet);
+
+    // Draws an extracted frame (the thread with the GL context)
+    void renderFrame(const FramePacket& packet);
+
+    // Both of the above on the calling thread
     void render();
+    void printRenderStats();
 };
 
 
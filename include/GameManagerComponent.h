@@ -8,6 +8,8 @@
 #include "LinearMovementComponent.h"
 #include "PipeComponent.h"
 #include "PhysicsComponent.h"
+#include "PrimitiveBuilder.h"
+#include "Reflection.h"
 #include <iostream>
 #include <memory>
 #include <cstdlib>
@@ -135,19 +137,23 @@ public:
         rootEntity->addChild(topPipe);
     }
 
-    static std::shared_ptr<Component> deserialize(std::istringstream& iss, GLFWwindow* window) {
-        auto gm = std::make_shared<GameManagerComponent>();
-        iss >> gm->playerEntityName >> gm->leftBoundaryEntityName;
+    bool onDeserialized(uint32_t loadedFields, GLFWwindow* window) override {
         // The pipe model needs to be created or fetched from ResourceManager
         // We'll hardcode the fetching logic here or use PrimitiveBuilder
-        auto pipeModel = PrimitiveBuilder::createCube(1.0f, 10.0f, 1.0f, true, true);
+        pipeModel = PrimitiveBuilder::createCube(1.0f, 10.0f, 1.0f, true, true);
         auto pipeMaterial = ResourceManager::loadForceMaterial("assets/materials/glossy_tile.ForceMaterial");
         if (!pipeModel->meshes.empty()) {
             pipeModel->materials[0] = pipeMaterial;
         }
-        gm->pipeModel = pipeModel;
-        return gm;
+        return true;
     }
+
+    // Scene file: playerEntityName leftBoundaryEntityName [spawnInterval]
+    REFLECT_COMPONENT(GameManagerComponent,
+        REFLECT_FIELD(GameManagerComponent, playerEntityName),
+        REFLECT_FIELD(GameManagerComponent, leftBoundaryEntityName),
+        REFLECT_FIELD(GameManagerComponent, spawnInterval),
+        REFLECT_FIELD_FLAGS(GameManagerComponent, spawnTimer, Reflection::FieldNoText))
 };
 
 #endif
\ No newline at end of file
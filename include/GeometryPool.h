@@ -0,0 +1,130 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+#include "RangeAllocator.h"
+
+// Pool counters, for the stats line
+struct GeometryPoolStats {
+    unsigned int allocations = 0;      // Live meshes
+    unsigned int vertexBytes = 0;      // Size of every vertex buffer, position streams included
+    unsigned int usedVertexBytes = 0;
+    unsigned int indexBytes = 0;
+    unsigned int usedIndexBytes = 0;
+    unsigned int freeRanges = 0;       // Holes over every allocator
+    unsigned int grows = 0;            // Since startup
+    unsigned int defragments = 0;
+};
+
+// Every mesh's vertices and indices live in a few large buffers instead of a
+// buffer pair (and a VAO) of their own. There is one vertex buffer per vertex
+// layout, since each has its own stride, and one index buffer shared by all of
+// them. A mesh gets a range of each (RangeAllocator) and draws with its base
+// vertex and first index, so its indices stay local to its vertices.
+//
+// Meshes of the same layout then share one VAO: switching meshes binds nothing,
+// and neighbouring draws of different meshes can go out as one
+// glMultiDrawElementsIndirect (see Renderer::drawIndirect).
+//
+// A full buffer is grown in place. Freed ranges go back to the allocator;
+// defragment() slides the live ones to the start of each buffer once the free
+// space is split into too many holes. Both keep the buffer names, so VAOs stay
+// valid, but defragmenting moves meshes: draws recorded earlier (GpuCuller's
+// commands) check getGeneration() and rebuild.
+class GeometryPool {
+public:
+    static constexpr int Invalid = -1;
+
+    // Vertex layouts, by which attributes follow the position. Normals together
+    // with UVs also bring tangents (see Mesh).
+    static constexpr int LayoutCount = 4;
+    static int getLayout(bool hasNormals, bool hasUVs) { return (hasNormals ? 1 : 0) | (hasUVs ? 2 : 0); }
+
+    // Where a mesh is in the pool. Offsets are in vertices and indices.
+    struct Allocation {
+        int layout = 0;
+        uint32_t baseVertex = 0;
+        uint32_t vertexCount = 0;
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+    };
+
+    // Copies an interleaved vertex list (in the layout's stride) and its indices into the
+    // pool, along with a tightly packed copy of the positions for depth-only passes.
+    // Returns a handle for get() and release(), or Invalid for a layout that doesn't exist.
+    static int allocate(int layout, const std::vector<float>& vertices, const std::vector<unsigned int>& indices);
+
+    // Gives the ranges back. Only bookkeeping, so it's safe without a context.
+    static void release(int handle);
+
+    // Current offsets of a handle (they change when the pool is defragmented)
+    static const Allocation& get(int handle) { return storage().allocations[handle]; }
+
+    // The layout's VAO: every attribute, or only the positions (see Renderer::depthPrepass).
+    // Both come with the shared index buffer and the transform index attribute.
+    static unsigned int getVertexArray(int layout, bool positionsOnly) {
+        const Layout& pool = storage().layouts[layout];
+        return positionsOnly ? pool.positionVAO : pool.vertexArray;
+    }
+
+    // Compacts every allocator whose free space is more fragmented than the threshold
+    // (see RangeAllocator::getFragmentation). Returns true if anything moved.
+    static bool defragment(float threshold = 0.0f);
+
+    // Bumped each time meshes move
+    static uint32_t getGeneration() { return generation; }
+
+    static GeometryPoolStats getStats();
+
+private:
+    static constexpr uint32_t InitialVertices = 1 << 16;
+    static constexpr uint32_t InitialIndices = 1 << 18;
+
+    struct Layout {
+        unsigned int vertexArray = 0;
+        unsigned int positionVAO = 0;
+        unsigned int vertexBuffer = 0;
+        unsigned int positionBuffer = 0;
+        int stride = 0; // Floats per vertex
+        RangeAllocator vertices;
+    };
+
+    // The allocators and handles. Never destroyed: meshes kept in other statics
+    // (ResourceManager's models) release their ranges during exit, possibly after
+    // a normal static would be gone.
+    struct Storage {
+        Layout layouts[LayoutCount];
+        RangeAllocator indices;
+        std::vector<Allocation> allocations;
+        std::vector<uint8_t> live;
+        std::vector<int> freeHandles;
+    };
+    static Storage& storage() {
+        static Storage* pool = new Storage();
+        return *pool;
+    }
+
+    static unsigned int indexBuffer;
+    static unsigned int scratchBuffer; // Old contents while a buffer grows or is compacted
+    static size_t scratchBytes;
+    static uint32_t generation;
+    static unsigned int grows;
+    static unsigned int defragments;
+
+    // Creates the index buffer, or a layout's buffers and VAOs, on first use
+    static bool createIndexBuffer();
+    static bool createLayout(int layout);
+
+    // Keeps the contents and the name of a buffer while giving it a new size
+    static void resize(unsigned int buffer, size_t oldBytes, size_t newBytes);
+
+    // Copies the first `bytes` of a buffer into the scratch buffer
+    static void saveToScratch(unsigned int buffer, size_t bytes);
+
+    // Applies compact()'s moves to a buffer whose elements are `unit` bytes
+    static void applyMoves(unsigned int buffer, const std::vector<RangeAllocator::Move>& moves, size_t unit, size_t bytes);
+};
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef GPU_CULLER_H
+#define GPU_CULLER_H
+
+#include <glm/glm/glm.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class Mesh;
+class RendererComponent;
+
+// GPU-driven culling and draw generation (GL 4.3+).
+//
+// Every renderer that can be drawn this way has one CullInstance per mesh in a
+// storage buffer: its local bounding sphere, its TransformBuffer slot and the
+// draw group (mesh + material) it belongs to. Each group has one indirect draw
+// command per level of detail. Every frame a compute pass resets the commands,
+// tests every instance against the frustum and against a Hi-Z pyramid of the
+// previous frame's depth, picks its level of detail and appends its transform
+// slot to the command it belongs to. The renderer then issues one
+// glMultiDrawElementsIndirect per group. The CPU only touches renderers that
+// changed, and per frame does work proportional to the number of groups, not
+// the number of instances.
+//
+// Objects that become visible from behind an occluder show up one frame late,
+// since the Hi-Z is last frame's. Levels of detail are picked the way
+// Renderer::selectLod picks them, but without its hysteresis (the pass keeps no
+// history), so objects sitting right on a threshold can switch earlier.
+class GpuCuller {
+public:
+    // Creates the buffers and programs. Returns false below GL 4.3.
+    static bool init();
+    static bool isAvailable() { return instanceBuffer != 0; }
+
+    // Brings the tables up to date with RendererComponent::dirtyRenderers (call before
+    // RendererComponent::updateSpatialIndex(), which empties it). With everything set,
+    // every renderer in the spatial index is refreshed too (after the GPU path was off).
+    static void sync(bool everything);
+
+    // Drops a renderer's instances (called when it is destroyed)
+    static void remove(RendererComponent* renderer);
+
+    // Renderers the GPU path can't draw (impostors, shaders without the TransformData
+    // block); the Renderer still culls and draws these on the CPU
+    static const std::vector<RendererComponent*>& getFallbackRenderers() { return fallbackRenderers; }
+
+    // Resets the draw commands and dispatches the culling pass. The TransformBuffer
+    // must already be uploaded. Without selectLods every instance draws its finest level.
+    static void cull(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos, bool selectLods);
+
+    // One mesh + material pair and its commands (one per level of detail)
+    struct DrawGroup {
+        uint32_t mesh;         // Mesh::renderId
+        uint32_t material;     // Material::renderId
+        uint32_t firstCommand;
+        uint32_t lodCount;
+        uint32_t instances;    // Live instances in the group
+    };
+
+    // Groups with instances, sorted by shader, material and mesh
+    static const std::vector<DrawGroup>& getDrawOrder() { return drawOrder; }
+
+    // Draws whatever the last cull() put in the group's commands. The mesh and
+    // material must already be bound (the Renderer's bindState()). positionsOnly
+    // draws from the mesh's position-only stream (see GeometryPool::getVertexArray).
+    static void drawGroup(Mesh& mesh, const DrawGroup& group, bool positionsOnly = false);
+
+    // Builds the Hi-Z pyramid from the depth the frame left in the default framebuffer,
+    // for next frame's cull(). view and projection are the ones the frame was drawn with.
+    static void captureDepth(const glm::mat4& view, const glm::mat4& projection);
+
+    // Forget the Hi-Z (the camera jumped, or frames were drawn without the GPU path)
+    static void invalidateHiZ() { hiZValid = false; }
+
+    // Instances that passed the last cull. Reads the commands back, so it waits for
+    // the GPU; for debug output only.
+    static unsigned int readVisibleCount();
+
+    static unsigned int getInstanceCount() { return liveInstances; }
+
+private:
+    // std430 element of the CullInstances block
+    struct CullInstance {
+        glm::vec4 sphere;          // Local center and radius of the mesh, for culling
+        glm::vec4 modelSphere;     // Same for the whole model, for the level of detail
+        uint32_t transformSlot;
+        uint32_t group;
+        uint32_t alive;            // 0 for free entries, which the pass skips
+        uint32_t materialBits;     // materialIndex above the slot bits, for shaders that read MaterialLayers
+        glm::vec4 lodScreenSizes;  // Model::lodSettings screen sizes, 0 past the last one
+    };
+    static_assert(sizeof(CullInstance) == 64, "CullInstance must match the std430 struct");
+
+    // std430 element of the DrawCommands block, laid out as GL reads indirect commands
+    struct DrawCommand {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        uint32_t baseVertex;
+        uint32_t baseInstance; // Start of the command's range in VisibleInstances
+    };
+
+    static constexpr int ThreadsPerGroup = 64;
+
+    static unsigned int instanceBuffer, groupBuffer, commandTemplate, commandBuffer, visibleBuffer;
+    static size_t instanceCapacity, visibleCapacity;
+
+    static std::vector<CullInstance> instances;
+    static std::vector<RendererComponent*> instanceOwners;
+    static std::vector<int> freeInstances;
+    static size_t liveInstances;
+    static size_t dirtyBegin, dirtyEnd; // Range of instances to upload
+
+    static std::vector<DrawGroup> groups;
+    static std::unordered_map<uint64_t, uint32_t> groupIndex; // (mesh, material) -> groups index
+    static std::vector<DrawGroup> drawOrder;
+    static uint32_t commandCount;
+    static bool layoutDirty;
+    static uint32_t poolGeneration; // GeometryPool::getGeneration() the commands were built for
+
+    static std::vector<RendererComponent*> fallbackRenderers;
+
+    // Hi-Z pyramid of last frame's depth
+    static unsigned int depthTexture, hiZTexture;
+    static int depthWidth, depthHeight, hiZWidth, hiZHeight, hiZLevels;
+    static bool hiZValid;
+    static glm::mat4 hiZView, hiZProjection;
+
+    static void refresh(RendererComponent* renderer);
+    static void addInstances(RendererComponent* renderer);
+    static void markDirty(size_t index);
+
+    // Gives every group its commands and its range of VisibleInstances
+    static void layout();
+
+    // Forgets the groups no instance uses any more, such as those of released meshes and
+    // materials, whose IDs can be handed to new ones
+    static void dropEmptyGroups();
+    static void upload();
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <glm/glm/glm.hpp>
+#include <memory>
+#include <vector>
+#include "Bounds.h"
+
+class Model;
+
+// A model pre-rendered from framesPerSide x framesPerSide directions into one texture.
+// The directions cover the whole sphere through an octahedral mapping, so the frame
+// for any view direction is found with a little math instead of a search.
+// Far away, a model is drawn as a single quad showing the nearest frame.
+class Impostor {
+public:
+    unsigned int atlas = 0; // RGBA texture, one frameSize x frameSize cell per direction
+    int framesPerSide = 0;
+    int frameSize = 0;
+
+    // The model's local bounding sphere; the quads are sized and centered on it
+    BoundingSphere bounds;
+
+    // Per-quad data, filled in by the Renderer for every distant instance
+    struct Instance {
+        glm::vec4 centerRadius; // World center and radius of the model's sphere
+        glm::vec4 axisX;        // Model rotation (unit axes), so the right frame is picked
+        glm::vec4 axisY;        // when the model itself turns
+        glm::vec4 axisZ;
+    };
+
+    // Renders the model offscreen into a new atlas. Restores the viewport and framebuffer.
+    // Returns null if the model has nothing to draw.
+    static std::shared_ptr<Impostor> bake(const Model& model, int framesPerSide = 8, int frameSize = 64);
+
+    // Draws count instances, starting at instances[first], with one instanced call
+    void drawInstances(const std::vector<Instance>& instances, size_t first, size_t count,
+                       const glm::mat4& viewProjection, const glm::vec3& viewPos) const;
+
+    // Owns its atlas, so it can't be copied (like Texture, the GL objects live until the context goes)
+    Impostor(const Impostor&) = delete;
+    Impostor& operator=(const Impostor&) = delete;
+
+private:
+    Impostor() {}
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <cstddef>
+#include <functional>
+
+// A fixed set of worker threads for splitting a loop across cores.
+// The workers start on first use and sleep between calls. They are never
+// joined: like the RenderIdTable storage, the pool lives until the process ends,
+// so nothing can be torn down under a worker during static destruction.
+class JobSystem {
+public:
+    // Threads that run jobs, counting the caller of parallelFor (at least 1)
+    static unsigned int getThreadCount();
+
+    // Lets only the first `threads` of them take jobs (0 = all), to see how a loop scales.
+    // getThreadCount() doesn't change, so per-thread scratch sized by it stays valid.
+    static void setThreadLimit(unsigned int threads);
+    static unsigned int getThreadLimit();
+
+    // Runs job(index, thread) for every index in [0, count) and returns once all are done.
+    // thread is in [0, getThreadCount()) and unique among jobs running at the same time,
+    // so it can pick per-thread scratch space. The calling thread takes part (as thread 0).
+    // Calls from several threads at once are run one after another; calling it from
+    // inside a job is not allowed.
+    static void parallelFor(size_t count, const std::function<void(size_t index, unsigned int thread)>& job);
+};
+
+#endif
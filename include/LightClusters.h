@@ -0,0 +1,77 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glm/glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// std430 element of the ClusterLights block
+struct ClusterLight {
+    glm::vec4 positionRange;  // World position, and the distance where the light stops counting
+    glm::vec4 colorIntensity;
+    glm::vec4 attenuation;    // LightComponent constant, linear, quadratic
+};
+static_assert(sizeof(ClusterLight) == 48, "ClusterLight must match the std430 struct");
+
+// Head of the ClusterGrid block, followed by one (offset, count) pair per cluster
+struct ClusterGridHeader {
+    glm::uvec4 gridSize;   // Tiles across, tiles up, depth slices, light count
+    glm::vec4 depthParams; // Slice of a view depth d: log(d) * x - y
+    glm::vec4 tileSize;    // Pixels per tile (x, y)
+};
+static_assert(sizeof(ClusterGridHeader) == 48, "ClusterGridHeader must match the std430 block");
+
+// Clustered forward lighting, the CPU half. The view frustum is cut into
+// TilesX x TilesY tiles on screen and Slices slices in depth (exponentially
+// spaced, so near clusters stay small), and every light is listed in each
+// cluster its sphere of influence reaches. A fragment then only loops over
+// the lights of its own cluster instead of every light in the scene.
+//
+// Lights are sorted into slices on the JobSystem, one slice per job, so no two
+// jobs ever write the same list. Each light covers the screen rectangle of its
+// sphere's box clipped to the slice, which is conservative: a cluster can list
+// a light that doesn't quite reach it, never the other way around.
+class LightClusters {
+public:
+    static constexpr int TilesX = 16;
+    static constexpr int TilesY = 9;
+    static constexpr int Slices = 24;
+    static constexpr int ClusterCount = TilesX * TilesY * Slices;
+
+    // Contribution (intensity times the brightest channel, after attenuation) below which a light is ignored
+    static constexpr float Cutoff = 1.0f / 256.0f;
+
+    // Distance at which a light fades below Cutoff
+    static float lightRange(const glm::vec3& color, float intensity, float constant, float linear, float quadratic);
+
+    // Assigns the lights (positionRange.w already set) to the clusters of this view.
+    // projection must be a perspective one; near and far are its planes, width and height the viewport.
+    void build(const std::vector<ClusterLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+               float nearPlane, float farPlane, int width, int height);
+
+    const ClusterGridHeader& getHeader() const { return m_header; }
+
+    // (offset into getLightIndices(), count) of every cluster, x fastest, then y, then slice
+    const std::vector<glm::uvec2>& getClusters() const { return m_clusters; }
+    const std::vector<uint32_t>& getLightIndices() const { return m_indices; }
+
+    // Largest list of the last build
+    uint32_t getMaxLightsPerCluster() const { return m_maxPerCluster; }
+
+    // Index of the cluster a view-space point falls in, -1 outside the grid (for tests and debugging)
+    int clusterAt(const glm::vec3& viewPosition, const glm::mat4& projection) const;
+
+private:
+    // Per-slice output: one list per tile
+    std::vector<std::vector<uint32_t>> m_tileLists = std::vector<std::vector<uint32_t>>(ClusterCount);
+
+    ClusterGridHeader m_header = {};
+    std::vector<glm::vec4> m_viewLights; // View-space center (depth as a positive distance) and range
+    std::vector<glm::uvec2> m_clusters = std::vector<glm::uvec2>(ClusterCount, glm::uvec2(0));
+    std::vector<uint32_t> m_indices;
+    uint32_t m_maxPerCluster = 0;
+    float m_sliceDepth[Slices + 1] = {};
+};
+
+#endif
@@ -2,28 +2,45 @@
 #define LIGHT_COMPONENT_H
 
 #include "Component.h"
+#include "Reflection.h"
 #include <glm/glm/glm.hpp>
 #include <sstream>
 #include <memory>
+#include <vector>
+#include <algorithm>
 #include <GLFW/glfw3.h>
 
 class LightComponent : public Component {
 public:
-    glm::vec3 color;
-    float intensity;
+    // Every light in the scene, so the renderer finds them even in culled hierarchies
+    static std::vector<LightComponent*> allLights;
+
+    glm::vec3 color = glm::vec3(1.0f);
+    float intensity = 1.0f;
 
     // Attenuation variables (how the light fades over distance)
     float constant = 1.0f;
     float linear = 0.09f;
     float quadratic = 0.032f;
 
+    LightComponent() {}
     LightComponent(glm::vec3 col, float i) : color(col), intensity(i) {}
 
-    static std::shared_ptr<Component> deserialize(std::istringstream& iss, GLFWwindow* window) {
-        float r, g, b, intensity;
-        iss >> r >> g >> b >> intensity;
-        return std::make_shared<LightComponent>(glm::vec3(r, g, b), intensity);
+    void awake() override {
+        allLights.push_back(this);
+    }
+
+    ~LightComponent() override {
+        allLights.erase(std::remove(allLights.begin(), allLights.end(), this), allLights.end());
     }
+
+    // Scene file: r g b intensity [constant linear quadratic]
+    REFLECT_COMPONENT(LightComponent,
+        REFLECT_FIELD(LightComponent, color),
+        REFLECT_FIELD(LightComponent, intensity),
+        REFLECT_FIELD(LightComponent, constant),
+        REFLECT_FIELD(LightComponent, linear),
+        REFLECT_FIELD(LightComponent, quadratic))
 };
 
 #endif
\ No newline at end of file
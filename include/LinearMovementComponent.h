@@ -3,15 +3,17 @@
 
 #include "Component.h"
 #include "Entity.h"
+#include "Reflection.h"
 #include <glm/glm/glm.hpp>
 #include <GLFW/glfw3.h>
 
 class LinearMovementComponent : public Component {
 public:
-    glm::vec3 velocity;
+    glm::vec3 velocity = glm::vec3(0.0f);
 
     // Pass in the speed and direction. 
     // For Flappy Bird pipes, this will be something like vec3(-5.0f, 0.0f, 0.0f)
+    LinearMovementComponent() {}
     LinearMovementComponent(glm::vec3 vel) : velocity(vel) {}
 
     void update(float deltaTime) override {
@@ -21,13 +23,14 @@ public:
         owner->position += velocity * deltaTime;
     }
 
-    static std::shared_ptr<Component> deserialize(std::istringstream& iss, GLFWwindow* window) {
-        float x, y, z;
-        if (iss >> x >> y >> z) {
-            return std::make_shared<LinearMovementComponent>(glm::vec3(x, y, z));
-        }
-        return nullptr;
+    bool onDeserialized(uint32_t loadedFields, GLFWwindow* window) override {
+        // The velocity is required
+        return loadedFields & Reflection::fieldBit(0);
     }
+
+    // Scene file: x y z
+    REFLECT_COMPONENT(LinearMovementComponent,
+        REFLECT_FIELD(LinearMovementComponent, velocity))
 };
 
 #endif
\ No newline at end of file
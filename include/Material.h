@@ -2,7 +2,11 @@
 #define MATERIAL_H
 
 #include "Shader.h"
+#include "ShaderVariants.h"
 #include "Texture.h"
+#include "MaterialTable.h"
+#include "RenderId.h"
+#include "ShaderBindings.h"
 #include <glm/glm/glm.hpp>
 
 #include <memory>
@@ -10,6 +14,10 @@
 class Material {
 public:
     std::shared_ptr<Shader> shader;
+
+    // Set when the shader files were loaded as a variant set: shader is then the set's
+    // program for the maps this material has (see selectVariant)
+    std::shared_ptr<ShaderVariants> variants;
     
     // Texture Maps
     std::shared_ptr<Texture> diffuseMap;
@@ -20,40 +28,175 @@ public:
     float shininess; // How tight the reflection reflection is (e.g., 32.0f or 64.0f)
     glm::vec2 textureScale; 
 
+    // Slot of this material in the GPU MaterialTable, or -1 if the table was full
+    int materialIndex;
+
+    // Small ID used by draw packets and sort keys (see RenderIdTable)
+    uint32_t renderId;
+
+    // Frame in which syncParams() last ran (used by the Renderer to sync once per frame)
+    unsigned int syncedFrame = ~0u;
+
+    // ID the Renderer sorts this material's draws by: its renderId, or one shared with
+    // the materials it can be batched with (see sharesTextures)
+    uint32_t sortId;
+
     Material(std::shared_ptr<Shader> s) 
-        : shader(s), diffuseMap(nullptr), specularMap(nullptr), normalMap(nullptr), shininess(32.0f), textureScale(1.0f) {}
+        : shader(s), diffuseMap(nullptr), specularMap(nullptr), normalMap(nullptr), shininess(32.0f), textureScale(1.0f),
+          materialIndex(MaterialTable::allocate()), renderId(RenderIdTable<Material>::acquire(this)), sortId(renderId) {}
+
+    ~Material() {
+        MaterialTable::release(materialIndex);
+        RenderIdTable<Material>::release(renderId);
+    }
+
+    // Each material owns a table slot and a render ID, so it can't be copied
+    Material(const Material&) = delete;
+    Material& operator=(const Material&) = delete;
+
+    // The material's constants, as stored in the MaterialData block
+    MaterialParams getParams() const {
+        MaterialParams params;
+        params.hasDiffuse = diffuseMap ? 1.0f : 0.0f;
+        params.hasSpecular = specularMap ? 1.0f : 0.0f;
+        params.hasNormalMap = normalMap ? 1.0f : 0.0f;
+        params.shininess = shininess;
+        params.textureScale = textureScale;
+        params.padding = glm::vec2(0.0f);
+        return params;
+    }
+
+    // The maps it has, as ShaderVariants features
+    uint32_t getFeatures() const {
+        return (diffuseMap ? ShaderVariants::DiffuseMap : 0u) | (specularMap ? ShaderVariants::SpecularMap : 0u) |
+               (normalMap ? ShaderVariants::NormalMap : 0u);
+    }
+
+    // Takes the variant built for the maps the material has now (compiled if nobody asked
+    // for it yet). Call again after adding or removing a map. Needs the context.
+    void selectVariant() {
+        if (variants) shader = variants->get(getFeatures() | ShaderVariants::getContextFeatures());
+    }
+
+    // Texture array layers of the diffuse, specular and normal maps, -1 for maps
+    // that are missing or have no layer (see TextureArrays)
+    glm::ivec4 getLayers() const {
+        return glm::ivec4(layerOf(diffuseMap), layerOf(specularMap), layerOf(normalMap), 0);
+    }
+
+    // Their pages, -1 the same way
+    glm::ivec4 getPages() const {
+        return glm::ivec4(pageOf(diffuseMap), pageOf(specularMap), pageOf(normalMap), 0);
+    }
 
-    void apply() {
-        shader->use();
+    // True if every map it has lives in a texture array, so a shader that reads
+    // MaterialLayers never samples this material's 2D textures
+    bool texturesInArrays() const {
+        return (!diffuseMap || diffuseMap->arrayLayer.isValid()) && (!specularMap || specularMap->arrayLayer.isValid()) &&
+               (!normalMap || normalMap->arrayLayer.isValid());
+    }
+
+    // True if drawing the other material binds exactly the same state as this one when the
+    // shader reads MaterialLayers: same program and the same pages. Only the materialIndex
+    // differs, which such shaders take per instance (see ShaderBindings::TransformIndexBits).
+    bool sharesTextures(const Material& other) const {
+        return shader == other.shader && materialIndex >= 0 && other.materialIndex >= 0 &&
+               texturesInArrays() && other.texturesInArrays() && pageOf(diffuseMap) == pageOf(other.diffuseMap) &&
+               pageOf(specularMap) == pageOf(other.specularMap) && pageOf(normalMap) == pageOf(other.normalMap);
+    }
+
+    // Pushes the constants to the material table. Only uploads if something changed.
+    void syncParams() {
+        MaterialTable::update(materialIndex, getParams());
+        MaterialTable::updateLayers(materialIndex, getLayers());
+    }
+
+    // Binds the textures and selects this material's constants.
+    // The shader must already be in use.
+    void apply() { apply(*shader); }
+
+    // Same, for another program that reads materials the same way as material shaders
+    // (the deferred geometry pass). That program must be in use.
+    void apply(Shader& target) {
+        resolveUniforms(target);
         
-        // We must bind different textures to different "Texture Units" in OpenGL hardware
-        if (diffuseMap) {
-            shader->setFloat("hasDiffuse", 1.0f);
-            diffuseMap->bind(0); // Bind to GL_TEXTURE0
-            shader->setInt("material.diffuse", 0);
-        } else {
-            shader->setFloat("hasDiffuse", 0.0f);
-        }
+        // We must bind different textures to different "Texture Units" in OpenGL hardware.
+        // Shaders with the MaterialLayers block sample maps that have a layer from its page.
+        bindMap(target, diffuseMap, ShaderBindings::DiffuseUnit, uniforms.diffuse, ShaderBindings::DiffuseArrayUnit, uniforms.diffuseArray);
+        bindMap(target, specularMap, ShaderBindings::SpecularUnit, uniforms.specular, ShaderBindings::SpecularArrayUnit, uniforms.specularArray);
+        bindMap(target, normalMap, ShaderBindings::NormalUnit, uniforms.normal, ShaderBindings::NormalArrayUnit, uniforms.normalArray);
 
-        if (specularMap) {
-            shader->setFloat("hasSpecular", 1.0f);
-            specularMap->bind(1); // Bind to GL_TEXTURE1
-            shader->setInt("material.specular", 1);
-        } else {
-            shader->setFloat("hasSpecular", 0.0f);
+        // Shaders with the MaterialData block read the constants from the table
+        if (uniforms.usesMaterialData && materialIndex >= 0) {
+            target.set(uniforms.materialIndex, materialIndex);
+            return;
         }
 
-        if (normalMap) {
-            shader->setFloat("hasNormalMap", 1.0f);
-            normalMap->bind(2); // Bind to GL_TEXTURE2
-            shader->setInt("material.normal", 2);
-        } else {
-            shader->setFloat("hasNormalMap", 0.0f);
+        // Older shaders (or a full table) still get one uniform per constant
+        MaterialParams params = getParams();
+        target.set(uniforms.hasDiffuse, params.hasDiffuse);
+        target.set(uniforms.hasSpecular, params.hasSpecular);
+        target.set(uniforms.hasNormalMap, params.hasNormalMap);
+        target.set(uniforms.shininess, shininess);
+        target.set(uniforms.textureScale, textureScale);
+    }
+
+private:
+    // Handles of the uniforms apply() sets, resolved again whenever the program changes
+    struct Uniforms {
+        unsigned int program = 0;
+        bool usesMaterialData = false;
+        bool usesMaterialLayers = false;
+        UniformHandle materialIndex;
+        UniformHandle hasDiffuse, hasSpecular, hasNormalMap;
+        UniformHandle diffuse, specular, normal;
+        UniformHandle diffuseArray, specularArray, normalArray;
+        UniformHandle shininess, textureScale;
+    } uniforms;
+
+    void resolveUniforms(const Shader& target) {
+        if (uniforms.program == target.ID) return;
+        uniforms.program = target.ID;
+        uniforms.usesMaterialData = target.hasUniformBlock("MaterialData");
+        uniforms.usesMaterialLayers = target.hasUniformBlock("MaterialLayers");
+        uniforms.materialIndex = target.getUniform("materialIndex");
+        uniforms.hasDiffuse = target.getUniform("hasDiffuse");
+        uniforms.hasSpecular = target.getUniform("hasSpecular");
+        uniforms.hasNormalMap = target.getUniform("hasNormalMap");
+        uniforms.diffuse = target.getUniform("material.diffuse");
+        uniforms.specular = target.getUniform("material.specular");
+        uniforms.normal = target.getUniform("material.normal");
+        uniforms.diffuseArray = target.getUniform("diffuseArray");
+        uniforms.specularArray = target.getUniform("specularArray");
+        uniforms.normalArray = target.getUniform("normalArray");
+        uniforms.shininess = target.getUniform("material.shininess");
+        uniforms.textureScale = target.getUniform("textureScale");
+    }
+
+    void bindMap(Shader& target, const std::shared_ptr<Texture>& map, unsigned int unit, UniformHandle sampler,
+                 unsigned int arrayUnit, UniformHandle arraySampler) {
+        // Both samplers always point at their own unit: one left at unit 0 would make a
+        // sampler2D and a sampler2DArray share it, and every draw fail
+        if (uniforms.usesMaterialLayers) {
+            target.set(sampler, static_cast<int>(unit));
+            target.set(arraySampler, static_cast<int>(arrayUnit));
         }
+        if (!map) return;
+        if (uniforms.usesMaterialLayers && map->arrayLayer.isValid()) {
+            TextureArrays::bind(map->arrayLayer.page, arrayUnit);
+            return;
+        }
+        map->bind(unit);
+        target.set(sampler, static_cast<int>(unit));
+    }
+
+    static int layerOf(const std::shared_ptr<Texture>& map) {
+        return map ? map->arrayLayer.layer : TextureArrays::Invalid;
+    }
 
-        shader->setFloat("material.shininess", shininess);
-        shader->setVec2("textureScale", textureScale);
+    static int pageOf(const std::shared_ptr<Texture>& map) {
+        return map ? map->arrayLayer.page : TextureArrays::Invalid;
     }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,65 @@
+#ifndef MATERIAL_TABLE_H
+#define MATERIAL_TABLE_H
+
+#include <glm/glm/glm.hpp>
+#include <vector>
+
+// CPU mirror of one element of the std140 MaterialData block (see Documentation.txt)
+struct MaterialParams {
+    float hasDiffuse;
+    float hasSpecular;
+    float hasNormalMap;
+    float shininess;
+    glm::vec2 textureScale;
+    glm::vec2 padding;
+};
+
+static_assert(sizeof(MaterialParams) == 32, "MaterialParams must match the std140 MaterialParams struct");
+
+// Every material's constants live in one persistent uniform buffer, indexed by
+// material ID. A material writes its slot only when its values change, so
+// switching materials in a shader is just a different materialIndex.
+class MaterialTable {
+public:
+    static constexpr int Capacity = 256; // 8 KB, well inside the 16 KB every GL 3.3 driver allows
+
+    // Creates the buffer and binds it to ShaderBindings::MaterialData
+    static void init();
+
+    // Hands out a free slot, or -1 if the table is full (the material then falls back to plain uniforms)
+    static int allocate();
+    static void release(int index);
+
+    // Writes the slot if the values differ from what the GPU already has. Returns true if it uploaded.
+    static bool update(int index, const MaterialParams& params);
+
+    // Same for the slot's entry in the MaterialLayers block: the texture array layers of the
+    // diffuse, specular and normal maps (-1 for maps without one), w unused
+    static bool updateLayers(int index, const glm::ivec4& layers);
+
+    // Number of slot uploads since the last resetStats()
+    static unsigned int uploads;
+    static void resetStats() { uploads = 0; }
+
+private:
+    static unsigned int ubo;
+    static unsigned int layersUbo;
+
+    struct Storage {
+        std::vector<MaterialParams> shadow = std::vector<MaterialParams>(Capacity); // What the GPU currently holds for each slot
+        std::vector<bool> valid = std::vector<bool>(Capacity, false);              // False until a slot has been written
+        std::vector<glm::ivec4> layerShadow = std::vector<glm::ivec4>(Capacity);
+        std::vector<bool> layersValid = std::vector<bool>(Capacity, false);
+        std::vector<int> freeSlots;
+        int nextSlot = 0;
+    };
+
+    // Never destroyed, like RenderIdTable's: materials kept in other statics (ResourceManager's
+    // models) release their slots during exit, possibly after a normal static would be gone
+    static Storage& storage() {
+        static Storage* table = new Storage();
+        return *table;
+    }
+};
+
+#endif
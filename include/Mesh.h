@@ -3,28 +3,56 @@
 
 #include <glad/glad.h>
 #include <vector>
+#include "TransformBuffer.h"
+#include "RenderId.h"
+#include "GLState.h"
+#include "GeometryPool.h"
+#include "Bounds.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include <algorithm>
+
+// One level of detail: a range of the mesh's index buffer. All levels share the vertices.
+struct MeshLod {
+    unsigned int firstIndex;
+    int indexCount;
+    float error; // Largest simplification error, roughly in object units (0 for the full mesh)
+};
 
 class Mesh {
 public:
-    unsigned int VAO, VBO, EBO;
     int indexCount;
 
-    Mesh(const std::vector<float>& vertices, const std::vector<unsigned int>& indices, bool hasNormals, bool hasUVs) {
-        indexCount = static_cast<int>(indices.size());
+    // Handle of the vertices and indices in the GeometryPool. The pool also keeps the
+    // positions tightly packed (12 bytes a vertex instead of the whole interleaved vertex)
+    // for depth-only passes (see Renderer::depthPrepass).
+    int geometry;
 
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO); // The new Index Buffer
+    // Small ID used by draw packets and sort keys (see RenderIdTable)
+    uint32_t renderId;
 
-        glBindVertexArray(VAO);
+    // Local-space bounds of the vertex positions, for culling
+    AABB bounds;
+    BoundingSphere boundingSphere;
 
-        // Load Vertex Data
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    // Levels of detail, full detail first. There is always at least one.
+    std::vector<MeshLod> lods;
 
-        // Load Index Data
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    // Clusters of the full-detail level, empty unless asked for (see MeshletBuilder).
+    // The renderer skips the ones that are off screen or face away from the camera.
+    std::vector<Meshlet> meshlets;
+
+    // Positions and triangles of the coarsest level, kept on the CPU for occluders
+    // (see OcclusionCuller). Only the vertices that level uses are kept.
+    std::vector<glm::vec3> occluderPositions;
+    std::vector<unsigned int> occluderIndices;
+
+    // lodRatios asks for extra levels with that fraction of the triangles (e.g. 0.5, 0.25),
+    // built by MeshSimplifier into the same index buffer. buildMeshlets splits the full level into meshlets.
+    Mesh(const std::vector<float>& vertices, const std::vector<unsigned int>& indices, bool hasNormals, bool hasUVs,
+         const std::vector<float>& lodRatios = {}, bool buildMeshlets = false) {
+        indexCount = static_cast<int>(indices.size());
+        renderId = RenderIdTable<Mesh>::acquire(this);
 
         // Calculate dynamic stride
         int stride = 3; // Position (x, y, z)
@@ -35,50 +63,111 @@ public:
         // you want Tangents for Normal Mapping.
         bool hasTangents = (hasNormals && hasUVs); 
         if (hasTangents) stride += 3; 
-        
-        int strideBytes = stride * sizeof(float);
-
-        // 1. Position
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, strideBytes, (void*)0);
-        glEnableVertexAttribArray(0);
-
-        int offset = 3;
-        // 2. Normal 
-        if (hasNormals) {
-            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, strideBytes, (void*)(offset * sizeof(float)));
-            glEnableVertexAttribArray(1);
-            offset += 3;
+
+        computeBounds(vertices, stride);
+
+        // Append the simplified index lists after the full one. Meshlets only reorder the
+        // full level's triangles; the simplifier still works from the original order.
+        std::vector<unsigned int> allIndices = indices;
+        if (buildMeshlets) meshlets = MeshletBuilder::build(vertices, stride, allIndices);
+        lods.push_back({ 0, indexCount, 0.0f });
+        for (float ratio : lodRatios) {
+            size_t target = static_cast<size_t>(indices.size() * ratio) / 3 * 3;
+            float error = 0.0f;
+            std::vector<unsigned int> simplified = MeshSimplifier::simplify(vertices, stride, indices, target, &error);
+
+            // Stop once the simplifier can't get meaningfully below the previous level
+            if (simplified.empty() || simplified.size() > static_cast<size_t>(lods.back().indexCount) * 9 / 10) break;
+
+            lods.push_back({ static_cast<unsigned int>(allIndices.size()), static_cast<int>(simplified.size()), error });
+            allIndices.insert(allIndices.end(), simplified.begin(), simplified.end());
         }
+        keepOccluderGeometry(vertices, stride, allIndices);
 
-        // 3. UV 
-        if (hasUVs) {
-            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, strideBytes, (void*)(offset * sizeof(float)));
-            glEnableVertexAttribArray(2);
-            offset += 2;
-        } else {
-            glDisableVertexAttribArray(2);
-            glVertexAttrib2f(2, 0.0f, 0.0f); // Default UV
+        // Vertices and every level's indices go into the shared buffers of their layout
+        geometry = GeometryPool::allocate(GeometryPool::getLayout(hasNormals, hasUVs), vertices, allIndices);
+    }
+
+    // Box around every position, and a sphere around the box center that reaches the farthest vertex
+    void computeBounds(const std::vector<float>& vertices, int stride) {
+        for (size_t i = 0; i + 2 < vertices.size(); i += stride) {
+            bounds.expand(glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]));
         }
-        
-        // 4. Tangent
-        if (hasTangents) {
-            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, strideBytes, (void*)(offset * sizeof(float)));
-            glEnableVertexAttribArray(3);
-        } else {
-            glDisableVertexAttribArray(3);
-            glVertexAttrib3f(3, 1.0f, 0.0f, 0.0f); // Default Tangent (Tangent X-axis)
+        if (bounds.isEmpty()) return;
+
+        boundingSphere.center = bounds.center();
+        float radiusSquared = 0.0f;
+        for (size_t i = 0; i + 2 < vertices.size(); i += stride) {
+            glm::vec3 offset = glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]) - boundingSphere.center;
+            radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+        }
+        boundingSphere.radius = std::sqrt(radiusSquared);
+    }
+
+    // Copies the coarsest level into occluderPositions/occluderIndices, renumbering its vertices
+    void keepOccluderGeometry(const std::vector<float>& vertices, int stride, const std::vector<unsigned int>& allIndices) {
+        const MeshLod& coarsest = lods.back();
+        std::vector<unsigned int> remap(vertices.size() / stride, ~0u);
+        occluderIndices.reserve(coarsest.indexCount);
+        for (int i = 0; i < coarsest.indexCount; ++i) {
+            unsigned int vertex = allIndices[coarsest.firstIndex + i];
+            if (remap[vertex] == ~0u) {
+                remap[vertex] = static_cast<unsigned int>(occluderPositions.size());
+                occluderPositions.push_back(glm::vec3(vertices[vertex * stride], vertices[vertex * stride + 1], vertices[vertex * stride + 2]));
+            }
+            occluderIndices.push_back(remap[vertex]);
         }
+    }
+
+    ~Mesh() {
+        RenderIdTable<Mesh>::release(renderId);
+        GeometryPool::release(geometry);
+    }
+
+    // The render ID belongs to this object, so it can't be copied
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    // The level actually drawn when `lod` is asked for (meshes can have fewer levels than others)
+    const MeshLod& getLod(int lod) const {
+        return lods[std::min(static_cast<size_t>(std::max(lod, 0)), lods.size() - 1)];
+    }
+
+    // The vertex array of the mesh's layout, with every attribute or only the positions.
+    // Every mesh of the layout shares it.
+    unsigned int getVertexArray(bool positionsOnly) const {
+        return GeometryPool::getVertexArray(GeometryPool::get(geometry).layout, positionsOnly);
+    }
+
+    // Where the mesh starts in the pool's buffers. Level and meshlet offsets are relative to getFirstIndex().
+    unsigned int getFirstIndex() const { return GeometryPool::get(geometry).firstIndex; }
+    int getBaseVertex() const { return static_cast<int>(GeometryPool::get(geometry).baseVertex); }
+
+    // The VAO stays bound afterwards, so drawing the same mesh (or another of its layout) again doesn't rebind it.
+    // positionsOnly draws from the position-only stream, for programs that read nothing else.
+    void draw(int lod = 0, bool positionsOnly = false) {
+        GLState::bindVertexArray(getVertexArray(positionsOnly));
+        const MeshLod& level = getLod(lod);
+        glDrawElementsBaseVertex(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT,
+                                 (void*)((getFirstIndex() + level.firstIndex) * sizeof(unsigned int)), getBaseVertex());
+    }
 
-        // Unbind VAO
-        glBindVertexArray(0);
+    // Draws several ranges of the pool's index buffer in one call (see Renderer's meshlet culling).
+    // Offsets are absolute; every range is read with this mesh's base vertex.
+    void drawRanges(const GLsizei* counts, const void* const* offsets, const GLint* baseVertices, int rangeCount, bool positionsOnly = false) {
+        GLState::bindVertexArray(getVertexArray(positionsOnly));
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, GL_UNSIGNED_INT, offsets, rangeCount, baseVertices);
     }
 
-    void draw() {
-        glBindVertexArray(VAO);
-        // We now use glDrawElements instead of glDrawArrays
-        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0); 
-        glBindVertexArray(0);
+    // Draws instanceCount copies. Instance i reads entry baseInstance + i of the
+    // instance stream, which holds its slot in the TransformData buffer (GL 4.2+)
+    void drawInstanced(int instanceCount, unsigned int baseInstance, int lod = 0, bool positionsOnly = false) {
+        GLState::bindVertexArray(getVertexArray(positionsOnly));
+        const MeshLod& level = getLod(lod);
+        glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT,
+                                                      (void*)((getFirstIndex() + level.firstIndex) * sizeof(unsigned int)),
+                                                      instanceCount, getBaseVertex(), baseInstance);
     }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,21 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <cstddef>
+#include <vector>
+
+// Builds lower-detail index lists for a mesh by quadric-error edge collapse
+// (Garland & Heckbert). Vertices are never moved or created: a collapse folds
+// one vertex onto a neighbour, so every level can share the original vertex buffer.
+class MeshSimplifier {
+public:
+    // Returns a new index list over the same vertices with about targetIndexCount indices
+    // (it can stop short if the remaining collapses would damage the shape).
+    // Vertices on open borders and on UV/normal seams stay put, so no cracks appear.
+    // error, if given, receives the largest error accepted, roughly a distance in object units.
+    static std::vector<unsigned int> simplify(const std::vector<float>& vertices, int stride,
+                                              const std::vector<unsigned int>& indices,
+                                              size_t targetIndexCount, float* error = nullptr);
+};
+
+#endif
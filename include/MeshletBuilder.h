@@ -0,0 +1,49 @@
+#ifndef MESHLET_BUILDER_H
+#define MESHLET_BUILDER_H
+
+#include "Bounds.h"
+#include <glm/glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+// A small cluster of neighbouring triangles: a contiguous range of the mesh's
+// index buffer, with the bounds the renderer culls it by.
+struct Meshlet {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+
+    // Local-space sphere around the cluster's vertices
+    BoundingSphere sphere;
+
+    // Every triangle faces away from a camera inside this cone (apex, axis, cutoff).
+    // coneCutoff is 1 when the triangles face too many ways for that to ever happen.
+    glm::vec3 coneApex = glm::vec3(0.0f);
+    glm::vec3 coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    float coneCutoff = 1.0f;
+
+    // True if the camera (in the mesh's local space) sees only the back of every triangle
+    bool isBackFacing(const glm::vec3& camera) const {
+        if (coneCutoff >= 1.0f) return false;
+        glm::vec3 toApex = coneApex - camera;
+        float distance = glm::length(toApex);
+        return distance > 0.0f && glm::dot(toApex, coneAxis) >= coneCutoff * distance;
+    }
+};
+
+// Splits a triangle list into meshlets of at most MaxVertices vertices and
+// MaxTriangles triangles. Clusters are grown greedily from a seed triangle,
+// preferring neighbours that add the fewest new vertices, then ones that stay
+// close to the cluster and face the same way, so the spheres stay tight and
+// the normal cones narrow.
+class MeshletBuilder {
+public:
+    static constexpr size_t MaxVertices = 64;
+    static constexpr size_t MaxTriangles = 124;
+
+    // Reorders the triangles of indices in place so every meshlet is one contiguous
+    // range, and returns the meshlets in index order. The triangles themselves
+    // (and their winding) are unchanged, so drawing the whole range still draws the mesh.
+    static std::vector<Meshlet> build(const std::vector<float>& vertices, int stride, std::vector<unsigned int>& indices);
+};
+
+#endif
@@ -7,23 +7,67 @@
 
 #include "Mesh.h"
 #include "Material.h"
+#include "Impostor.h"
 #include <vector>
 #include <string>
 #include <memory>
 #include <iostream>
 
+// One level of detail of a model (a "LOD <triangleRatio> <screenSize>" line in a .ForceModel)
+struct LodSetting {
+    float triangleRatio; // Fraction of the full triangle count
+    float screenSize;    // Used once the model's height on screen drops below this fraction of the viewport
+};
+
 class Model {
 public:
     std::vector<std::shared_ptr<Mesh>> meshes;
     std::vector<std::shared_ptr<Material>> materials;
     std::string directory;
 
-    Model(const std::string& path) {
+    // Extra levels of detail, most detailed first. Imported meshes get one index list per entry.
+    std::vector<LodSetting> lodSettings;
+
+    // Imported meshes with at least this many triangles are split into meshlets;
+    // smaller ones are cheap enough to cull whole
+    static constexpr size_t MeshletMinTriangles = 4096;
+
+    // Baked by the Renderer the first time an instance is past its impostorDistance
+    std::shared_ptr<Impostor> impostor;
+    bool impostorFailed = false; // Baking didn't work; keep drawing the meshes
+
+    // Used when a .ForceModel doesn't say otherwise
+    static std::vector<LodSetting> defaultLodSettings() {
+        return { { 0.5f, 0.5f }, { 0.25f, 0.25f }, { 0.1f, 0.1f } };
+    }
+
+    Model(const std::string& path, const std::vector<LodSetting>& lods = defaultLodSettings())
+        : lodSettings(lods) {
         loadModel(path);
     }
 
     Model() {} // Default constructor for procedural models
 
+    // Local-space box around all meshes (meshes can be added after construction, so it isn't cached)
+    AABB getBounds() const {
+        AABB box;
+        for (const auto& mesh : meshes) {
+            if (mesh) box.expand(mesh->bounds);
+        }
+        return box;
+    }
+
+    // Sphere for culling the whole model: the mesh's own sphere if there is only one
+    BoundingSphere getBoundingSphere() const {
+        if (meshes.size() == 1 && meshes[0]) return meshes[0]->boundingSphere;
+        AABB box = getBounds();
+        BoundingSphere sphere;
+        if (box.isEmpty()) return sphere;
+        sphere.center = box.center();
+        sphere.radius = glm::length(box.extents());
+        return sphere;
+    }
+
 private:
     void loadModel(const std::string& path) {
         Assimp::Importer importer;
@@ -109,8 +153,20 @@ private:
                 indices.push_back(face.mIndices[j]);
         }
 
+        // 6. Levels of detail, simplified from the full index list
+        std::vector<float> lodRatios;
+        for (const auto& lod : lodSettings) lodRatios.push_back(lod.triangleRatio);
+
+        // 7. High-poly meshes are split into meshlets, so the renderer can skip the parts it can't see
+        bool buildMeshlets = indices.size() / 3 >= MeshletMinTriangles;
+
         // Return a shared pointer to the newly constructed Mesh
-        return std::make_shared<Mesh>(vertices, indices, mesh->HasNormals(), mesh->mTextureCoords[0] != nullptr);
+        auto result = std::make_shared<Mesh>(vertices, indices, mesh->HasNormals(), mesh->mTextureCoords[0] != nullptr, lodRatios, buildMeshlets);
+        std::cout << "  LOD triangles:";
+        for (const auto& lod : result->lods) std::cout << " " << lod.indexCount / 3;
+        if (!result->meshlets.empty()) std::cout << " | meshlets: " << result->meshlets.size();
+        std::cout << "\n";
+        return result;
     }
 };
 
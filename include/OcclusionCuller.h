@@ -0,0 +1,76 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <glm/glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Bounds.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FORCE_OCCLUSION_SSE 1
+#endif
+
+// Software occlusion culling. A few big meshes (walls, buildings, terrain) are
+// marked as occluders and rasterized on the CPU into a small depth buffer; every
+// other object's box is then tested against it, and objects whose box is behind
+// the occluders at every pixel it covers are skipped. Everything happens on the
+// CPU in the same frame, so there is no GPU readback and no frame of latency.
+//
+// The buffer stores 1/w (bigger is nearer), which interpolates linearly across a
+// triangle on screen. Rows are split into bands rasterized on the JobSystem
+// workers, four pixels at a time with SSE2.
+class OcclusionCuller {
+public:
+    static constexpr int Width = 256;
+    static constexpr int Height = 128;
+    static constexpr int BandHeight = 8; // Rows per job
+
+    // Clears the depth buffer and the occluder list for a new view
+    void beginFrame(const glm::mat4& viewProjection);
+
+    // Queues a triangle mesh (positions in object space) to be rasterized.
+    // The arrays must stay alive until rasterize() returns.
+    void addOccluder(const glm::vec3* positions, const unsigned int* indices, size_t indexCount, const glm::mat4& world);
+
+    // Transforms and rasterizes every queued occluder
+    void rasterize();
+
+    // True if the world-space box is hidden behind the occluders at every pixel it covers.
+    // Boxes crossing the near plane are never hidden.
+    bool isOccluded(const AABB& worldBox) const;
+
+    // Triangles that reached the depth buffer last rasterize() (after clipping)
+    size_t getTrianglesRasterized() const { return m_triangles.size(); }
+
+    // Depth buffer, row 0 at the bottom of the screen, 0 where nothing was drawn
+    const float* getDepth() const { return m_depth.data(); }
+
+private:
+    struct Occluder {
+        const glm::vec3* positions;
+        const unsigned int* indices;
+        size_t indexCount;
+        glm::mat4 world;
+    };
+
+    // A triangle after clipping, in pixel coordinates, ready for the bands
+    struct ScreenTriangle {
+        float x[3], y[3];
+        float invW[3];
+        int minY, maxY; // Rows it touches
+    };
+
+    // Clips one clip-space triangle to the near plane and appends what is left
+    static void setupTriangle(const glm::vec4 clip[3], std::vector<ScreenTriangle>& out);
+
+    void rasterizeBand(int band);
+
+    glm::mat4 m_viewProjection = glm::mat4(1.0f);
+    std::vector<Occluder> m_occluders;
+    std::vector<std::vector<ScreenTriangle>> m_threadTriangles; // Setup output of each worker
+    std::vector<ScreenTriangle> m_triangles;
+    std::vector<float> m_depth = std::vector<float>(Width * Height, 0.0f);
+};
+
+#endif
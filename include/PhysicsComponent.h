@@ -3,6 +3,7 @@
 
 #include "Component.h"
 #include "Entity.h"
+#include "Reflection.h"
 #include <glm/glm/glm.hpp>
 #include <GLFW/glfw3.h>
 
@@ -38,10 +39,12 @@ public:
         velocity.y = upwardForce;
     }
 
-    static std::shared_ptr<Component> deserialize(std::istringstream& iss, GLFWwindow* window) {
-        // PhysicsComponent has no parameters in its constructor
-        return std::make_shared<PhysicsComponent>();
-    }
+    // Scene file: [gravity [terminalVelocity]]
+    // The velocity is runtime state, so it only shows up in binary snapshots.
+    REFLECT_COMPONENT(PhysicsComponent,
+        REFLECT_FIELD(PhysicsComponent, gravity),
+        REFLECT_FIELD(PhysicsComponent, terminalVelocity),
+        REFLECT_FIELD_FLAGS(PhysicsComponent, velocity, Reflection::FieldNoText))
 };
 
 #endif
\ No newline at end of file
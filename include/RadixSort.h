@@ -0,0 +1,59 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// LSD radix sort on a 64-bit `key` member, one byte per pass: O(n) and stable.
+// Passes where every key has the same byte are skipped, which is the common
+// case for the high bytes of a render queue. `scratch` is reused between calls
+// so a sort doesn't allocate once it has warmed up.
+template <typename T>
+void radixSortByKey(std::vector<T>& items, std::vector<T>& scratch) {
+    const size_t count = items.size();
+    if (count < 2) return;
+    scratch.resize(count);
+
+    // 1. Count every byte of every key in one sweep
+    uint32_t histograms[8][256];
+    std::memset(histograms, 0, sizeof(histograms));
+    for (const T& item : items) {
+        uint64_t key = item.key;
+        for (int pass = 0; pass < 8; ++pass) {
+            histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+        }
+    }
+
+    // 2. Scatter by each byte, lowest first, ping-ponging between the two buffers
+    T* source = items.data();
+    T* destination = scratch.data();
+    for (int pass = 0; pass < 8; ++pass) {
+        uint32_t* histogram = histograms[pass];
+        uint32_t first = static_cast<uint32_t>((source[0].key >> (pass * 8)) & 0xFF);
+        if (histogram[first] == count) continue; // All keys share this byte
+
+        uint32_t offsets[256];
+        uint32_t sum = 0;
+        for (int bucket = 0; bucket < 256; ++bucket) {
+            offsets[bucket] = sum;
+            sum += histogram[bucket];
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t bucket = static_cast<uint32_t>((source[i].key >> (pass * 8)) & 0xFF);
+            destination[offsets[bucket]++] = source[i];
+        }
+
+        T* swap = source;
+        source = destination;
+        destination = swap;
+    }
+
+    // 3. An odd number of scatters leaves the result in scratch
+    if (source != items.data()) {
+        items.swap(scratch);
+    }
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef RANGE_ALLOCATOR_H
+#define RANGE_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Hands out ranges of a fixed-size space (vertices of a buffer, indices, ...),
+// first fit from a free list kept sorted by offset. Freed ranges merge with
+// free neighbours, so the list stays as short as the holes actually are.
+// Only bookkeeping: whoever owns the buffer copies the data (see GeometryPool).
+class RangeAllocator {
+public:
+    static constexpr uint32_t Invalid = ~0u;
+
+    // A range compact() moved
+    struct Move {
+        uint32_t from;
+        uint32_t to;
+        uint32_t size;
+    };
+
+    explicit RangeAllocator(uint32_t capacity = 0);
+
+    // Offset of a free range of `size`, or Invalid if no hole is big enough
+    uint32_t allocate(uint32_t size);
+
+    // Gives back a range allocate() returned
+    void free(uint32_t offset);
+
+    // Adds space at the end; allocations keep their offsets
+    void grow(uint32_t capacity);
+
+    // Slides every allocation down to the start, in offset order, so all the free
+    // space is one range at the end. Returns what moved, lowest offsets first.
+    std::vector<Move> compact();
+
+    uint32_t getCapacity() const { return m_capacity; }
+    uint32_t getUsed() const { return m_used; }
+    size_t getAllocationCount() const { return m_allocated.size(); }
+    size_t getFreeRangeCount() const { return m_free.size(); }
+    uint32_t getLargestFreeRange() const;
+
+    // 0 when the free space is one range, towards 1 the more it is split into small holes
+    float getFragmentation() const;
+
+private:
+    uint32_t m_capacity = 0;
+    uint32_t m_used = 0;
+    std::map<uint32_t, uint32_t> m_free;      // Offset -> size
+    std::map<uint32_t, uint32_t> m_allocated; // Offset -> size
+
+    // Adds a free range, merged with the free ranges right before and after it
+    void insertFree(uint32_t offset, uint32_t size);
+};
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef REFLECTION_H
+#define REFLECTION_H
+
+#include <glm/glm/glm.hpp>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <string>
+#include <vector>
+
+// A tiny compile-time reflection layer.
+// Each reflected class lists its serializable members once (see REFLECT_FIELD),
+// and everything else - text parsing, binary blobs, snapshot diffs and
+// default values - is driven by that table instead of hand-written code.
+namespace Reflection {
+
+enum class FieldType : uint8_t { Float, Int, Bool, Vec2, Vec3, String };
+
+// Maps a C++ member type to its FieldType at compile time
+template <typename T> struct FieldTypeOf;
+template <> struct FieldTypeOf<float>       { static constexpr FieldType value = FieldType::Float; };
+template <> struct FieldTypeOf<int>         { static constexpr FieldType value = FieldType::Int; };
+template <> struct FieldTypeOf<bool>        { static constexpr FieldType value = FieldType::Bool; };
+template <> struct FieldTypeOf<glm::vec2>   { static constexpr FieldType value = FieldType::Vec2; };
+template <> struct FieldTypeOf<glm::vec3>   { static constexpr FieldType value = FieldType::Vec3; };
+template <> struct FieldTypeOf<std::string> { static constexpr FieldType value = FieldType::String; };
+
+enum FieldFlags : uint8_t {
+    FieldDefault = 0,
+    FieldNoText  = 1 << 0  // Runtime state: kept in binary snapshots, never read from scene text
+};
+
+struct FieldInfo {
+    const char* name;
+    FieldType type;
+    uint8_t flags;
+    // Returns the address of this member inside an object of the reflected class
+    void* (*address)(void* object);
+
+    const void* get(const void* object) const { return address(const_cast<void*>(object)); }
+    void* get(void* object) const { return address(object); }
+};
+
+struct TypeInfo {
+    const char* name;
+    const FieldInfo* fields;
+    uint32_t fieldCount;
+    const void* defaults; // A default-constructed instance, the baseline for diffs and blobs
+};
+
+// Masks are one bit per field, so a type can reflect at most 32 members
+constexpr uint32_t MaxFields = 32;
+
+inline uint32_t fieldBit(uint32_t index) { return 1u << index; }
+
+// Size in bytes of a plain-data field (String is variable-length and handled separately)
+inline size_t fieldSize(FieldType type) {
+    switch (type) {
+        case FieldType::Float: return sizeof(float);
+        case FieldType::Int:   return sizeof(int);
+        case FieldType::Bool:  return sizeof(bool);
+        case FieldType::Vec2:  return sizeof(glm::vec2);
+        case FieldType::Vec3:  return sizeof(glm::vec3);
+        default:               return 0;
+    }
+}
+
+inline bool fieldEquals(const FieldInfo& field, const void* a, const void* b) {
+    if (field.type == FieldType::String) {
+        return *static_cast<const std::string*>(field.get(a)) == *static_cast<const std::string*>(field.get(b));
+    }
+    return std::memcmp(field.get(a), field.get(b), fieldSize(field.type)) == 0;
+}
+
+inline void copyField(const FieldInfo& field, void* dst, const void* src) {
+    if (field.type == FieldType::String) {
+        *static_cast<std::string*>(field.get(dst)) = *static_cast<const std::string*>(field.get(src));
+    } else {
+        std::memcpy(field.get(dst), field.get(src), fieldSize(field.type));
+    }
+}
+
+// Returns the index of the named field, or -1
+inline int findField(const TypeInfo& info, const char* name) {
+    for (uint32_t i = 0; i < info.fieldCount; ++i) {
+        if (std::strcmp(info.fields[i].name, name) == 0) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+// --- Snapshot diffing ---
+// Returns a mask with a bit set for every field that differs between a and b
+inline uint32_t diff(const TypeInfo& info, const void* a, const void* b) {
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < info.fieldCount; ++i) {
+        if (!fieldEquals(info.fields[i], a, b)) mask |= fieldBit(i);
+    }
+    return mask;
+}
+
+// --- Default values ---
+inline void resetToDefaults(const TypeInfo& info, void* object) {
+    for (uint32_t i = 0; i < info.fieldCount; ++i) {
+        copyField(info.fields[i], object, info.defaults);
+    }
+}
+
+// --- Text ---
+// Reads the text-visible fields in declaration order, the same way the old
+// hand-written deserializers did. Reading stops at the first field that is
+// missing, so trailing fields keep their default values.
+// Returns a mask of the fields that were actually read.
+inline uint32_t readText(const TypeInfo& info, void* object, std::istream& in) {
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < info.fieldCount; ++i) {
+        const FieldInfo& field = info.fields[i];
+        if (field.flags & FieldNoText) continue;
+
+        bool ok = false;
+        switch (field.type) {
+            case FieldType::Float: { float v;       if (in >> v) { *static_cast<float*>(field.get(object)) = v; ok = true; } break; }
+            case FieldType::Int:   { int v;         if (in >> v) { *static_cast<int*>(field.get(object)) = v; ok = true; } break; }
+            case FieldType::Bool:  { bool v;        if (in >> v) { *static_cast<bool*>(field.get(object)) = v; ok = true; } break; }
+            case FieldType::Vec2:  { glm::vec2 v;   if (in >> v.x >> v.y) { *static_cast<glm::vec2*>(field.get(object)) = v; ok = true; } break; }
+            case FieldType::Vec3:  { glm::vec3 v;   if (in >> v.x >> v.y >> v.z) { *static_cast<glm::vec3*>(field.get(object)) = v; ok = true; } break; }
+            case FieldType::String:{ std::string v; if (in >> v) { *static_cast<std::string*>(field.get(object)) = v; ok = true; } break; }
+        }
+        if (!ok) break;
+        mask |= fieldBit(i);
+    }
+    return mask;
+}
+
+// --- Binary ---
+// Blob layout: [uint32 mask][value of every field whose bit is set].
+// Only fields that differ from the type's defaults are written, and plain-data
+// values are stored as raw bytes so loading is a straight memcpy per field.
+// Strings are stored as [uint32 length][chars].
+inline void writeBinary(const TypeInfo& info, const void* object, std::vector<uint8_t>& out) {
+    uint32_t mask = diff(info, object, info.defaults);
+    const uint8_t* maskBytes = reinterpret_cast<const uint8_t*>(&mask);
+    out.insert(out.end(), maskBytes, maskBytes + sizeof(mask));
+
+    for (uint32_t i = 0; i < info.fieldCount; ++i) {
+        if (!(mask & fieldBit(i))) continue;
+        const FieldInfo& field = info.fields[i];
+
+        if (field.type == FieldType::String) {
+            const std::string& s = *static_cast<const std::string*>(field.get(object));
+            uint32_t length = static_cast<uint32_t>(s.size());
+            const uint8_t* lengthBytes = reinterpret_cast<const uint8_t*>(&length);
+            out.insert(out.end(), lengthBytes, lengthBytes + sizeof(length));
+            out.insert(out.end(), s.begin(), s.end());
+        } else {
+            const uint8_t* bytes = static_cast<const uint8_t*>(field.get(object));
+            out.insert(out.end(), bytes, bytes + fieldSize(field.type));
+        }
+    }
+}
+
+// Reads a blob written by writeBinary into an object that already holds default values.
+// Advances cursor past the blob. Returns false if the blob is truncated.
+inline bool readBinary(const TypeInfo& info, void* object, const uint8_t*& cursor, const uint8_t* end, uint32_t* loadedMask = nullptr) {
+    uint32_t mask;
+    if (end - cursor < static_cast<ptrdiff_t>(sizeof(mask))) return false;
+    std::memcpy(&mask, cursor, sizeof(mask));
+    cursor += sizeof(mask);
+
+    for (uint32_t i = 0; i < info.fieldCount; ++i) {
+        if (!(mask & fieldBit(i))) continue;
+        const FieldInfo& field = info.fields[i];
+
+        if (field.type == FieldType::String) {
+            uint32_t length;
+            if (end - cursor < static_cast<ptrdiff_t>(sizeof(length))) return false;
+            std::memcpy(&length, cursor, sizeof(length));
+            cursor += sizeof(length);
+            if (end - cursor < static_cast<ptrdiff_t>(length)) return false;
+            static_cast<std::string*>(field.get(object))->assign(reinterpret_cast<const char*>(cursor), length);
+            cursor += length;
+        } else {
+            size_t size = fieldSize(field.type);
+            if (end - cursor < static_cast<ptrdiff_t>(size)) return false;
+            std::memcpy(field.get(object), cursor, size);
+            cursor += size;
+        }
+    }
+
+    if (loadedMask) *loadedMask = mask;
+    return true;
+}
+
+} // namespace Reflection
+
+// Describes one member of Class. The member type is deduced, so the table
+// can't drift out of sync with the declaration.
+#define REFLECT_FIELD_FLAGS(Class, member, fieldFlags)                                         \
+    Reflection::FieldInfo{ #member, Reflection::FieldTypeOf<decltype(Class::member)>::value,   \
+        static_cast<uint8_t>(fieldFlags),                                                      \
+        [](void* object) -> void* { return &static_cast<Class*>(object)->member; } }
+
+#define REFLECT_FIELD(Class, member) REFLECT_FIELD_FLAGS(Class, member, Reflection::FieldDefault)
+
+// Declares the reflection table of a component. Place it inside the class body:
+//     REFLECT_COMPONENT(LightComponent,
+//         REFLECT_FIELD(LightComponent, color),
+//         REFLECT_FIELD(LightComponent, intensity))
+// The class must be default-constructible; that instance provides the defaults.
+#define REFLECT_COMPONENT(Class, ...)                                                          \
+    static const Reflection::TypeInfo& staticTypeInfo() {                                      \
+        static const Class defaults{};                                                         \
+        static const Reflection::FieldInfo fields[] = { __VA_ARGS__ };                         \
+        static_assert(sizeof(fields) / sizeof(fields[0]) <= Reflection::MaxFields,             \
+                      "Too many reflected fields in " #Class);                                 \
+        static const Reflection::TypeInfo info{ #Class, fields,                                \
+            static_cast<uint32_t>(sizeof(fields) / sizeof(fields[0])), &defaults };            \
+        return info;                                                                           \
+    }                                                                                          \
+    const Reflection::TypeInfo* getTypeInfo() const override { return &staticTypeInfo(); }
+
+#endif
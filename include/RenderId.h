@@ -0,0 +1,51 @@
+#ifndef RENDER_ID_H
+#define RENDER_ID_H
+
+#include <cstdint>
+#include <vector>
+
+// Small, dense IDs for render resources (meshes, materials, shaders), so draw
+// packets can name them with plain integers instead of shared_ptrs.
+// IDs are reused after release, which keeps them small enough to pack into a sort key.
+template <typename T>
+class RenderIdTable {
+public:
+    static uint32_t acquire(T* object) {
+        Storage& table = storage();
+        if (!table.freeIds.empty()) {
+            uint32_t id = table.freeIds.back();
+            table.freeIds.pop_back();
+            table.objects[id] = object;
+            return id;
+        }
+        table.objects.push_back(object);
+        return static_cast<uint32_t>(table.objects.size() - 1);
+    }
+
+    static void release(uint32_t id) {
+        Storage& table = storage();
+        if (id >= table.objects.size()) return;
+        table.objects[id] = nullptr;
+        table.freeIds.push_back(id);
+    }
+
+    static T* get(uint32_t id) {
+        const Storage& table = storage();
+        return id < table.objects.size() ? table.objects[id] : nullptr;
+    }
+
+private:
+    struct Storage {
+        std::vector<T*> objects;
+        std::vector<uint32_t> freeIds;
+    };
+
+    // Never destroyed: resources kept in other statics (like ResourceManager's maps)
+    // release their IDs during exit, possibly after a normal static would be gone
+    static Storage& storage() {
+        static Storage* table = new Storage();
+        return *table;
+    }
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "FramePacket.h"
+
+struct GLFWwindow;
+
+// Owns the GL context on a thread of its own, so that simulating frame N+1
+// overlaps drawing frame N. The simulation fills one of two FramePackets
+// (beginPacket()) and hands it over with submit(); the render thread draws it
+// and swaps while the simulation moves on to the other one.
+//
+// submit() waits until the render thread has taken the previous packet, so
+// the simulation is never more than one frame ahead of the screen, and a
+// packet is never written while it is being drawn.
+class RenderThread {
+public:
+    RenderThread() {}
+    ~RenderThread() { stop(); }
+
+    // Releases the window's context from the calling thread and starts drawing on the
+    // new one. render is called there for each packet, before the swap.
+    void start(GLFWwindow* window, std::function<void(const FramePacket&)> render);
+
+    // The packet to fill for the next frame. It isn't being read.
+    FramePacket& beginPacket() { return packets[writeIndex]; }
+
+    // Hands the packet from beginPacket() over. Returns once the render thread has it.
+    void submit();
+
+    // Lets the render thread finish the frame it is on, joins it, and makes the
+    // context current on the calling thread again
+    void stop();
+
+    bool isRunning() const { return thread.joinable(); }
+
+private:
+    void run();
+
+    GLFWwindow* window = nullptr;
+    std::function<void(const FramePacket&)> render;
+    std::thread thread;
+
+    FramePacket packets[2];
+    int writeIndex = 0;  // Packet the simulation fills
+    int pending = -1;    // Packet handed over but not yet taken, or -1
+    bool quit = false;
+    std::mutex mutex;
+    std::condition_variable wake;
+};
+
+#endif
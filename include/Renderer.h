@@ -2,26 +2,134 @@
 #define RENDERER_H
 
 #include <glm/glm/glm.hpp>
+#include <cstdint>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 #include "Shader.h"
 #include "Model.h"
 #include "Material.h"
 #include "CameraComponent.h"
+#include "Frustum.h"
+#include "Impostor.h"
+#include "OcclusionCuller.h"
+#include "LightClusters.h"
+#include "DeferredShading.h"
+#include "FramePacket.h"
 
 class Entity;
+class RendererComponent;
 
-struct PointLightData {
+// CPU mirror of the std140 FrameData uniform block (see Documentation.txt).
+// Member order and padding must match the GLSL declaration exactly.
+constexpr int MaxFrameLights = 64;
+
+struct FrameLightData {
     glm::vec3 position;
-    glm::vec3 color;
     float intensity;
+    glm::vec3 color;
+    float padding;
+};
+
+struct FrameData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 viewPos;
+    int numLights;
+    FrameLightData lights[MaxFrameLights];
+};
+
+static_assert(sizeof(FrameLightData) == 32, "FrameLightData must match the std140 Light struct");
+static_assert(sizeof(FrameData) == 144 + 32 * MaxFrameLights, "FrameData must match the std140 FrameData block");
+
+// Per-frame counters. A frame starts at beginScene().
+struct RenderStats {
+    unsigned int drawCalls = 0;
+    unsigned int instances = 0; // Meshes drawn; more than drawCalls when batches were instanced
+    unsigned int objectsVisible = 0; // Renderers that passed frustum culling
+    unsigned int objectsCulled = 0;  // Renderers outside the frustum
+    unsigned int subtreesCulled = 0; // Hierarchies skipped with a single box test
+    unsigned int objectsOccluded = 0;    // Renderers in view but hidden behind occluders
+    unsigned int occluders = 0;          // Occluders rasterized into the CPU depth buffer
+    unsigned int occluderTriangles = 0;  // Their triangles that reached it
+    float occlusionRasterMs = 0.0f;      // Time spent rasterizing them
+    float occlusionTestMs = 0.0f;        // Time spent testing the other renderers
+    unsigned int gpuInstances = 0;       // Instances handed to the GPU culling pass
+    unsigned int gpuMultiDraws = 0;      // glMultiDrawElementsIndirect calls they were drawn with
+    unsigned int indirectCommands = 0;   // Commands in the CPU path's multi-draws (meshes and meshlet runs)
+    unsigned int bvhNodesVisited = 0; // Spatial index nodes tested by extractFrame()
+    float queueBuildMs = 0.0f;        // Time buildRenderQueue() took, culling and merging included
+    unsigned int queueChunks = 0;     // Jobs it was split into
+    unsigned int clusterLights = 0;      // Lights sorted into clusters this frame
+    unsigned int clusterAssignments = 0; // Entries in all the cluster light lists together
+    unsigned int clusterMaxLights = 0;   // Longest list of a single cluster
+    float clusterBuildMs = 0.0f;         // Time spent assigning the lights
+    unsigned int lightVolumes = 0;       // Lights drawn by the deferred lighting pass
+    float gpuFrameMs = 0.0f;             // GPU time of endScene, measured two frames ago
+    float depthPrepassGpuMs = 0.0f;      // GPU time of the depth prepass, two frames ago
+    float opaqueGpuMs = 0.0f;            // GPU time of the opaque draws that shade (or fill the G-buffer), two frames ago
+    unsigned int opaqueFragments = 0;    // Fragments those draws shaded, two frames ago
+    float overdraw = 0.0f;               // opaqueFragments per pixel of the viewport
+    unsigned int meshletsTested = 0;  // Meshlets of visible high-poly meshes checked this frame
+    unsigned int meshletsCulled = 0;  // Of those, off screen or facing away
+    unsigned int meshletTrianglesCulled = 0; // Triangles not submitted because of that
+    unsigned int trianglesDrawn = 0;
+    unsigned int lodSwitches = 0;     // Renderers that changed level of detail this frame
+    unsigned int impostors = 0;       // Distant renderers drawn as impostor quads
+    unsigned int impostorsBaked = 0;  // Impostor atlases rendered this frame
+    unsigned int uniformLookups = 0;
+    unsigned int uniformUploads = 0;
+    unsigned int uniformUploadsSkipped = 0;
+    unsigned int frameDataUploads = 0;
+    unsigned int shaderSwitches = 0;   // Draws that had to bind a different program
+    unsigned int materialSwitches = 0; // Draws that had to bind a different material
+    unsigned int materialsBatched = 0; // Material changes inside a draw, between materials that share textures (see TextureArrays)
+    unsigned int meshSwitches = 0;     // Draws of a different mesh (meshes of one GeometryPool layout share a vertex array)
+    unsigned int materialUploads = 0;  // Material table slots rewritten
+    unsigned int transformBytesUploaded = 0; // TransformData bytes sent this frame
+    unsigned int transformUploadSpans = 0;   // Ranges those bytes were sent in
+    unsigned int glBinds = 0;        // Program/VAO/texture/buffer binds sent to GL
+    unsigned int glBindsSkipped = 0; // Binds GLState dropped as redundant
 };
 
-struct DrawCommand {
-    std::shared_ptr<Mesh> mesh;
-    std::shared_ptr<Material> material;
-    glm::mat4 transform;
+// One queued draw. Only integer IDs, so building and sorting the queue never
+// touches a reference count. Resolved through RenderIdTable when drawn.
+struct RenderPacket {
+    uint64_t key;          // See makeSortKey()
+    uint32_t mesh;         // Mesh::renderId
+    uint8_t lod;           // Level of detail of the mesh to draw
+    uint32_t material;     // Material::renderId
+    uint32_t transform;    // Index into the frame's model matrices
+    int32_t transformSlot; // TransformBuffer slot holding the same matrix, -1 if there is none
 };
 
+// Sort key layout, most significant first:
+//   unused (2 bits) | shader (10) | material (12) | mesh (16) | lod (2) | depth (22)
+// Sorting the keys groups draws by shader, then material, then mesh and its level
+// of detail, and orders equal state front to back, so the depth test rejects hidden
+// pixels early. IDs past their field width still sort correctly, they just stop
+// grouping perfectly.
+inline uint64_t makeSortKey(uint32_t shader, uint32_t material, uint32_t mesh, uint32_t lod, float normalizedDepth) {
+    normalizedDepth = glm::clamp(normalizedDepth, 0.0f, 1.0f);
+    uint64_t depth = static_cast<uint64_t>(normalizedDepth * 0x3FFFFF);
+
+    return (static_cast<uint64_t>(shader) & 0x3FF) << 52
+         | (static_cast<uint64_t>(material) & 0xFFF) << 40
+         | (static_cast<uint64_t>(mesh) & 0xFFFF) << 24
+         | (static_cast<uint64_t>(lod) & 0x3) << 22
+         | depth;
+}
+
+// The key with another material ID
+inline uint64_t sortKeyWithMaterial(uint64_t key, uint32_t material) {
+    return (key & ~(static_cast<uint64_t>(0xFFF) << 40)) | (static_cast<uint64_t>(material) & 0xFFF) << 40;
+}
+
+// Depth field of a key, near to far
+inline uint32_t sortKeyDepth(uint64_t key) {
+    return static_cast<uint32_t>(key & 0x3FFFFF);
+}
+
 class Renderer {
 public:
     Renderer();
@@ -33,24 +141,305 @@ public:
     // Clear frame buffers
     void clear();
 
-    // Prepare the scene for rendering (set global uniforms)
-    void beginScene(CameraComponent* camera);
+    // Simulation side: copies what the frame needs out of the scene into the packet.
+    // Renderers come from querying RendererComponent::spatialIndex with the camera
+    // frustum, so only those whose box touches the view are looked at.
+    void extractFrame(CameraComponent* camera, FramePacket& packet);
 
-    // Submit an Entity for drawing
-    void submitNode(std::shared_ptr<Entity> node);
+    // Adds an Entity (and its children) to the packet's renderables, for scenes drawn
+    // by hierarchy instead of through extractFrame's query. Culling happens in endScene.
+    void extractNode(std::shared_ptr<Entity> node, FramePacket& packet);
 
-    // Draw a mesh with a material and model matrix
-    void draw(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material, const glm::mat4& modelMatrix);
+    // Adds the collider boxes renderDebug draws
+    void extractDebug(FramePacket& packet);
 
-    // End the scene rendering
+    // Drawing side: starts a frame from an extracted packet (set global uniforms).
+    // The packet must stay untouched until endScene() returns.
+    void beginScene(const FramePacket& packet);
+
+    // Draw a mesh with a material and model matrix. Shaders with the TransformData block read
+    // the matrix from transformSlot; without one, the draw borrows a slot for this frame.
+    void draw(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material, const glm::mat4& modelMatrix, int transformSlot = -1);
+
+    // Sort the queued packets and draw them
     void endScene();
 
-    // Render debug wireframes for lights and colliders
-    void renderDebug(std::shared_ptr<Model> cubeModel);
+    // Render debug wireframes for the packet's lights and colliders
+    void renderDebug(std::shared_ptr<Model> cubeModel, const FramePacket& packet);
+
+    // Counters for the frame in progress (or the last one, if called before beginScene)
+    RenderStats getStats() const;
+
+    // Skip renderers outside the camera's view (on by default)
+    bool frustumCulling = true;
+
+    // Skip renderers hidden behind the ones marked RendererComponent::occluder,
+    // found with a small CPU depth buffer (see OcclusionCuller)
+    bool occlusionCulling = true;
+
+    // Cull and build the draws of most renderers on the GPU instead (GL 4.3+, see GpuCuller).
+    // Worth it for very large instance counts; the CPU work no longer grows with them.
+    // GpuCuller reads the renderers straight from the scene, so it is skipped while
+    // renderThread is set. The --gpu-culling flag turns it on (and implies --sync).
+    bool gpuCulling = false;
+
+    // Frames are drawn on another thread than the one that extracts them (see RenderThread)
+    bool renderThread = false;
+
+    // Skip the meshlets of high-poly meshes that are off screen (see MeshletBuilder).
+    // Only the full level of detail has meshlets.
+    bool meshletCulling = true;
+
+    // Also skip the meshlets that face away from the camera, by their normal cones. Meshes
+    // are drawn without face culling, so only turn this on if every high-poly mesh is
+    // closed: the inside of an open one would lose clusters when seen from behind.
+    bool meshletConeCulling = false;
+
+    // Sort every light into clusters of the view (see LightClusters) and upload the lists
+    // to the ClusterLights, ClusterGrid and ClusterLightIndices storage blocks (GL 4.3+).
+    // Shaders that read them aren't limited to the 64 lights of FrameData.
+    bool clusteredLighting = true;
+
+    // Draw opaque meshes into a G-buffer and light them afterwards, one box per light
+    // (see DeferredShading), instead of lighting every fragment in the material shaders.
+    // Can be switched at any time; F3 shows the GPU time of both.
+    bool deferredShading = false;
+
+    // Draw the opaque meshes depth-only first, roughly front to back, from their
+    // position-only streams (see GeometryPool), then shade them with GL_LEQUAL and
+    // depth writes off, so each covered pixel runs a material fragment shader once.
+    // Forward frames only. The material vertex shaders must compute gl_Position as
+    // projection * view * (model * position) and declare "invariant gl_Position;", like
+    // the prepass does, or the depths won't be equal. F3 shows the opaque fragments
+    // shaded and their GPU time.
+    bool depthPrepass = false;
+
+    // Draw simpler levels of detail for models that are small on screen (see Model::lodSettings).
+    // A model only changes level once its size is lodHysteresis (10%) past the threshold.
+    bool meshLods = true;
+    float lodHysteresis = 0.1f;
+
+    // Draw renderers beyond their impostorDistance as impostor quads, and the size of
+    // the atlases baked for them (framesPerSide^2 views of frameSize^2 texels)
+    bool impostors = true;
+    int impostorFrames = 8;
+    int impostorFrameSize = 64;
 
 private:
+    // Scene uniform handles of one shader, resolved the first time it draws
+    struct LightUniforms {
+        UniformHandle position, color, intensity;
+    };
+    struct SceneUniforms {
+        bool usesFrameData;     // Camera and lights come from the FrameData block instead of uniforms
+        bool usesTransformData; // Model matrix comes from the TransformData storage block
+        bool usesMaterialLayers; // Takes its material per instance and samples texture arrays (needs TransformData)
+        UniformHandle view, projection, viewPos, numLights, model;
+        std::vector<LightUniforms> lights; // One entry per element of the shader's lights[] array
+    };
+    const SceneUniforms& getSceneUniforms(const Shader& shader);
+
+    // Binds whatever program, material and mesh state differs from the previous draw.
+    // The program is the material's (its geometry pass variant during the deferred geometry
+    // pass), or m_shaderOverride while one is set.
+    const SceneUniforms& bindState(Mesh& mesh, Material& material);
+
+    // Binds state, then draws a single mesh
+    void drawMesh(Mesh& mesh, Material& material, const glm::mat4& modelMatrix, int transformSlot, int lod);
+
+    // Level of detail for a renderer this frame, from its world sphere's size on screen.
+    // Counts a change of level in lodSwitches. The level is kept per transform slot, so
+    // calls for different renderables can run on different threads.
+    int selectLod(const FramePacket::Renderable& renderable, const BoundingSphere& worldSphere, unsigned int& lodSwitches);
+    std::vector<uint8_t> m_lodLevels; // Last level of each transform slot, for the hysteresis
+
+    // The model's impostor, baked on first use. Null if it couldn't be baked.
+    Impostor* getImpostor(Model& model);
+
+    // Draws the queued impostor quads, one instanced draw per atlas
+    void drawImpostors();
+
+    struct ImpostorDraw {
+        Impostor* impostor;
+        Impostor::Instance instance;
+    };
+    std::vector<ImpostorDraw> m_impostorQueue;
+    std::vector<Impostor::Instance> m_impostorInstances;
+
+    // A run of sorted packets drawn with one call
+    struct DrawBatch {
+        uint32_t first;        // Index of the first packet in renderQueue
+        uint32_t count;        // Packets drawn
+        uint32_t baseInstance; // Start in the instance stream, or NotInstanced
+        uint32_t firstCommand = 0; // Commands in m_indirectCommands, for batches drawn with drawIndirect
+        uint32_t commandCount = 0;
+        bool layered = false;      // The instance stream carries each packet's material (usesMaterialLayers)
+    };
+    static constexpr uint32_t NotInstanced = ~0u;
+    std::vector<DrawBatch> m_batches;
+
+    // True if the two materials can share a batch of a shader that reads MaterialLayers
+    bool sharesTextures(uint32_t material, uint32_t other) const;
+
+    // Sort key ID of each set of materials that share their textures: the renderId of
+    // a live material in it, by program and pages (see Material::sortId)
+    std::unordered_map<uint64_t, uint32_t> m_textureSetIds;
+    uint32_t getSortId(Material& material);
+
+    // The m_textureSetIds key of the material, false if it doesn't draw from texture arrays
+    bool getTextureSetKey(Material& material, uint64_t& key);
+
+    // Draws one batch with whatever call suits it
+    void drawBatch(const DrawBatch& batch);
+
+    // Draws every batch and the GPU culling pass's groups depth-only, nearest batches
+    // first, and leaves the depth test as GL_LEQUAL without writes
+    void drawDepthPrepass();
+    std::shared_ptr<Shader> m_depthShader;          // Model matrix as a uniform
+    std::shared_ptr<Shader> m_depthShaderInstanced; // Model matrix from TransformData (GL 4.3+)
+    std::vector<uint32_t> m_prepassOrder;           // Opaque batches, nearest first
+    bool m_positionsOnly = false;                   // Draws use the meshes' position-only streams
+
+    // A range of the geometry pool's index buffer, laid out as a glMultiDrawElementsIndirect command.
+    // Instanced batches are one command per mesh (and level), meshlet culling one per run
+    // of neighbouring visible meshlets.
+    struct IndirectCommand {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        uint32_t baseVertex;
+        uint32_t baseInstance;
+    };
+    std::vector<IndirectCommand> m_indirectCommands;
+    std::vector<GLsizei> m_runCounts;       // Meshlet runs of uniform-matrix shaders, for glMultiDrawElementsBaseVertex
+    std::vector<const void*> m_runOffsets;
+    std::vector<GLint> m_runBaseVertices;
+    unsigned int m_indirectCommandBuffer = 0; // GL 4.3+, holds m_indirectCommands for instanced shaders
+    unsigned int m_indirectDrawBuffer = 0;    // Where this frame's commands went: the StreamRing or the buffer above
+    size_t m_indirectOffset = 0;
+
+    // Sorted batches whose meshes share a layout of the GeometryPool also share a VAO, so
+    // instanced ones with the same material go out as a single multi-draw. Appends the
+    // batch, or folds it into the last one when that one ends with the commands it starts with.
+    void addIndirectBatch(const DrawBatch& batch);
+
+    // Appends the runs of the mesh's visible meshlets, returns how many were added
+    uint32_t cullMeshlets(const Mesh& mesh, const glm::mat4& modelMatrix, uint32_t baseInstance);
+
+    // Draws a batch from its commands: every instanced mesh and meshlet run in one call,
+    // or the meshlet runs of a single packet with its model uniform
+    void drawIndirect(const DrawBatch& batch);
+
+    // Geometry pool fragmentation (see RangeAllocator::getFragmentation) that makes
+    // endScene() compact it before drawing
+    static constexpr float GeometryDefragmentThreshold = 0.5f;
+
+    std::unordered_map<unsigned int, SceneUniforms> m_sceneUniforms; // Keyed by program ID
+    RenderStats m_stats;
+
+    // Uploads the camera and lights into the FrameData uniform buffer
+    void uploadFrameData();
+
+    // Works out how far each of activeLights reaches, for clustered and deferred lighting
+    void gatherLights();
+
+    // Culls the submitted renderers and turns the visible ones into packets
+    void buildRenderQueue();
+
+    unsigned int m_frameDataUBO = 0;
+
+    // Assigns activeLights to the clusters of this view and uploads the lists
+    void buildLightClusters();
+
+    // buildLightClusters()'s uploads when they don't fit in the StreamRing
+    void uploadClusterBuffers(const void* lightData, size_t lightBytes, size_t gridBytes, const void* indexData, size_t indexBytes);
+
+    LightClusters m_lightClusters;
+    std::vector<ClusterLight> m_clusterLights;
+    unsigned int m_clusterLightBuffer = 0; // GL 4.3+
+    unsigned int m_clusterGridBuffer = 0;
+    unsigned int m_clusterIndexBuffer = 0;
+
+    DeferredShading m_deferred;
+    bool m_deferredThisFrame = false;
+    Shader* m_shaderOverride = nullptr; // Program every draw uses instead of its material's, if set
+    bool m_deferredGeometryPass = false; // Draws use DeferredShading's program for their material
+
+    // GPU queries of one frame. Frames alternate between two sets and read the
+    // results of the set they are about to reuse, so the results are normally in.
+    struct FrameQueries {
+        unsigned int elapsed = 0;         // GL_TIME_ELAPSED around endScene
+        unsigned int prepassStart = 0;    // GL_TIMESTAMPs before the depth prepass,
+        unsigned int opaqueStart = 0;     // before the opaque draws that shade,
+        unsigned int opaqueEnd = 0;       // and after them
+        unsigned int opaqueFragments = 0; // GL_SAMPLES_PASSED of those draws
+        unsigned int viewportPixels = 0;
+        bool issued = false;
+        bool prepass = false;
+    };
+    FrameQueries m_frameQueries[2];
+
+    // Fills the GPU timings and fragment counts of m_stats from a set issued two frames ago
+    void readFrameQueries(FrameQueries& queries);
+
+    // What the previous draw left bound, so identical state isn't set twice
+    unsigned int m_frameIndex = 0;
+    Shader* m_lastShader = nullptr;
+    Material* m_lastMaterial = nullptr;
+    Mesh* m_lastMesh = nullptr;
+
     std::vector<PointLightData> activeLights;
-    std::vector<DrawCommand> renderQueue;
+    std::vector<RenderPacket> renderQueue;
+    std::vector<RenderPacket> m_sortScratch;
+    std::vector<glm::mat4> m_frameTransforms; // World matrices of this frame's packets
+    float m_farPlane = 100.0f;                // Depth range of the sort key
+    float m_nearPlane = 0.1f;
+    bool m_hasCamera = false;
+
+    // The packet being drawn. Its renderables are the cull candidates; their world
+    // bounding spheres are split into separate arrays so Frustum::testSpheres can
+    // load four at a time.
+    const FramePacket* m_packet = nullptr;
+    void addRenderable(FramePacket& packet, RendererComponent* renderer, Entity* entity);
+    std::vector<float> m_cullX, m_cullY, m_cullZ, m_cullRadius;
+    std::vector<uint8_t> m_cullVisible; // CullHidden, CullVisible or CullOccluded per candidate
+    enum : uint8_t { CullHidden = 0, CullVisible = 1, CullOccluded = 2 };
+
+    // buildRenderQueue() splits the candidates into chunks of QueueChunkSize, one job
+    // each. A job only writes to its chunk's lists; they are merged in chunk order
+    // afterwards, so the queue comes out the same whichever thread ran which chunk.
+    static constexpr size_t QueueChunkSize = 1024;
+    struct QueueChunk {
+        std::vector<RenderPacket> packets;    // transform is an index into transforms until the merge
+        std::vector<glm::mat4> transforms;
+        std::vector<ImpostorDraw> impostors;
+        std::vector<int> dirtySlots;          // Transform slots that became dirty (see TransformBuffer::store)
+        std::vector<uint32_t> needsImpostor;  // Candidates whose model's impostor isn't baked yet
+        unsigned int visible = 0;
+        unsigned int culled = 0;
+        unsigned int occluded = 0;
+        unsigned int lodSwitches = 0;
+    };
+    std::vector<QueueChunk> m_queueChunks;
+
+    // Queues the packets (or impostor quad) of a visible candidate into the chunk. Safe to call
+    // from any thread. Returns false without queueing anything if it needs an impostor that
+    // hasn't been baked, which takes the GL thread (see getImpostor()).
+    bool queueCandidate(size_t candidate, QueueChunk& chunk);
+
+    // Appends a chunk's lists to the frame's
+    void mergeQueueChunk(QueueChunk& chunk);
+
+    // Rasterizes the visible occluders and marks the candidates they hide as CullOccluded
+    void cullOccluded();
+    OcclusionCuller m_occlusion;
+    Frustum m_frustum;
+    bool m_cullThisFrame = false;
+    bool m_gpuThisFrame = false; // GpuCuller handles the renderers this frame
+    bool m_gpuLastFrame = false; // Its tables (and Hi-Z) were kept up to date last frame
+
+    // Draws every GpuCuller group with the commands its cull pass wrote
+    void drawGpuGroups();
 
     glm::mat4 m_viewMatrix;
     glm::mat4 m_projectionMatrix;
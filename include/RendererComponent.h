@@ -4,35 +4,132 @@
 #include "Component.h"
 #include "Model.h"
 #include "ResourceManager.h"
+#include "Reflection.h"
+#include "TransformBuffer.h"
+#include "DynamicAABBTree.h"
+#include "Entity.h"
+#include "GpuCuller.h"
+#include <algorithm>
 #include <memory>
 
 class RendererComponent : public Component {
 public:
     std::shared_ptr<Model> model;
 
+    // Name the model was loaded under (e.g., "david" or "sci_fi_crate"), empty for procedural models
+    std::string modelName;
+
+    RendererComponent() {}
+
+    // Slot of this object's model matrix in the TransformBuffer, handed out the first time it is extracted
+    int transformSlot = -1;
+
+    // Past this distance from the camera the model is drawn as a single quad from its
+    // impostor atlas (see Impostor). 0 means never.
+    float impostorDistance = 0.0f;
+
+    // Big, solid models (walls, buildings, terrain) that hide what is behind them.
+    // The renderer rasterizes them on the CPU and skips objects they cover (see OcclusionCuller).
+    bool occluder = false;
+
+    // This renderer's entries in the GPU culling tables (see GpuCuller): one instance per
+    // mesh, or the fallback list if its model can't be drawn there
+    std::vector<int> gpuInstances;
+    const Model* gpuModel = nullptr;
+    bool gpuFallback = false;
+
     RendererComponent(std::shared_ptr<Model> mod) 
         : model(mod) {}
 
-    // The factory function required by the ComponentRegistry
-    static std::shared_ptr<Component> deserialize(std::istringstream& iss, GLFWwindow* window) {
-        std::string modelName;
-        
-        // Read the model name from the text stream (e.g., "david" or "sci_fi_crate")
-        if (iss >> modelName) {
-            // Ask the ResourceManager for the pre-loaded model
-            auto loadedModel = ResourceManager::getModel(modelName);
-            
-            if (!loadedModel) {
-                std::cout << "Warning: RendererComponent in scene file requested unknown model: '" << modelName << "'" << std::endl;
+    ~RendererComponent() {
+        if (transformSlot >= 0) TransformBuffer::release(transformSlot);
+        if (spatialProxy != DynamicAABBTree::Null) spatialIndex.destroyProxy(spatialProxy);
+        if (!gpuInstances.empty() || gpuFallback) GpuCuller::remove(this);
+        if (spatialDirty) {
+            dirtyRenderers.erase(std::remove(dirtyRenderers.begin(), dirtyRenderers.end(), this), dirtyRenderers.end());
+        }
+    }
+
+    // Every renderer in the scene, by world box. The Renderer queries it with the
+    // camera frustum instead of walking the whole scene graph each frame.
+    static DynamicAABBTree spatialIndex;
+
+    // Renderers that were added or moved since the last updateSpatialIndex()
+    static std::vector<RendererComponent*> dirtyRenderers;
+
+    // This renderer's leaf in spatialIndex, or DynamicAABBTree::Null before its first update
+    int spatialProxy = DynamicAABBTree::Null;
+    bool spatialDirty = false;
+
+    void awake() override {
+        markSpatialDirty();
+    }
+
+    void onTransformChanged() override {
+        markSpatialDirty();
+    }
+
+    // Refits the leaves of every renderer that moved. Called once per frame before querying.
+    static void updateSpatialIndex() {
+        for (RendererComponent* renderer : dirtyRenderers) {
+            renderer->spatialDirty = false;
+
+            AABB worldBounds;
+            if (renderer->owner && renderer->getLocalBounds(worldBounds)) {
+                worldBounds = worldBounds.transformed(renderer->owner->worldTransform);
+            } else {
+                worldBounds = AABB();
+            }
+
+            // Nothing to show: drop out of the index until a model shows up
+            if (worldBounds.isEmpty()) {
+                if (renderer->spatialProxy != DynamicAABBTree::Null) {
+                    spatialIndex.destroyProxy(renderer->spatialProxy);
+                    renderer->spatialProxy = DynamicAABBTree::Null;
+                }
+                continue;
+            }
+
+            if (renderer->spatialProxy == DynamicAABBTree::Null) {
+                renderer->spatialProxy = spatialIndex.createProxy(worldBounds, renderer);
+            } else {
+                spatialIndex.moveProxy(renderer->spatialProxy, worldBounds);
             }
-            
-            // Return the newly constructed component
-            return std::make_shared<RendererComponent>(loadedModel);
         }
+        dirtyRenderers.clear();
+    }
 
-        std::cout << "Error: RendererComponent in scene file is missing a model name." << std::endl;
-        return nullptr;
+    bool getLocalBounds(AABB& bounds) const override {
+        if (!model) return false;
+        bounds = model->getBounds();
+        return !bounds.isEmpty();
     }
+
+    void markSpatialDirty() {
+        if (spatialDirty) return;
+        spatialDirty = true;
+        dirtyRenderers.push_back(this);
+    }
+
+    bool onDeserialized(uint32_t loadedFields, GLFWwindow* window) override {
+        if (!(loadedFields & Reflection::fieldBit(0))) {
+            std::cout << "Error: RendererComponent in scene file is missing a model name." << std::endl;
+            return false;
+        }
+
+        // Ask the ResourceManager for the pre-loaded model
+        model = ResourceManager::getModel(modelName);
+        if (!model) {
+            std::cout << "Warning: RendererComponent in scene file requested unknown model: '" << modelName << "'" << std::endl;
+        }
+        return true;
+    }
+
+    // Scene file: modelName [impostorDistance [occluder]]
+    REFLECT_COMPONENT(RendererComponent,
+        REFLECT_FIELD(RendererComponent, modelName),
+        REFLECT_FIELD(RendererComponent, impostorDistance),
+        REFLECT_FIELD(RendererComponent, occluder))
 };
 
 #endif
\ No newline at end of file
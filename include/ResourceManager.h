@@ -10,17 +10,38 @@
 
 #include "Texture.h"
 #include "Shader.h"
+#include "ShaderCache.h"
+#include "ShaderVariants.h"
 #include "Mesh.h"
 #include "Model.h"
 
 class ResourceManager {
 public:
 
+    // A name that is already loaded gets that program back, so materials naming the same
+    // files share one program instead of each compiling their own
     static std::shared_ptr<Shader> loadShader(const char* vShaderFile, const char* fShaderFile, std::string name) {
+        auto found = Shaders.find(name);
+        if (found != Shaders.end() && found->second) {
+            ShaderCache::stats.duplicates++;
+            return found->second;
+        }
         Shaders[name] = std::make_shared<Shader>(vShaderFile, fShaderFile);
         return Shaders[name];
     }
     
+    // Same for shader files built per material (see ShaderVariants): one set per pair of files,
+    // whose variants are compiled as materials ask for them
+    static std::shared_ptr<ShaderVariants> loadShaderVariants(const char* vShaderFile, const char* fShaderFile, std::string name) {
+        auto found = ShaderVariantSets.find(name);
+        if (found != ShaderVariantSets.end() && found->second) {
+            ShaderCache::stats.duplicates++;
+            return found->second;
+        }
+        ShaderVariantSets[name] = std::make_shared<ShaderVariants>(vShaderFile, fShaderFile);
+        return ShaderVariantSets[name];
+    }
+
     static std::shared_ptr<Shader> getShader(std::string name) {
         return Shaders[name];
     }
@@ -34,8 +55,9 @@ public:
         return Textures[name];
     }
     
-    static std::vector<std::shared_ptr<Mesh>> loadRawMeshes(const std::string& path) {
-        Model rawModel(path);
+    static std::vector<std::shared_ptr<Mesh>> loadRawMeshes(const std::string& path,
+                                                            const std::vector<LodSetting>& lods = Model::defaultLodSettings()) {
+        Model rawModel(path, lods);
         return rawModel.meshes;
     }
     
@@ -44,7 +66,7 @@ public:
     }
     
     static std::shared_ptr<Material> createMaterial(const char* vShaderFile, const char* fShaderFile) {
-        // Simple non-cached material creation for now (or cache by shader path?)
+        // A new material every time; the shader is shared through loadShader
         std::string name = std::string(vShaderFile) + std::string(fShaderFile);
         auto shader = loadShader(vShaderFile, fShaderFile, name);
         return std::make_shared<Material>(shader);
@@ -53,6 +75,7 @@ public:
     // Clear all resources (optional, as shared_ptr handles cleanup)
     static void clear() {
         Shaders.clear();
+        ShaderVariantSets.clear();
         Textures.clear();
         Models.clear();
     }
@@ -64,7 +87,7 @@ public:
             return nullptr;
         }
         std::string line;
-        std::shared_ptr<Shader> shader = nullptr;
+        std::shared_ptr<ShaderVariants> variants = nullptr;
         std::shared_ptr<Texture> diffuse = nullptr;
         std::shared_ptr<Texture> specular = nullptr;
         std::shared_ptr<Texture> normal = nullptr;
@@ -81,7 +104,7 @@ public:
             if (tag == "SHADER") {
                 std::string vsPath, fsPath;
                 iss >> vsPath >> fsPath;
-                shader = loadShader(vsPath.c_str(), fsPath.c_str(), vsPath); // Assuming path as name for simplicity
+                variants = loadShaderVariants(vsPath.c_str(), fsPath.c_str(), vsPath + fsPath);
             } 
             else if (tag == "DIFFUSE") {
                 std::string texPath;
@@ -106,13 +129,15 @@ public:
             }
         }
     
-        // Assemble and return the material
-        auto material = std::make_shared<Material>(shader);
+        // Assemble and return the material. Its program is the variant for the maps it got.
+        auto material = std::make_shared<Material>(nullptr);
+        material->variants = variants;
         material->diffuseMap = diffuse; // Note: Assumes your Material class takes raw pointers or adapt to shared_ptr
         material->specularMap = specular;
         material->normalMap = normal;
         material->shininess = shininess;
         material->textureScale = textureScale;
+        material->selectVariant();
     
         return material;
     }
@@ -127,6 +152,7 @@ public:
 
         std::string line;
         std::shared_ptr<Model> currentModel = nullptr;
+        bool customLods = false;
 
         while (std::getline(file, line)) {
             if (line.empty() || line[0] == '#') continue;
@@ -141,14 +167,30 @@ public:
                 
                 // Create a new empty model and register it in the central map
                 currentModel = std::make_shared<Model>();
+                currentModel->lodSettings = Model::defaultLodSettings();
                 Models[modelName] = currentModel;
+                customLods = false;
+            }
+            else if (tag == "LOD" && currentModel != nullptr) {
+                // LOD <triangleRatio> <screenSize> adds a level, LOD OFF turns them off.
+                // The first LOD line of a model replaces the default levels. Put them before MESH.
+                if (!customLods) {
+                    currentModel->lodSettings.clear();
+                    customLods = true;
+                }
+                LodSetting lod;
+                if (iss >> lod.triangleRatio >> lod.screenSize) {
+                    currentModel->lodSettings.push_back(lod);
+                } else if (line.find("OFF") == std::string::npos) {
+                    std::cout << "Warning: bad LOD line in " << filepath << ": '" << line << "'" << std::endl;
+                }
             }
             else if (tag == "MESH" && currentModel != nullptr) {
                 std::string objPath;
                 iss >> objPath;
                 
                 // Assimp extracts the raw geometry (could be 1 mesh, could be 5)
-                std::vector<std::shared_ptr<Mesh>> rawMeshes = loadRawMeshes(objPath); 
+                std::vector<std::shared_ptr<Mesh>> rawMeshes = loadRawMeshes(objPath, currentModel->lodSettings); 
                 
                 for (auto& mesh : rawMeshes) {
                     currentModel->meshes.push_back(mesh);
@@ -177,6 +219,7 @@ public:
 
     private:
     static std::map<std::string, std::shared_ptr<Shader>> Shaders;
+    static std::map<std::string, std::shared_ptr<ShaderVariants>> ShaderVariantSets;
     static std::map<std::string, std::shared_ptr<Texture>> Textures;
     static std::map<std::string, std::shared_ptr<Model>> Models;
 
@@ -17,6 +17,9 @@
 #include <map>
 #include <string>
 #include <iostream>
+#include <vector>
+#include <cstring>
+#include <iterator>
 
 class SceneLoader {
 public:
@@ -89,6 +92,199 @@ public:
             }
         }
     }
+
+    // --- Binary scenes (.ForceSceneBin) ---
+    // Layout:
+    //   "FSCN" uint32 version
+    //   uint32 typeCount, then typeCount strings (component type table)
+    //   uint32 entityCount, then per entity in depth-first order:
+    //     string name, int32 parentIndex (-1 = root), vec3 position, vec3 rotation, vec3 scale
+    //     uint32 componentCount, then per component: uint16 typeIndex, uint32 blobSize, blob
+    // Strings are [uint32 length][chars]. Component blobs come from the reflection
+    // tables, so loading them is a memcpy per stored field with no text parsing.
+    // Components without a reflection table (e.g. PipeComponent) are not saved.
+    static bool saveBinaryScene(const std::string& filepath, std::shared_ptr<Entity> rootEntity) {
+        std::vector<uint8_t> out;
+        std::vector<std::string> typeNames;
+        std::map<std::string, uint16_t> typeIndices;
+        std::vector<uint8_t> entityData;
+        uint32_t entityCount = 0;
+
+        // Flatten the hierarchy depth-first so parents always come before their children
+        std::vector<std::pair<Entity*, int32_t>> stack;
+        for (auto it = rootEntity->children.rbegin(); it != rootEntity->children.rend(); ++it) {
+            stack.push_back({it->get(), -1});
+        }
+        while (!stack.empty()) {
+            Entity* entity = stack.back().first;
+            int32_t parentIndex = stack.back().second;
+            stack.pop_back();
+            int32_t myIndex = static_cast<int32_t>(entityCount++);
+
+            writeString(entityData, entity->name);
+            writeRaw(entityData, parentIndex);
+            writeRaw(entityData, entity->position);
+            writeRaw(entityData, entity->rotation);
+            writeRaw(entityData, entity->scale);
+
+            std::vector<uint8_t> componentData;
+            uint32_t componentCount = 0;
+            for (auto& component : entity->components) {
+                const Reflection::TypeInfo* info = component->getTypeInfo();
+                if (!info) continue;
+
+                auto found = typeIndices.find(info->name);
+                if (found == typeIndices.end()) {
+                    found = typeIndices.insert({info->name, static_cast<uint16_t>(typeNames.size())}).first;
+                    typeNames.push_back(info->name);
+                }
+
+                std::vector<uint8_t> blob;
+                ComponentRegistry::writeBinary(*component, blob);
+                writeRaw(componentData, found->second);
+                writeRaw(componentData, static_cast<uint32_t>(blob.size()));
+                componentData.insert(componentData.end(), blob.begin(), blob.end());
+                componentCount++;
+            }
+            writeRaw(entityData, componentCount);
+            entityData.insert(entityData.end(), componentData.begin(), componentData.end());
+
+            for (auto it = entity->children.rbegin(); it != entity->children.rend(); ++it) {
+                stack.push_back({it->get(), myIndex});
+            }
+        }
+
+        out.insert(out.end(), BinaryMagic, BinaryMagic + 4);
+        writeRaw(out, BinaryVersion);
+        writeRaw(out, static_cast<uint32_t>(typeNames.size()));
+        for (auto& typeName : typeNames) writeString(out, typeName);
+        writeRaw(out, entityCount);
+        out.insert(out.end(), entityData.begin(), entityData.end());
+
+        std::ofstream file(filepath, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Failed to write binary scene file: " << filepath << std::endl;
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(out.data()), out.size());
+        return true;
+    }
+
+    static bool loadBinaryScene(const std::string& filepath, std::shared_ptr<Entity> rootEntity, GLFWwindow* window) {
+        std::ifstream file(filepath, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open binary scene file: " << filepath << std::endl;
+            return false;
+        }
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        const uint8_t* cursor = data.data();
+        const uint8_t* end = data.data() + data.size();
+
+        uint32_t version = 0;
+        if (data.size() < 8 || std::memcmp(cursor, BinaryMagic, 4) != 0) {
+            std::cerr << "Not a binary scene file: " << filepath << std::endl;
+            return false;
+        }
+        cursor += 4;
+        readRaw(cursor, end, version);
+        if (version != BinaryVersion) {
+            std::cerr << "Unsupported binary scene version " << version << " in " << filepath << std::endl;
+            return false;
+        }
+
+        // Resolve the type table once, so components only carry a small index
+        uint32_t typeCount = 0;
+        if (!readRaw(cursor, end, typeCount)) return false;
+        std::vector<const ReflectedComponentType*> types(typeCount, nullptr);
+        for (uint32_t i = 0; i < typeCount; ++i) {
+            std::string typeName;
+            if (!readString(cursor, end, typeName)) return false;
+            types[i] = ComponentRegistry::findType(typeName);
+            if (!types[i]) {
+                std::cout << "Warning: Unknown component type in binary scene file: " << typeName << std::endl;
+            }
+        }
+
+        uint32_t entityCount = 0;
+        if (!readRaw(cursor, end, entityCount)) return false;
+        std::vector<std::shared_ptr<Entity>> entities;
+        entities.reserve(entityCount);
+
+        for (uint32_t i = 0; i < entityCount; ++i) {
+            auto entity = std::make_shared<Entity>();
+            int32_t parentIndex = -1;
+            uint32_t componentCount = 0;
+            if (!readString(cursor, end, entity->name) ||
+                !readRaw(cursor, end, parentIndex) ||
+                !readRaw(cursor, end, entity->position) ||
+                !readRaw(cursor, end, entity->rotation) ||
+                !readRaw(cursor, end, entity->scale) ||
+                !readRaw(cursor, end, componentCount)) {
+                std::cerr << "Truncated binary scene file: " << filepath << std::endl;
+                return false;
+            }
+
+            // Attach before adding components so awake() can see the hierarchy, as loadScene does
+            if (parentIndex >= 0 && parentIndex < static_cast<int32_t>(entities.size())) {
+                entities[parentIndex]->addChild(entity);
+            } else {
+                rootEntity->addChild(entity);
+            }
+            entities.push_back(entity);
+
+            for (uint32_t c = 0; c < componentCount; ++c) {
+                uint16_t typeIndex = 0;
+                uint32_t blobSize = 0;
+                if (!readRaw(cursor, end, typeIndex) || !readRaw(cursor, end, blobSize) ||
+                    end - cursor < static_cast<ptrdiff_t>(blobSize)) {
+                    std::cerr << "Truncated binary scene file: " << filepath << std::endl;
+                    return false;
+                }
+                const uint8_t* blobEnd = cursor + blobSize;
+                const ReflectedComponentType* type = typeIndex < types.size() ? types[typeIndex] : nullptr;
+                if (type) {
+                    const uint8_t* blobCursor = cursor;
+                    auto newComponent = ComponentRegistry::createFromBinary(*type, blobCursor, blobEnd, window);
+                    if (newComponent) {
+                        entity->addComponent(newComponent);
+                    }
+                }
+                cursor = blobEnd; // Unknown or rejected components are skipped whole
+            }
+        }
+        return true;
+    }
+
+private:
+    static constexpr const char* BinaryMagic = "FSCN";
+    static constexpr uint32_t BinaryVersion = 1;
+
+    template <typename T>
+    static void writeRaw(std::vector<uint8_t>& out, const T& value) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    static void writeString(std::vector<uint8_t>& out, const std::string& s) {
+        writeRaw(out, static_cast<uint32_t>(s.size()));
+        out.insert(out.end(), s.begin(), s.end());
+    }
+
+    template <typename T>
+    static bool readRaw(const uint8_t*& cursor, const uint8_t* end, T& value) {
+        if (end - cursor < static_cast<ptrdiff_t>(sizeof(T))) return false;
+        std::memcpy(&value, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return true;
+    }
+
+    static bool readString(const uint8_t*& cursor, const uint8_t* end, std::string& s) {
+        uint32_t length = 0;
+        if (!readRaw(cursor, end, length) || end - cursor < static_cast<ptrdiff_t>(length)) return false;
+        s.assign(reinterpret_cast<const char*>(cursor), length);
+        cursor += length;
+        return true;
+    }
 };
 
 #endif
\ No newline at end of file
@@ -6,21 +6,70 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <memory>
+#include <vector>
+#include <initializer_list>
 #include <glm/glm/glm.hpp>
 #include <glm/glm/gtc/type_ptr.hpp>
+#include "RenderId.h"
+
+// A uniform resolved once through Shader::getUniform. -1 means the program
+// doesn't use that uniform, and setting it is a no-op.
+using UniformHandle = int;
+
+// Uniform traffic counters, summed over every shader since the last resetStats()
+struct ShaderStats {
+    unsigned int lookups = 0;        // Name -> handle lookups
+    unsigned int uploads = 0;        // glUniform* calls actually issued
+    unsigned int skippedUploads = 0; // Sets dropped because the value was already on the GPU
+};
 
 class Shader {
 public:
     // The program ID
     unsigned int ID;
 
+    // Small ID used by draw packets and sort keys (see RenderIdTable)
+    uint32_t renderId;
+
     // Constructor reads the files and builds the shader
     Shader(const char* vertexPath, const char* fragmentPath);
-    
+
+    // Builds a shader from GLSL source held in memory (for the engine's own shaders)
+    static std::shared_ptr<Shader> fromSource(const std::string& vertexCode, const std::string& fragmentCode);
+
+    // Builds a compute program (GL 4.3+), run with glDispatchCompute after use()
+    static std::shared_ptr<Shader> fromComputeSource(const std::string& computeCode);
+    ~Shader();
+
+    // The render ID belongs to this object, so it can't be copied
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
     // Use/activate the shader program
     void use();
-    
-    // Utility functions to pass data to the GPU later
+
+    // Looks a uniform up in the table reflected at link time
+    UniformHandle getUniform(const std::string &name) const;
+
+    // True if the program declares the named uniform block (see ShaderBindings.h)
+    bool hasUniformBlock(const std::string &name) const;
+
+    // True if the program declares the named shader storage block (always false below GL 4.3)
+    bool hasStorageBlock(const std::string &name) const;
+
+    // Typed setters for pre-resolved handles. The program must be in use.
+    // Each uniform keeps a CPU copy of its last value, so setting the same value again costs nothing.
+    void set(UniformHandle handle, int value) const;
+    void set(UniformHandle handle, float value) const;
+    void set(UniformHandle handle, const glm::vec2 &value) const;
+    void set(UniformHandle handle, const glm::ivec2 &value) const;
+    void set(UniformHandle handle, const glm::vec3 &value) const;
+    void set(UniformHandle handle, const glm::vec4 &value) const;
+    void set(UniformHandle handle, const glm::mat4 &value) const;
+
+    // Utility functions to pass data to the GPU by name (a lookup, then the typed setter)
     void setBool(const std::string &name, bool value) const;
     void setInt(const std::string &name, int value) const;
     void setFloat(const std::string &name, float value) const;
@@ -28,6 +77,52 @@ public:
     void setVec2(const std::string &name, float x, float y) const;
     void setFloat(const std::string &name, float x, float y, float z) const;
     void setMat4(const std::string &name, const glm::mat4 &mat) const;
+
+    static ShaderStats stats;
+    static void resetStats() { stats = ShaderStats(); }
+
+private:
+    struct UniformSlot {
+        GLint location;
+        bool hasValue = false; // False until the first upload, so it can't be skipped
+        float shadow[16];      // Large enough for a mat4; ints are stored bit-for-bit
+    };
+
+    std::unordered_map<std::string, UniformHandle> uniformTable;
+    mutable std::vector<UniformSlot> uniforms;
+    std::vector<std::string> uniformBlocks;
+    std::vector<std::string> storageBlocks;
+
+    Shader() {}
+
+    // One stage of a program, for link()
+    struct Stage {
+        unsigned int type;
+        const std::string* code;
+        const char* name;
+    };
+
+    // Compiles and links the two stages, then reflects the program
+    void build(const std::string& vertexCode, const std::string& fragmentCode);
+
+    // Compiles one stage, printing the log if it fails
+    static unsigned int compileStage(unsigned int type, const std::string& code, const char* stageName);
+
+    // Creates the program from the ShaderCache binary of these stages, or compiles and links
+    // them (storing the binary), then reflects the program and takes a render ID
+    void link(std::initializer_list<Stage> stages);
+
+    // Fills uniformTable with every active uniform of the linked program
+    void reflectUniforms();
+
+    // Records the program's uniform blocks and binds the known ones to their shared binding points
+    void bindUniformBlocks();
+
+    // Same for shader storage blocks
+    void bindStorageBlocks();
+
+    // Returns false if the value is already on the GPU, otherwise records it as the new value
+    bool updateShadow(UniformHandle handle, const void* data, size_t bytes) const;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,64 @@
+#ifndef SHADER_BINDINGS_H
+#define SHADER_BINDINGS_H
+
+// Binding points shared by the engine and every shader program.
+// Shader assigns these right after linking to any block it finds with a
+// matching name, so GLSL 3.30 shaders don't need layout(binding = N).
+// Storage blocks and uniform blocks have separate binding namespaces.
+namespace ShaderBindings {
+
+// Uniform blocks (GL_UNIFORM_BUFFER)
+constexpr unsigned int FrameData = 0;    // Camera and lights, written once per frame
+constexpr unsigned int MaterialData = 1; // Constants of every material, indexed by materialIndex
+constexpr unsigned int MaterialLayers = 2; // Texture array layers of every material's maps, same index
+
+// Shader storage blocks (GL_SHADER_STORAGE_BUFFER, GL 4.3+)
+constexpr unsigned int TransformData = 0; // Model matrix of every object, indexed by transform slot
+constexpr unsigned int CullInstances = 1;    // GpuCuller: bounds and draw group of every instance
+constexpr unsigned int CullGroups = 2;       // GpuCuller: first command and LOD count of every draw group
+constexpr unsigned int DrawCommands = 3;     // GpuCuller: indirect draw commands the cull pass fills in
+constexpr unsigned int VisibleInstances = 4; // GpuCuller: transform slots of the instances that passed
+constexpr unsigned int ClusterLights = 5;       // Every point light with its range, for clustered lighting
+constexpr unsigned int ClusterGrid = 6;         // Grid size and (offset, count) of every light cluster
+constexpr unsigned int ClusterLightIndices = 7; // The clusters' light lists, back to back
+
+// Per-instance vertex attribute carrying the draw's TransformData slot
+constexpr unsigned int TransformIndexAttribute = 4;
+
+// For shaders that declare MaterialLayers the attribute also carries the material:
+// the slot is in the low TransformIndexBits and the materialIndex above them
+constexpr unsigned int TransformIndexBits = 24;
+
+// Texture units of the material maps: 2D textures, then the texture array pages
+constexpr unsigned int DiffuseUnit = 0;
+constexpr unsigned int SpecularUnit = 1;
+constexpr unsigned int NormalUnit = 2;
+constexpr unsigned int DiffuseArrayUnit = 3;
+constexpr unsigned int SpecularArrayUnit = 4;
+constexpr unsigned int NormalArrayUnit = 5;
+
+struct BlockBinding {
+    const char* name;
+    unsigned int binding;
+};
+
+constexpr BlockBinding UniformBlocks[] = {
+    { "FrameData", FrameData },
+    { "MaterialData", MaterialData },
+    { "MaterialLayers", MaterialLayers },
+};
+
+constexpr BlockBinding StorageBlocks[] = {
+    { "TransformData", TransformData },
+    { "CullInstances", CullInstances },
+    { "CullGroups", CullGroups },
+    { "DrawCommands", DrawCommands },
+    { "VisibleInstances", VisibleInstances },
+    { "ClusterLights", ClusterLights },
+    { "ClusterGrid", ClusterGrid },
+    { "ClusterLightIndices", ClusterLightIndices },
+};
+
+} // namespace ShaderBindings
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <cstdint>
+#include <string>
+
+// Program build counters since startup
+struct ShaderCacheStats {
+    unsigned int hits = 0;        // Programs loaded from a stored binary
+    unsigned int compiles = 0;    // Programs compiled and linked from source
+    unsigned int stored = 0;      // Binaries written for the next run
+    unsigned int rejected = 0;    // Stored binaries the driver refused (deleted, then compiled)
+    unsigned int duplicates = 0;  // Loads that got a program this run had already built (see ResourceManager::loadShader)
+    float loadMs = 0.0f;          // Time spent in glProgramBinary, file reads included
+    float compileMs = 0.0f;       // Time spent compiling and linking
+};
+
+// Keeps linked programs on disk between runs (glGetProgramBinary), so a
+// program whose sources were already built on this driver is loaded with
+// glProgramBinary instead of compiled and linked again. A binary is stored
+// under the key of the program: a hash of every stage's source (the #defines
+// the engine prepends included) and the driver string, so editing a shader or
+// its defines simply misses.
+//
+// Invalidation: the driver string is also written to the directory, and a
+// different one at init() empties it (binaries only load on the driver that
+// made them). A binary the driver still refuses, or a damaged file, is
+// deleted and the program compiled again. Files of sources that changed stay
+// until clear().
+// Needs GL 4.1 and a driver that offers at least one binary format; without
+// them load() always misses and store() does nothing.
+class ShaderCache {
+public:
+    static constexpr const char* DefaultDirectory = "shader_cache";
+
+    // Reads the driver string and prepares the directory. False if binaries can't be used.
+    static bool init(const std::string& directory = DefaultDirectory);
+    static bool isAvailable() { return available; }
+
+    // Deletes every stored binary
+    static void clear();
+
+    // Key of a program built from these sources (the stages concatenated, separated by '\0')
+    static uint64_t makeKey(const std::string& sources);
+
+    // Call before linking, so the driver keeps the binary around for store()
+    static void prepareLink(unsigned int program);
+
+    // Loads the binary stored for key into the program. False if there is none or it didn't link.
+    static bool load(unsigned int program, uint64_t key);
+
+    // Writes the binary of a linked program under key
+    static void store(unsigned int program, uint64_t key);
+
+    static ShaderCacheStats stats;
+
+private:
+    // Written in front of every binary
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t format;  // The binaryFormat glGetProgramBinary gave
+        uint32_t length;
+        uint64_t key;     // Guards against a file renamed or copied over
+    };
+
+    static constexpr uint32_t Magic = 0x42534643; // "CFSB"
+    static constexpr uint32_t Version = 1;
+
+    static bool available;
+    static std::string directory;
+    static std::string driver;
+
+    static std::string pathOf(uint64_t key);
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include <string>
+#include <vector>
+
+// What GLSL's own preprocessor can't do, done on the source before it's
+// compiled: #include "file" and #defines chosen at runtime (see ShaderVariants).
+//
+// An include is resolved against the directory of the file that names it and
+// expanded in place, recursively. A file is only expanded the first time it's
+// included, so headers need no guards and cycles end by themselves, one back
+// to the file loaded too. Every expanded file gets a #line with its own source
+// string number (0 is the file compiled, then 1, 2, ... in the order they were
+// first included), so a compile error says the file and line it really is on.
+class ShaderPreprocessor {
+public:
+    // Reads the file and expands its includes into out. False (and an error printed)
+    // if it, or a file it includes, can't be read.
+    static bool loadFile(const std::string& path, std::string& out, std::vector<std::string>* files = nullptr);
+
+    // Same for source in memory, whose includes are relative to directory. files receives
+    // every file included, by source string number minus one.
+    static bool expand(const std::string& source, const std::string& directory, std::string& out,
+                       std::vector<std::string>* files = nullptr);
+
+    // Inserts "#define name" lines right after the #version line (at the top if there is
+    // none), followed by a #line so the line numbers of the source don't move
+    static std::string addDefines(const std::string& source, const std::vector<std::string>& defines);
+
+    // True if the identifier appears in the source as a whole word (a macro a variant could set)
+    static bool mentions(const std::string& source, const std::string& identifier);
+
+private:
+    struct Context {
+        std::string root;                // The file loaded (source string 0), empty for source in memory
+        std::vector<std::string> files;  // Included so far
+    };
+
+    static bool expand(const std::string& source, const std::string& directory, Context& context, std::string& out,
+                       std::vector<std::string>* files);
+
+    static bool expandInto(const std::string& source, const std::string& directory, int sourceNumber,
+                           Context& context, std::string& out);
+
+    // The file name of an #include line, or empty if the line isn't one
+    static std::string includeName(const std::string& line);
+
+    static std::string directoryOf(const std::string& path);
+};
+
+#endif
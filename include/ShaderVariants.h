@@ -0,0 +1,79 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "Shader.h"
+
+// Variant counters, summed over every ShaderVariants since startup
+struct ShaderVariantStats {
+    unsigned int sets = 0;        // Sources loaded as variant sets
+    unsigned int variants = 0;    // Programs built (compiled, or loaded by the ShaderCache)
+    float buildMs = 0.0f;         // Time spent building them, preprocessing included
+};
+
+// One pair of GLSL sources built as many programs, one per combination of the
+// features it tests with #ifdef. Instead of one shader that checks hasDiffuse,
+// hasSpecular and hasNormalMap for every fragment, each material draws with the
+// program compiled for exactly the maps it has, and the code for the others
+// isn't in it.
+//
+// A feature only splits the set if its macro appears in the sources, so a
+// shader that tests none of them is a single program as before. A program is
+// built the first time a combination is asked for, then kept, and it goes
+// through the ShaderCache like any other. The sources may #include files
+// (see ShaderPreprocessor).
+class ShaderVariants {
+public:
+    // The keys, one #define each
+    enum Feature : uint32_t {
+        DiffuseMap = 1 << 0,      // HAS_DIFFUSE_MAP
+        SpecularMap = 1 << 1,     // HAS_SPECULAR_MAP
+        NormalMap = 1 << 2,       // HAS_NORMAL_MAP
+        TransformData = 1 << 3,   // TRANSFORM_DATA: instanced, model matrices from the TransformData block (GL 4.3)
+        ClusteredLights = 1 << 4, // CLUSTERED_LIGHTS: lights from the ClusterLights blocks instead of the FrameData loop (GL 4.3)
+    };
+    static constexpr int FeatureCount = 5;
+    static const char* defineOf(int featureBit);
+
+    // Reads and preprocesses both files. isValid() is false if one couldn't be read.
+    ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath);
+
+    // For the engine's own shaders. Includes are resolved against the working directory.
+    static std::shared_ptr<ShaderVariants> fromSource(const std::string& vertexCode, const std::string& fragmentCode);
+
+    bool isValid() const { return valid; }
+
+    // Features the sources test
+    uint32_t getUsedFeatures() const { return usedFeatures; }
+
+    // The program for these features (the ones the sources don't test are ignored),
+    // built on the first request. Must be called on the thread that owns the context.
+    std::shared_ptr<Shader> get(uint32_t features);
+
+    size_t getVariantCount() const { return variants.size(); }
+
+    // Features that are the same for every draw this run, set by the Renderer from what it
+    // feeds shaders (TransformData when the TransformBuffer is on, ClusteredLights when it
+    // builds the light clusters). Materials add them to their own.
+    static void setContextFeatures(uint32_t features) { contextFeatures = features; }
+    static uint32_t getContextFeatures() { return contextFeatures; }
+
+    static ShaderVariantStats stats;
+
+private:
+    static uint32_t contextFeatures;
+
+    ShaderVariants() {}
+    void findUsedFeatures();
+
+    std::string vertexCode;
+    std::string fragmentCode;
+    uint32_t usedFeatures = 0;
+    bool valid = false;
+    std::unordered_map<uint32_t, std::shared_ptr<Shader>> variants;
+};
+
+#endif
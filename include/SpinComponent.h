@@ -3,6 +3,7 @@
 
 #include "Component.h"
 #include "Entity.h" // Required so we can access owner->localTransform
+#include "Reflection.h"
 #include <glm/glm/glm.hpp>
 #include <glm/glm/gtc/matrix_transform.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
@@ -21,6 +22,9 @@ public:
     glm::vec3 initialOffset;
     glm::mat4 initialRotationMat;
 
+    SpinComponent()
+        : spinAxis(0.0f, 1.0f, 0.0f), speed(0.0f), pivot(0.0f), hasPivot(false), currentAngle(0.0f), initialOffset(0.0f), initialRotationMat(1.0f) {}
+
     // Constructor takes the axis of rotation and the speed
     SpinComponent(glm::vec3 axis, float rotationSpeed) 
         : spinAxis(glm::normalize(axis)), speed(rotationSpeed), pivot(0.0f), hasPivot(false), currentAngle(0.0f), initialOffset(0.0f), initialRotationMat(1.0f) {}
@@ -71,22 +75,27 @@ public:
         }
     }
 
-    static std::shared_ptr<Component> deserialize(std::istringstream& iss, GLFWwindow* window) {
-        float x, y, z, speed;
-        
-        // Read the axis and speed
-        if (iss >> x >> y >> z >> speed) {
-            // Check if there is a pivot point (4th parameter)
-            if (iss >> std::ws && iss.peek() != EOF) {
-                float px, py, pz;
-                iss >> px >> py >> pz;
-                return std::make_shared<SpinComponent>(glm::vec3(x, y, z), speed, glm::vec3(px, py, pz));
-            } else {
-                return std::make_shared<SpinComponent>(glm::vec3(x, y, z), speed);
-            }
+    bool onDeserialized(uint32_t loadedFields, GLFWwindow* window) override {
+        // The axis and speed are required
+        const uint32_t required = Reflection::fieldBit(0) | Reflection::fieldBit(1);
+        if ((loadedFields & required) != required) return false;
+
+        spinAxis = glm::normalize(spinAxis);
+
+        // Giving a pivot point (the optional third value) turns this into an orbit
+        if (loadedFields & Reflection::fieldBit(2)) {
+            hasPivot = true;
         }
-        return nullptr;
+        return true;
     }
+
+    // Scene file: axisX axisY axisZ speed [pivotX pivotY pivotZ]
+    REFLECT_COMPONENT(SpinComponent,
+        REFLECT_FIELD(SpinComponent, spinAxis),
+        REFLECT_FIELD(SpinComponent, speed),
+        REFLECT_FIELD(SpinComponent, pivot),
+        REFLECT_FIELD_FLAGS(SpinComponent, hasPivot, Reflection::FieldNoText),
+        REFLECT_FIELD_FLAGS(SpinComponent, currentAngle, Reflection::FieldNoText))
 };
 
 #endif
\ No newline at end of file
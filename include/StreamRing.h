@@ -0,0 +1,83 @@
+#ifndef STREAM_RING_H
+#define STREAM_RING_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Ring counters since the last resetStats()
+struct StreamRingStats {
+    unsigned int allocations = 0;
+    unsigned int bytes = 0;       // Handed out this frame, alignment padding included
+    unsigned int overflows = 0;   // Allocations that didn't fit (the caller used its own buffer)
+    unsigned int fenceWaits = 0;  // Frames whose region the GPU was still reading
+    float stallMs = 0.0f;         // Time spent waiting for it
+};
+
+// One persistently mapped buffer for everything the renderer rewrites every
+// frame (the instance stream, FrameData, the light clusters, indirect commands).
+// It is split into RegionCount regions used in turn, one per frame: a frame
+// bump-allocates aligned chunks from its region and writes straight into the
+// mapping, so there is no glBufferData/glBufferSubData, no driver copy and no
+// implicit sync. Each region gets a fence when its frame is over, and
+// beginFrame() only waits on it if the GPU is more than RegionCount - 1 frames
+// behind (stats.stallMs says how long).
+//
+// A frame that needs more than a region gets Invalid back for the rest and the
+// caller falls back to its own buffer; the next beginFrame() grows the regions.
+// Growing replaces the buffer, so anything that keeps the name (VAOs) checks
+// getGrowCount() against the one it saw last (see TransformBuffer).
+// Needs GL 4.4 (glBufferStorage); without it init() returns false.
+class StreamRing {
+public:
+    static constexpr int RegionCount = 3;
+    static constexpr size_t Invalid = ~size_t(0);
+
+    static bool init();
+    static bool isAvailable() { return buffer != 0; }
+    static unsigned int getBuffer() { return buffer; }
+
+    // Fences the region the last frame wrote, grows the ring if that frame ran out,
+    // and moves on to the next region, waiting until the GPU is done with it
+    static void beginFrame();
+
+    // Offset into getBuffer() of `bytes` in this frame's region, aligned to `alignment`
+    // (a power of two), or Invalid if the region is full
+    static size_t allocate(size_t bytes, size_t alignment);
+
+    // allocate() and copy
+    static size_t write(const void* data, size_t bytes, size_t alignment);
+
+    // The mapping of an offset allocate() returned. Valid until the next beginFrame().
+    static void* map(size_t offset) { return mapping + offset; }
+
+    // Offset alignments glBindBufferRange needs
+    static size_t getUniformAlignment() { return uniformAlignment; }
+    static size_t getStorageAlignment() { return storageAlignment; }
+
+    static size_t getRegionBytes() { return regionBytes; }
+
+    // Bumped each time the buffer is replaced (its name may be reused)
+    static unsigned int getGrowCount() { return grows; }
+
+    static StreamRingStats stats;
+    static void resetStats() { stats = StreamRingStats(); }
+
+private:
+    static constexpr size_t InitialRegionBytes = 2 << 20;
+
+    static unsigned int buffer;
+    static uint8_t* mapping;
+    static size_t regionBytes;
+    static int region;             // Region of the current frame
+    static size_t head;            // Next free byte of it, relative to its start
+    static size_t needed;          // Bytes the current frame asked for, overflows included
+    static bool frameStarted;
+    static void* fences[RegionCount];
+    static size_t uniformAlignment, storageAlignment;
+    static unsigned int grows;
+
+    // (Re)creates the buffer with the current region size and maps it
+    static bool create();
+};
+
+#endif
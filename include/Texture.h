@@ -3,16 +3,24 @@
 
 #include <glad/glad.h>
 #include "../include/stb_image.h"
+#include "GLState.h"
+#include "TextureArrays.h"
 #include <iostream>
 #include <string>
 
 class Texture {
 public:
     unsigned int ID;
+    int width = 0;
+    int height = 0;
+    GLenum internalFormat = 0;
+
+    // Its copy in a texture array page, if its size and format have one (see TextureArrays)
+    TextureArrays::Ref arrayLayer;
 
     Texture(const char* imagePath) {
         glGenTextures(1, &ID);
-        glBindTexture(GL_TEXTURE_2D, ID);
+        GLState::bindTexture(0, GL_TEXTURE_2D, ID);
 
         // Set texture wrapping to GL_REPEAT (default wrapping method)
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -27,22 +35,28 @@ public:
         stbi_set_flip_vertically_on_load(true);
 
         // Load image, create texture and generate mipmaps
-        int width, height, nrChannels;
+        int nrChannels;
         unsigned char *data = stbi_load(imagePath, &width, &height, &nrChannels, 0);
         
         if (data) {
             // Check if the image has an alpha channel (PNG) or just RGB (JPG)
+            // Sized internal formats, so the texture can be copied into an array page of the same format
             GLenum format;
-            if (nrChannels == 1)
+            if (nrChannels == 1) {
                 format = GL_RED;
-            else if (nrChannels == 3)
+                internalFormat = GL_R8;
+            } else if (nrChannels == 3) {
                 format = GL_RGB;
-            else if (nrChannels == 4)
+                internalFormat = GL_RGB8;
+            } else if (nrChannels == 4) {
                 format = GL_RGBA;
-            else
+                internalFormat = GL_RGBA8;
+            } else {
                 format = GL_RGB; // Default fallback (might still be risky but better than nothing)
+                internalFormat = GL_RGB8;
+            }
 
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 
             if (nrChannels == 1) {
                 // If the texture is grayscale (1 channel), we want it to appear as white/gray
@@ -51,6 +65,9 @@ public:
                 glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzleMask);
             }
             glGenerateMipmap(GL_TEXTURE_2D);
+
+            // The 2D texture stays, for shaders that sample it and for sizes without a page
+            arrayLayer = TextureArrays::add(ID, width, height, internalFormat);
         } else {
             std::cout << "Failed to load texture at path: " << imagePath << std::endl;
         }
@@ -59,9 +76,17 @@ public:
         stbi_image_free(data);
     }
 
+    ~Texture() {
+        TextureArrays::release(arrayLayer);
+    }
+
+    // The layer belongs to this object, so it can't be copied
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+
+    // Skipped entirely if the texture is already bound to that unit
     void bind(unsigned int slot = 0) const {
-        glActiveTexture(GL_TEXTURE0 + slot);
-        glBindTexture(GL_TEXTURE_2D, ID);
+        GLState::bindTexture(slot, GL_TEXTURE_2D, ID);
     }
 };
 
@@ -0,0 +1,78 @@
+#ifndef TEXTURE_ARRAYS_H
+#define TEXTURE_ARRAYS_H
+
+#include <cstdint>
+#include <vector>
+
+// Array counters, for the stats line
+struct TextureArrayStats {
+    unsigned int pages = 0;
+    unsigned int layers = 0;      // Over every page
+    unsigned int usedLayers = 0;
+    unsigned int bytes = 0;       // Every page's storage, mipmaps included
+    unsigned int leftOut = 0;     // Textures that kept only their own 2D texture (odd sizes or formats)
+};
+
+// Copies of the material textures, grouped into GL_TEXTURE_2D_ARRAY pages of
+// one size and format each. A texture gets a layer of a page (a Ref) when it
+// is loaded; materials whose maps all have one hand the layers to the shader
+// through the MaterialLayers block, so materials that only differ in their
+// textures bind the same state, and the renderer can draw them in one
+// instanced or multi-draw batch (see Renderer::endScene).
+//
+// Only power-of-two sides from MinSize to MaxSize in RGB8, RGBA8 or R8
+// go in; anything else stays a plain 2D texture, which every
+// shader can still sample. A full page is never grown: the next texture of
+// its kind starts a new page. Needs GL 4.3 (glCopyImageSubData); without it
+// add() always returns an invalid Ref.
+class TextureArrays {
+public:
+    static constexpr int Invalid = -1;
+    static constexpr int LayersPerPage = 32;
+    static constexpr int MinSize = 16;
+    static constexpr int MaxSize = 2048;
+
+    // Where a texture is: a page and a layer of it
+    struct Ref {
+        int page = Invalid;
+        int layer = Invalid;
+        bool isValid() const { return page != Invalid; }
+    };
+
+    // Copies every mip level of a complete 2D texture into a free layer of a page of its
+    // size and format (swizzled like the texture for one-channel formats). An invalid Ref
+    // if it doesn't fit any page.
+    static Ref add(unsigned int texture, int width, int height, unsigned int internalFormat);
+
+    // Gives the layer back. Only bookkeeping, so it's safe without a context and during exit.
+    static void release(const Ref& ref);
+
+    // Binds a page to a texture unit (skipped if it already is)
+    static void bind(int page, unsigned int unit);
+
+    static TextureArrayStats getStats();
+
+private:
+    struct Page {
+        unsigned int texture = 0;
+        int width = 0;
+        int height = 0;
+        unsigned int internalFormat = 0;
+        int levels = 0;
+        int layers = 0;
+        std::vector<int> freeLayers;
+    };
+    // Never destroyed: textures kept in other statics (ResourceManager's) release their
+    // layers during exit, possibly after a normal static would be gone
+    static std::vector<Page>& pageList() {
+        static std::vector<Page>* pages = new std::vector<Page>();
+        return *pages;
+    }
+    static int maxLayers;         // GL_MAX_ARRAY_TEXTURE_LAYERS, 0 until the first add()
+    static unsigned int leftOut;
+
+    // A page of that kind with a free layer, created if there is none. Invalid on failure.
+    static int findPage(int width, int height, unsigned int internalFormat);
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef TRANSFORM_BUFFER_H
+#define TRANSFORM_BUFFER_H
+
+#include <glm/glm/glm.hpp>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Upload counters since the last resetStats()
+struct TransformStats {
+    unsigned int bytesUploaded = 0;
+    unsigned int uploadSpans = 0;   // glBufferSubData calls
+    unsigned int dirtySlots = 0;    // Matrices that actually changed
+    unsigned int instanceBytes = 0; // Instance stream bytes sent
+};
+
+// Every object's model matrix lives in one persistent shader storage buffer
+// (the TransformData block), one slot per object. set() compares against a
+// CPU copy and only marks changed slots dirty; upload() sends the dirty slots
+// as a few contiguous ranges. Objects that didn't move cost nothing per frame.
+//
+// Shaders find their slot through a per-instance vertex attribute
+// (ShaderBindings::TransformIndexAttribute) that reads the instance stream:
+// each frame the renderer writes the slots of every batch there, one after
+// another, and draws the batch with baseInstance = its first entry. A batch
+// of identical meshes is then a single instanced draw. With a StreamRing the
+// stream is written straight into it; otherwise (or when the ring is full)
+// into a buffer of its own that is orphaned each frame.
+// Needs GL 4.3; without it init() returns false and the renderer keeps
+// using the model uniform.
+class TransformBuffer {
+public:
+    static bool init();
+    static bool isAvailable() { return ssbo != 0; }
+
+    // Persistent slots, owned by a RendererComponent for its lifetime. These two only
+    // hand out numbers and may be called from any thread (the simulation creates and
+    // destroys renderers while the render thread draws); the CPU copies of the new
+    // slots are made by prepareSlots() on the thread that draws.
+    static int allocate();
+    static void release(int slot);
+
+    // Makes room for every slot handed out so far and returns how many there are.
+    // Called by the renderer before it fills slots.
+    static size_t prepareSlots();
+
+    // Slots that are only valid until the next beginFrame() (debug draws and the like)
+    static int allocateTransient();
+
+    // Starts a new frame: transient slots and the instance stream are reused from the start
+    static void beginFrame();
+
+    // Records the matrix, marking the slot dirty only if it changed
+    static void set(int slot, const glm::mat4& transform);
+
+    // set() in two halves, for filling slots from several threads. store() may run
+    // concurrently for different slots; it returns true when the slot just became dirty,
+    // and those slots go to markDirty() from a single thread before the next upload().
+    static bool store(int slot, const glm::mat4& transform);
+    static void markDirty(int slot) { dirtySlots.push_back(slot); }
+
+    // Sends every dirty slot to the GPU, merging neighbouring ones into a single range
+    static void upload();
+
+    // Makes room for `count` entries in a row, so that a batch streamed right after is contiguous
+    static void reserveInstances(size_t count);
+
+    // Appends a slot to this frame's instance stream and returns its position (the base instance).
+    // For shaders that read MaterialLayers the entry also carries the instance's materialIndex.
+    static unsigned int streamInstance(int slot, int material = -1);
+
+    // Sends the stream entries added since the last flush (nothing to do when they went into the ring)
+    static void flushInstances();
+
+    // Binds the VAO and points its transform index attribute at the instance stream. The VAO
+    // is remembered, so it follows the stream when that moves to another buffer.
+    static void bindIndexAttribute(unsigned int vertexArray);
+
+    static TransformStats stats;
+    static void resetStats() { stats = TransformStats(); }
+
+private:
+    // Dirty slots closer than this are sent in one range; re-sending a few
+    // clean matrices is cheaper than another glBufferSubData call
+    static constexpr int MergeGap = 4;
+    static constexpr int InitialCapacity = 1024;
+
+    static unsigned int ssbo;
+    static unsigned int streamBuffer; // Transform slots, read once per instance
+    static int gpuCapacity;           // Slots the storage buffer currently holds
+    static size_t streamCapacity;     // Entries the stream buffer currently holds
+
+    static std::vector<glm::mat4> shadow;
+    static std::vector<uint8_t> dirtyFlags;
+    static std::vector<int> dirtySlots;
+    static std::vector<int> freeSlots;
+    static size_t slotCount;        // Slots handed out, free ones included
+    static std::mutex slotMutex;    // Guards the two above
+    static std::vector<int> transientSlots;
+    static size_t transientUsed;
+
+    static constexpr size_t MinRingChunk = 1024; // Entries
+
+    static std::vector<uint32_t> instanceStream;
+    static size_t instancesFlushed; // Stream entries already on the GPU this frame
+
+    // Stream entries in the StreamRing: the current chunk, in entries from the start of the ring
+    static bool streamInRing;       // This frame's stream goes into the ring
+    static size_t ringChunk;
+    static size_t ringChunkUsed;
+    static size_t ringChunkSize;
+
+    // VAOs whose transform index attribute reads the stream, and the buffer they read now
+    static std::vector<unsigned int> streamVAOs;
+    static unsigned int pointedBuffer;
+    static unsigned int pointedRingGrows;
+
+    // The buffer the stream lives in this frame, and pointing every stream VAO at it
+    static unsigned int currentStreamBuffer();
+    static void pointStreamVAOs();
+
+    // Reallocates the storage buffer when slots were handed out past its size
+    static void grow();
+};
+
+#endif
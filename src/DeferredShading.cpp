@@ -0,0 +1,412 @@
+#include "../include/DeferredShading.h"
+#include "../include/GLState.h"
+#include "../include/Material.h"
+#include "../include/TransformBuffer.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// Writes the surface into the G-buffer. Reads FrameData, MaterialData and the
+// material samplers like a material shader. Built per material as ShaderVariants:
+// TRANSFORM_DATA on 4.3, and HAS_*_MAP for the maps the material has.
+const char* GeometryVertexShader = R"(
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+struct Light { vec3 position; float intensity; vec3 color; };
+layout(std140) uniform FrameData { mat4 view; mat4 projection; vec3 viewPos; int numLights; Light lights[64]; };
+#ifdef TRANSFORM_DATA
+layout(std430, binding = 0) readonly buffer TransformData { mat4 models[]; };
+layout (location = 4) in uint aTransformIndex;
+#else
+uniform mat4 model;
+#endif
+out vec3 vNormal;
+out vec3 vTangent;
+out vec2 vTexCoords;
+void main() {
+#ifdef TRANSFORM_DATA
+    mat4 model = models[aTransformIndex & 0xFFFFFFu]; // GpuCuller may put a material above the slot
+#endif
+    mat3 normalMatrix = mat3(transpose(inverse(model)));
+    vNormal = normalMatrix * aNormal;
+    vTangent = mat3(model) * aTangent;
+    vTexCoords = aTexCoords;
+    gl_Position = projection * view * (model * vec4(aPos, 1.0));
+}
+)";
+
+const char* GeometryFragmentShader = R"(
+in vec3 vNormal;
+in vec3 vTangent;
+in vec2 vTexCoords;
+struct Material { sampler2D diffuse; sampler2D specular; sampler2D normal; };
+uniform Material material;
+struct MaterialParams { float hasDiffuse; float hasSpecular; float hasNormalMap; float shininess; vec2 textureScale; };
+layout(std140) uniform MaterialData { MaterialParams materials[256]; };
+uniform int materialIndex;
+layout (location = 0) out vec4 gAlbedoSpecular;
+layout (location = 1) out vec4 gNormalShininess;
+void main() {
+    MaterialParams params = materials[materialIndex];
+    vec2 uv = vTexCoords * params.textureScale;
+#ifdef HAS_DIFFUSE_MAP
+    vec3 albedo = texture(material.diffuse, uv).rgb;
+#else
+    vec3 albedo = vec3(0.8);
+#endif
+#ifdef HAS_SPECULAR_MAP
+    float specular = texture(material.specular, uv).r;
+#else
+    float specular = 0.5;
+#endif
+
+    vec3 n = normalize(vNormal);
+#ifdef HAS_NORMAL_MAP
+    vec3 t = normalize(vTangent - n * dot(n, vTangent));
+    n = normalize(mat3(t, cross(n, t), n) * (texture(material.normal, uv).rgb * 2.0 - 1.0));
+#endif
+    gAlbedoSpecular = vec4(albedo, specular);
+    gNormalShininess = vec4(n, params.shininess);
+}
+)";
+
+// Shared by the lighting passes: the G-buffer, read one texel per pixel
+const char* GBufferGLSL = R"(#version 330 core
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormalShininess;
+uniform sampler2D gDepth;
+)";
+
+// One triangle over the whole viewport: ambient plus the summed lights, and the depth for the passes after
+const char* CompositeVertexShader = R"(#version 330 core
+void main() {
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+const char* CompositeFragmentShaderMain = R"(
+uniform sampler2D lightSum;
+uniform float ambient;
+out vec4 FragColor;
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, texel, 0).r;
+    if (depth >= 1.0) discard; // Nothing drawn here, keep the clear color
+    vec3 color = ambient * texelFetch(gAlbedoSpecular, texel, 0).rgb + texelFetch(lightSum, texel, 0).rgb;
+    FragColor = vec4(color, 1.0);
+    gl_FragDepth = depth;
+}
+)";
+
+// A box around every light's range. The fragment rebuilds its surface's position
+// from the depth and adds the light if the surface is in range.
+const char* LightVertexShader = R"(#version 330 core
+layout (location = 0) in vec3 aCorner;
+layout (location = 1) in vec4 aPositionRange;
+layout (location = 2) in vec4 aColorIntensity;
+layout (location = 3) in vec4 aAttenuation;
+uniform mat4 viewProjection;
+flat out vec4 vPositionRange;
+flat out vec4 vColorIntensity;
+flat out vec3 vAttenuation;
+void main() {
+    vPositionRange = aPositionRange;
+    vColorIntensity = aColorIntensity;
+    vAttenuation = aAttenuation.xyz;
+    gl_Position = viewProjection * vec4(aPositionRange.xyz + aCorner * aPositionRange.w, 1.0);
+}
+)";
+
+const char* LightFragmentShaderMain = R"(
+uniform mat4 inverseViewProjection;
+uniform vec3 viewPos;
+uniform vec4 viewport;
+flat in vec4 vPositionRange;
+flat in vec4 vColorIntensity;
+flat in vec3 vAttenuation;
+out vec4 FragColor;
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, texel, 0).r;
+    vec4 clip = vec4((gl_FragCoord.xy - viewport.xy) / viewport.zw * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 world = inverseViewProjection * clip;
+    vec3 position = world.xyz / world.w;
+
+    vec3 l = vPositionRange.xyz - position;
+    float d = length(l);
+    if (d >= vPositionRange.w) discard;
+    l /= d;
+
+    vec4 albedoSpecular = texelFetch(gAlbedoSpecular, texel, 0);
+    vec4 normalShininess = texelFetch(gNormalShininess, texel, 0);
+    vec3 n = normalShininess.xyz;
+    vec3 h = normalize(l + normalize(viewPos - position));
+    float attenuation = vColorIntensity.w / (vAttenuation.x + vAttenuation.y * d + vAttenuation.z * d * d);
+    vec3 lit = albedoSpecular.rgb * max(dot(n, l), 0.0) + albedoSpecular.a * pow(max(dot(n, h), 0.0), normalShininess.w);
+    FragColor = vec4(attenuation * vColorIntensity.rgb * lit, 1.0);
+}
+)";
+
+// Unit box, wound counter-clockwise seen from outside; corner i has its x, y, z sign in bits 0, 1, 2
+const float BoxCorners[] = {
+    -1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,  -1.0f,  1.0f, -1.0f,   1.0f,  1.0f, -1.0f,
+    -1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f,  -1.0f,  1.0f,  1.0f,   1.0f,  1.0f,  1.0f,
+};
+const unsigned int BoxIndices[] = {
+    0, 4, 6, 0, 6, 2,  1, 7, 5, 1, 3, 7,  // -x, +x
+    0, 1, 5, 0, 5, 4,  2, 6, 7, 2, 7, 3,  // -y, +y
+    0, 2, 3, 0, 3, 1,  4, 5, 7, 4, 7, 6,  // -z, +z
+};
+
+bool linked(const Shader& shader) {
+    GLint status = 0;
+    glGetProgramiv(shader.ID, GL_LINK_STATUS, &status);
+    return status == GL_TRUE;
+}
+
+}
+
+Shader& DeferredShading::getGeometryShader(const Material& material) {
+    return *m_geometryShaders->get(material.getFeatures() | ShaderVariants::getContextFeatures());
+}
+
+bool DeferredShading::init() {
+    if (m_initialized) return m_geometryShaders != nullptr;
+    m_initialized = true;
+
+    // 1. Programs. The geometry pass reads TransformData whenever the Renderer's other draws can
+    //    (ShaderVariants::TransformData). Its variants are built as materials need them; the one
+    //    with every map is built now, to find out whether the code compiles at all.
+    std::string geometryHeader = TransformBuffer::isAvailable() ? "#version 430 core\n" : "#version 330 core\n";
+    m_geometryShaders = ShaderVariants::fromSource(geometryHeader + GeometryVertexShader, geometryHeader + GeometryFragmentShader);
+    uint32_t allMaps = ShaderVariants::DiffuseMap | ShaderVariants::SpecularMap | ShaderVariants::NormalMap;
+    std::shared_ptr<Shader> fullGeometryShader = m_geometryShaders->get(allMaps | ShaderVariants::getContextFeatures());
+    m_compositeShader = Shader::fromSource(CompositeVertexShader, std::string(GBufferGLSL) + CompositeFragmentShaderMain);
+    m_lightShader = Shader::fromSource(LightVertexShader, std::string(GBufferGLSL) + LightFragmentShaderMain);
+    if (!linked(*fullGeometryShader) || !linked(*m_compositeShader) || !linked(*m_lightShader)) {
+        std::cout << "Error: deferred shading programs failed to build, the renderer stays forward." << std::endl;
+        m_geometryShaders = nullptr;
+        return false;
+    }
+    for (Shader* shader : { m_compositeShader.get(), m_lightShader.get() }) {
+        shader->use();
+        shader->set(shader->getUniform("gAlbedoSpecular"), 0);
+        shader->set(shader->getUniform("gNormalShininess"), 1);
+        shader->set(shader->getUniform("gDepth"), 2);
+    }
+    m_compositeShader->use();
+    m_compositeShader->set(m_compositeShader->getUniform("lightSum"), 3);
+    m_compositeShader->set(m_compositeShader->getUniform("ambient"), Ambient);
+
+    // 2. The light box, plus a stream of ClusterLight per box
+    glGenVertexArrays(1, &m_emptyVAO);
+    glGenVertexArrays(1, &m_boxVAO);
+    glGenBuffers(1, &m_boxVBO);
+    glGenBuffers(1, &m_boxEBO);
+    glGenBuffers(1, &m_instanceVBO);
+
+    GLState::bindVertexArray(m_boxVAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, m_boxVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(BoxCorners), BoxCorners, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_boxEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(BoxIndices), BoxIndices, GL_STATIC_DRAW);
+
+    GLState::bindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+    for (int i = 0; i < 3; ++i) {
+        glVertexAttribPointer(1 + i, 4, GL_FLOAT, GL_FALSE, sizeof(ClusterLight), (void*)(i * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(1 + i);
+        glVertexAttribDivisor(1 + i, 1);
+    }
+    return true;
+}
+
+void DeferredShading::deleteTargets() {
+    if (!m_framebuffer) return;
+    glDeleteFramebuffers(1, &m_framebuffer);
+    glDeleteTextures(1, &m_albedoSpecular);
+    glDeleteTextures(1, &m_normalShininess);
+    glDeleteTextures(1, &m_depth);
+    glDeleteFramebuffers(1, &m_lightFramebuffer);
+    glDeleteTextures(1, &m_lightSum);
+    glDeleteRenderbuffers(1, &m_lightDepth);
+    GLState::invalidate(); // The deleted names can come back
+    m_framebuffer = m_albedoSpecular = m_normalShininess = m_depth = m_lightFramebuffer = m_lightSum = m_lightDepth = 0;
+    m_width = m_height = 0;
+}
+
+bool DeferredShading::resize(int width, int height) {
+    if (width == m_width && height == m_height && m_framebuffer) return true;
+
+    deleteTargets();
+    m_width = width;
+    m_height = height;
+
+    auto createTexture = [&](unsigned int& texture, GLint format, GLenum layout, GLenum type) {
+        glGenTextures(1, &texture);
+        GLState::bindTexture(0, GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, layout, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    };
+    createTexture(m_albedoSpecular, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+    createTexture(m_normalShininess, GL_RGBA16F, GL_RGBA, GL_FLOAT);
+    createTexture(m_depth, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8);
+    createTexture(m_lightSum, GL_RGBA16F, GL_RGBA, GL_FLOAT);
+
+    glGenFramebuffers(1, &m_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_albedoSpecular, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_normalShininess, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_depth, 0);
+    const GLenum attachments[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, attachments);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    // Lights are summed in half floats, so hundreds of faint ones don't each round away to nothing.
+    // They test against a copy of the depth and stencil, since the texture itself is being read.
+    glGenRenderbuffers(1, &m_lightDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_lightDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glGenFramebuffers(1, &m_lightFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_lightFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_lightSum, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_lightDepth);
+    complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_previousFramebuffer);
+    if (!complete) {
+        // The driver won't take this G-buffer, and wouldn't next frame either: give it all back and
+        // fail init() from now on, like programs that don't build
+        std::cout << "Error: G-buffer framebuffer is incomplete, the renderer stays forward." << std::endl;
+        deleteTargets();
+        m_geometryShaders = nullptr;
+    }
+    return complete;
+}
+
+bool DeferredShading::beginGeometry() {
+    if (!init()) return false;
+
+    // 1. The G-buffer covers the viewport where it is, so a pixel has the same coordinates in both
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_previousFramebuffer);
+    if (!resize(viewport[0] + viewport[2], viewport[1] + viewport[3])) return false;
+
+    // 2. Depth clears to the far plane, so the lighting passes know where nothing was drawn.
+    //    Every drawn pixel also sets the stencil, so the light boxes skip the empty ones outright.
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClearStencil(0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    glEnable(GL_STENCIL_TEST);
+    glStencilFunc(GL_ALWAYS, 1, 0xFF);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+    return true;
+}
+
+unsigned int DeferredShading::light(const std::vector<ClusterLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+                                    const glm::vec3& viewPos, float nearPlane, float farPlane) {
+    // 1. Lights that reach anything, the boxes the camera is outside of first. A light that
+    //    never fades still only matters up to the furthest visible point, so its box stops there.
+    m_volumes.clear();
+    m_insideVolumes.clear();
+    for (const ClusterLight& light : lights) {
+        float range = light.positionRange.w;
+        if (range <= 0.0f) continue;
+        ClusterLight volume = light;
+        glm::vec3 offset = glm::abs(viewPos - glm::vec3(light.positionRange));
+        volume.positionRange.w = std::min(range, glm::length(offset) + farPlane);
+
+        // A box closer than the near plane counts as around the camera, or its front faces would clip
+        float reach = volume.positionRange.w + nearPlane;
+        bool inside = offset.x < reach && offset.y < reach && offset.z < reach;
+        (inside ? m_insideVolumes : m_volumes).push_back(volume);
+    }
+    size_t outsideCount = m_volumes.size();
+    m_volumes.insert(m_volumes.end(), m_insideVolumes.begin(), m_insideVolumes.end());
+
+    GLState::bindTexture(0, GL_TEXTURE_2D, m_albedoSpecular);
+    GLState::bindTexture(1, GL_TEXTURE_2D, m_normalShininess);
+    GLState::bindTexture(2, GL_TEXTURE_2D, m_depth);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_lightFramebuffer);
+    glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_lightFramebuffer);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // 2. Sum the lights. Boxes the camera is outside of keep the front faces in front of the
+    //    surface, so lights hidden behind a wall cost nothing; boxes around the camera keep
+    //    the back faces behind it. Depth clamping keeps boxes past the far plane whole.
+    //    Only pixels something was drawn to pass the stencil.
+    if (!m_volumes.empty()) {
+        glm::mat4 viewProjection = projection * view;
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
+        GLState::bindVertexArray(m_boxVAO);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, m_volumes.size() * sizeof(ClusterLight), m_volumes.data(), GL_STREAM_DRAW);
+
+        m_lightShader->use();
+        m_lightShader->set(m_lightShader->getUniform("viewProjection"), viewProjection);
+        m_lightShader->set(m_lightShader->getUniform("inverseViewProjection"), glm::inverse(viewProjection));
+        m_lightShader->set(m_lightShader->getUniform("viewPos"), viewPos);
+        m_lightShader->set(m_lightShader->getUniform("viewport"), glm::vec4(viewport[0], viewport[1], viewport[2], viewport[3]));
+
+        glDepthMask(GL_FALSE);
+        glStencilFunc(GL_EQUAL, 1, 0xFF);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+        glEnable(GL_DEPTH_CLAMP);
+        glEnable(GL_CULL_FACE);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+
+        if (outsideCount > 0) {
+            glCullFace(GL_BACK);
+            glDepthFunc(GL_LEQUAL);
+            glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0, static_cast<GLsizei>(outsideCount));
+        }
+        if (outsideCount < m_volumes.size()) {
+            glCullFace(GL_FRONT);
+            glDepthFunc(GL_GEQUAL);
+            // Base instances need GL 4.2, so the stream starts further in instead
+            for (int i = 0; i < 3; ++i) {
+                glVertexAttribPointer(1 + i, 4, GL_FLOAT, GL_FALSE, sizeof(ClusterLight),
+                                      (void*)(outsideCount * sizeof(ClusterLight) + i * sizeof(glm::vec4)));
+            }
+            glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0, static_cast<GLsizei>(m_volumes.size() - outsideCount));
+            for (int i = 0; i < 3; ++i) {
+                glVertexAttribPointer(1 + i, 4, GL_FLOAT, GL_FALSE, sizeof(ClusterLight), (void*)(i * sizeof(glm::vec4)));
+            }
+        }
+
+        glDisable(GL_BLEND);
+        glCullFace(GL_BACK);
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_DEPTH_CLAMP);
+        glDepthMask(GL_TRUE);
+    }
+
+    // 3. Ambient plus the lights into the framebuffer, with the G-buffer's depth
+    glDisable(GL_STENCIL_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_previousFramebuffer);
+    GLState::bindTexture(3, GL_TEXTURE_2D, m_lightSum);
+    glDepthFunc(GL_ALWAYS);
+    m_compositeShader->use();
+    GLState::bindVertexArray(m_emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glDepthFunc(GL_LESS);
+    GLState::bindTexture(3, GL_TEXTURE_2D, 0); // Not left bound while the next frame renders into it
+
+    return static_cast<unsigned int>(m_volumes.size());
+}
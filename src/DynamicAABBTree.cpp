@@ -0,0 +1,213 @@
+#include "../include/DynamicAABBTree.h"
+#include <algorithm>
+#include <cmath>
+
+int DynamicAABBTree::allocateNode() {
+    if (freeList == Null) {
+        nodes.emplace_back();
+        return static_cast<int>(nodes.size()) - 1;
+    }
+    int index = freeList;
+    freeList = nodes[index].parent;
+    nodes[index] = TreeNode();
+    return index;
+}
+
+void DynamicAABBTree::freeNode(int index) {
+    nodes[index].parent = freeList;
+    nodes[index].height = -1;
+    nodes[index].userData = nullptr;
+    freeList = index;
+}
+
+int DynamicAABBTree::createProxy(const AABB& box, void* userData) {
+    int proxy = allocateNode();
+    TreeNode& node = nodes[proxy];
+    node.box.min = box.min - glm::vec3(margin);
+    node.box.max = box.max + glm::vec3(margin);
+    node.userData = userData;
+    node.height = 0;
+
+    insertLeaf(proxy);
+    proxyCount++;
+    return proxy;
+}
+
+void DynamicAABBTree::destroyProxy(int proxy) {
+    removeLeaf(proxy);
+    freeNode(proxy);
+    proxyCount--;
+}
+
+bool DynamicAABBTree::moveProxy(int proxy, const AABB& box) {
+    // Still inside the fat box: nothing to do
+    if (contains(nodes[proxy].box, box)) return false;
+
+    removeLeaf(proxy);
+    nodes[proxy].box.min = box.min - glm::vec3(margin);
+    nodes[proxy].box.max = box.max + glm::vec3(margin);
+    insertLeaf(proxy);
+    return true;
+}
+
+void DynamicAABBTree::insertLeaf(int leaf) {
+    if (root == Null) {
+        root = leaf;
+        nodes[root].parent = Null;
+        return;
+    }
+
+    // 1. Walk down to the sibling that grows the tree's total area the least
+    AABB leafBox = nodes[leaf].box;
+    int index = root;
+    while (!nodes[index].isLeaf()) {
+        int child1 = nodes[index].child1;
+        int child2 = nodes[index].child2;
+
+        float area = cost(nodes[index].box);
+        float combinedArea = cost(combine(nodes[index].box, leafBox));
+
+        // Cost of making a new parent for this node and the new leaf
+        float siblingCost = 2.0f * combinedArea;
+
+        // Minimum cost of pushing the leaf further down the tree
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        auto descendCost = [&](int child) {
+            float grown = cost(combine(leafBox, nodes[child].box));
+            if (nodes[child].isLeaf()) return grown + inheritanceCost;
+            return grown - cost(nodes[child].box) + inheritanceCost;
+        };
+        float cost1 = descendCost(child1);
+        float cost2 = descendCost(child2);
+
+        if (siblingCost < cost1 && siblingCost < cost2) break;
+        index = cost1 < cost2 ? child1 : child2;
+    }
+    int sibling = index;
+
+    // 2. Give the sibling and the leaf a new common parent
+    int oldParent = nodes[sibling].parent;
+    int newParent = allocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].box = combine(leafBox, nodes[sibling].box);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent != Null) {
+        if (nodes[oldParent].child1 == sibling) {
+            nodes[oldParent].child1 = newParent;
+        } else {
+            nodes[oldParent].child2 = newParent;
+        }
+    } else {
+        root = newParent;
+    }
+
+    // 3. Walk back up, fixing heights and boxes and rebalancing on the way
+    index = nodes[leaf].parent;
+    while (index != Null) {
+        index = balance(index);
+
+        int child1 = nodes[index].child1;
+        int child2 = nodes[index].child2;
+        nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+        nodes[index].box = combine(nodes[child1].box, nodes[child2].box);
+
+        index = nodes[index].parent;
+    }
+}
+
+void DynamicAABBTree::removeLeaf(int leaf) {
+    if (leaf == root) {
+        root = Null;
+        return;
+    }
+
+    // The leaf's parent goes away and the sibling takes its place
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+    if (grandParent == Null) {
+        root = sibling;
+        nodes[sibling].parent = Null;
+        freeNode(parent);
+        return;
+    }
+
+    if (nodes[grandParent].child1 == parent) {
+        nodes[grandParent].child1 = sibling;
+    } else {
+        nodes[grandParent].child2 = sibling;
+    }
+    nodes[sibling].parent = grandParent;
+    freeNode(parent);
+
+    int index = grandParent;
+    while (index != Null) {
+        index = balance(index);
+
+        int child1 = nodes[index].child1;
+        int child2 = nodes[index].child2;
+        nodes[index].box = combine(nodes[child1].box, nodes[child2].box);
+        nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+
+        index = nodes[index].parent;
+    }
+}
+
+int DynamicAABBTree::balance(int iA) {
+    TreeNode& A = nodes[iA];
+    if (A.isLeaf() || A.height < 2) return iA;
+
+    int iB = A.child1;
+    int iC = A.child2;
+    int heightDifference = nodes[iC].height - nodes[iB].height;
+
+    // Rotates the taller child `iUp` up to where iA is; iA takes the shorter grandchild
+    auto rotate = [&](int iUp, int iOther, bool upIsChild2) {
+        TreeNode& up = nodes[iUp];
+        int iF = up.child1;
+        int iG = up.child2;
+
+        up.child1 = iA;
+        up.parent = nodes[iA].parent;
+        nodes[iA].parent = iUp;
+
+        // iA's old parent now points at iUp
+        if (up.parent != Null) {
+            if (nodes[up.parent].child1 == iA) {
+                nodes[up.parent].child1 = iUp;
+            } else {
+                nodes[up.parent].child2 = iUp;
+            }
+        } else {
+            root = iUp;
+        }
+
+        // Keep the taller grandchild under iUp, hand the other one to iA
+        int keep = nodes[iF].height > nodes[iG].height ? iF : iG;
+        int give = keep == iF ? iG : iF;
+        up.child2 = keep;
+        if (upIsChild2) {
+            nodes[iA].child2 = give;
+        } else {
+            nodes[iA].child1 = give;
+        }
+        nodes[give].parent = iA;
+
+        nodes[iA].box = combine(nodes[iOther].box, nodes[give].box);
+        nodes[iA].height = 1 + std::max(nodes[iOther].height, nodes[give].height);
+        up.box = combine(nodes[iA].box, nodes[keep].box);
+        up.height = 1 + std::max(nodes[iA].height, nodes[keep].height);
+        return iUp;
+    };
+
+    if (heightDifference > 1) return rotate(iC, iB, true);   // Right side too tall
+    if (heightDifference < -1) return rotate(iB, iC, false); // Left side too tall
+    return iA;
+}
@@ -0,0 +1,194 @@
+#include "../include/GLState.h"
+#include <iostream>
+
+GLStateStats GLState::stats;
+
+// A fresh context has nothing bound and unit 0 active, which is exactly the zeroed cache
+GLuint GLState::program = 0;
+GLuint GLState::vertexArray = 0;
+GLuint GLState::activeUnit = 0;
+GLuint GLState::textures[GLState::MaxTextureUnits][GLState::TextureTargets] = {};
+GLuint GLState::buffers[GLState::BufferTargets] = {};
+GLuint GLState::indexedBuffers[GLState::IndexedTargets][GLState::MaxIndexedBindings] = {};
+
+void GLState::invalidate() {
+    program = ~0u;
+    vertexArray = ~0u;
+    activeUnit = ~0u;
+    for (auto& unit : textures) {
+        for (auto& texture : unit) texture = ~0u;
+    }
+    for (auto& buffer : buffers) buffer = ~0u;
+    for (auto& target : indexedBuffers) {
+        for (auto& buffer : target) buffer = ~0u;
+    }
+}
+
+int GLState::textureTargetSlot(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_2D_ARRAY: return 1;
+        case GL_TEXTURE_CUBE_MAP: return 2;
+        default: return -1;
+    }
+}
+
+int GLState::bufferTargetSlot(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_UNIFORM_BUFFER: return 1;
+        case GL_SHADER_STORAGE_BUFFER: return 2;
+        case GL_DRAW_INDIRECT_BUFFER: return 3;
+        case GL_COPY_WRITE_BUFFER: return 4;
+        default: return -1;
+    }
+}
+
+int GLState::indexedTargetSlot(GLenum target) {
+    switch (target) {
+        case GL_UNIFORM_BUFFER: return 0;
+        case GL_SHADER_STORAGE_BUFFER: return 1;
+        default: return -1;
+    }
+}
+
+void GLState::useProgram(GLuint id) {
+    if (program == id) {
+        stats.skipped++;
+        validate("program", GL_CURRENT_PROGRAM, id);
+        return;
+    }
+    glUseProgram(id);
+    program = id;
+    stats.binds++;
+}
+
+void GLState::bindVertexArray(GLuint vao) {
+    if (vertexArray == vao) {
+        stats.skipped++;
+        validate("vertex array", GL_VERTEX_ARRAY_BINDING, vao);
+        return;
+    }
+    glBindVertexArray(vao);
+    vertexArray = vao;
+    stats.binds++;
+}
+
+void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+    int slot = textureTargetSlot(target);
+    if (slot < 0 || unit >= static_cast<GLuint>(MaxTextureUnits)) {
+        // Target or unit isn't cached: always bind
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        activeUnit = unit;
+        stats.binds++;
+        return;
+    }
+
+    if (textures[unit][slot] == texture) {
+        stats.skipped++;
+        static const GLenum queries[TextureTargets] = { GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_CUBE_MAP };
+        validateTexture(unit, queries[slot], texture);
+        return;
+    }
+
+    if (activeUnit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+    }
+    glBindTexture(target, texture);
+    textures[unit][slot] = texture;
+    stats.binds++;
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer) {
+    int slot = bufferTargetSlot(target);
+    if (slot < 0) {
+        glBindBuffer(target, buffer);
+        stats.binds++;
+        return;
+    }
+
+    if (buffers[slot] == buffer) {
+        stats.skipped++;
+        static const GLenum queries[BufferTargets] = {
+            GL_ARRAY_BUFFER_BINDING, GL_UNIFORM_BUFFER_BINDING, GL_SHADER_STORAGE_BUFFER_BINDING,
+            GL_DRAW_INDIRECT_BUFFER_BINDING, GL_COPY_WRITE_BUFFER_BINDING
+        };
+        validate("buffer", queries[slot], buffer);
+        return;
+    }
+    glBindBuffer(target, buffer);
+    buffers[slot] = buffer;
+    stats.binds++;
+}
+
+void GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    int slot = indexedTargetSlot(target);
+    if (slot < 0 || index >= static_cast<GLuint>(MaxIndexedBindings)) {
+        glBindBufferBase(target, index, buffer);
+        int generic = bufferTargetSlot(target);
+        if (generic >= 0) buffers[generic] = buffer;
+        stats.binds++;
+        return;
+    }
+
+    if (indexedBuffers[slot][index] == buffer) {
+        stats.skipped++;
+        validateIndexed(slot == 0 ? GL_UNIFORM_BUFFER_BINDING : GL_SHADER_STORAGE_BUFFER_BINDING, index, buffer);
+        return;
+    }
+    glBindBufferBase(target, index, buffer);
+    indexedBuffers[slot][index] = buffer;
+    buffers[bufferTargetSlot(target)] = buffer;
+    stats.binds++;
+}
+
+void GLState::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    glBindBufferRange(target, index, buffer, offset, size);
+    int slot = indexedTargetSlot(target);
+    if (slot >= 0 && index < static_cast<GLuint>(MaxIndexedBindings)) indexedBuffers[slot][index] = ~0u;
+    int generic = bufferTargetSlot(target);
+    if (generic >= 0) buffers[generic] = buffer;
+    stats.binds++;
+}
+
+#ifdef FORCE_GL_STATE_VALIDATION
+
+void GLState::validate(const char* what, GLenum query, GLuint expected) {
+    GLint actual = 0;
+    glGetIntegerv(query, &actual);
+    if (static_cast<GLuint>(actual) != expected) {
+        std::cout << "[GLState] Cached " << what << " binding is " << expected
+                  << " but GL has " << actual << " (missing GLState::invalidate()?)" << std::endl;
+    }
+}
+
+void GLState::validateTexture(GLuint unit, GLenum query, GLuint expected) {
+    GLint previousUnit = 0, actual = 0;
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &previousUnit);
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glGetIntegerv(query, &actual);
+    glActiveTexture(static_cast<GLenum>(previousUnit));
+    if (static_cast<GLuint>(actual) != expected) {
+        std::cout << "[GLState] Cached texture on unit " << unit << " is " << expected
+                  << " but GL has " << actual << " (missing GLState::invalidate()?)" << std::endl;
+    }
+}
+
+void GLState::validateIndexed(GLenum query, GLuint index, GLuint expected) {
+    GLint actual = 0;
+    glGetIntegeri_v(query, index, &actual);
+    if (static_cast<GLuint>(actual) != expected) {
+        std::cout << "[GLState] Cached buffer on binding point " << index << " is " << expected
+                  << " but GL has " << actual << " (missing GLState::invalidate()?)" << std::endl;
+    }
+}
+
+#else
+
+void GLState::validate(const char*, GLenum, GLuint) {}
+void GLState::validateTexture(GLuint, GLenum, GLuint) {}
+void GLState::validateIndexed(GLenum, GLuint, GLuint) {}
+
+#endif
@@ -7,9 +7,17 @@
 #include "RendererComponent.h"
 #include "LightComponent.h"
 #include "Entity.h"
+#include "GpuCuller.h"
+#include "GeometryPool.h"
+#include "StreamRing.h"
+#include "TextureArrays.h"
+#include "ShaderCache.h"
+#include "ShaderVariants.h"
+#include "JobSystem.h"
 #include <memory>
 #include "SpinComponent.h"
 #include <cstdlib>
+#include <algorithm>
 #include "PhysicsComponent.h"
 #include "ColliderComponent.h"
 #include "FlapControllerComponent.h"
@@ -19,6 +27,9 @@
 #include "ComponentRegistry.h"
 
 std::vector<ColliderComponent*> ColliderComponent::allColliders;
+std::vector<LightComponent*> LightComponent::allLights;
+DynamicAABBTree RendererComponent::spatialIndex;
+std::vector<RendererComponent*> RendererComponent::dirtyRenderers;
 
 Game::Game() {
     // Camera starts 6 units back on the Z axis
@@ -31,15 +42,18 @@ Game::~Game() {
 }
 
 void Game::init(GLFWwindow* window) {
+    renderer.init();
 
     // 1. Prime the Component Registry
-    ComponentRegistry::registerComponent("RendererComponent", RendererComponent::deserialize);
-    ComponentRegistry::registerComponent("PhysicsComponent", PhysicsComponent::deserialize);
-    ComponentRegistry::registerComponent("ColliderComponent", ColliderComponent::deserialize);
-    ComponentRegistry::registerComponent("FlapControllerComponent", FlapControllerComponent::deserialize);
-    ComponentRegistry::registerComponent("CameraComponent", CameraComponent::deserialize);
-    ComponentRegistry::registerComponent("LightComponent", LightComponent::deserialize);
-    ComponentRegistry::registerComponent("GameManagerComponent", GameManagerComponent::deserialize);
+    ComponentRegistry::registerComponent<RendererComponent>("RendererComponent");
+    ComponentRegistry::registerComponent<PhysicsComponent>("PhysicsComponent");
+    ComponentRegistry::registerComponent<ColliderComponent>("ColliderComponent");
+    ComponentRegistry::registerComponent<FlapControllerComponent>("FlapControllerComponent");
+    ComponentRegistry::registerComponent<CameraComponent>("CameraComponent");
+    ComponentRegistry::registerComponent<LightComponent>("LightComponent");
+    ComponentRegistry::registerComponent<GameManagerComponent>("GameManagerComponent");
+    ComponentRegistry::registerComponent<LinearMovementComponent>("LinearMovementComponent");
+    ComponentRegistry::registerComponent<SpinComponent>("SpinComponent");
     
     auto root_entity = std::make_shared<Entity>();
     entities.push_back(root_entity);
@@ -77,6 +91,43 @@ void Game::processInput(GLFWwindow* window) {
         escPressedLastFrame = false;
     }
 
+    // F4 switches between forward and deferred shading
+    static bool f4PressedLastFrame = false;
+    if (glfwGetKey(window, GLFW_KEY_F4) == GLFW_PRESS) {
+        if (!f4PressedLastFrame) {
+            toggleDeferredShading = !toggleDeferredShading;
+            f4PressedLastFrame = true;
+        }
+    } else {
+        f4PressedLastFrame = false;
+    }
+
+    // F5 turns the depth prepass on and off
+    static bool f5PressedLastFrame = false;
+    if (glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS) {
+        if (!f5PressedLastFrame) {
+            toggleDepthPrepass = !toggleDepthPrepass;
+            f5PressedLastFrame = true;
+        }
+    } else {
+        f5PressedLastFrame = false;
+    }
+
+    // F6 doubles the threads building the render queue (and everything else on the
+    // JobSystem), back to one after all of them, to see how it scales
+    static bool f6PressedLastFrame = false;
+    if (glfwGetKey(window, GLFW_KEY_F6) == GLFW_PRESS) {
+        if (!f6PressedLastFrame) {
+            unsigned int threads = JobSystem::getThreadLimit();
+            threads = threads >= JobSystem::getThreadCount() ? 1 : std::min(threads * 2, JobSystem::getThreadCount());
+            JobSystem::setThreadLimit(threads);
+            std::cout << "Job threads: " << threads << " of " << JobSystem::getThreadCount() << std::endl;
+            f6PressedLastFrame = true;
+        }
+    } else {
+        f6PressedLastFrame = false;
+    }
+
     static bool f3PressedLastFrame = false;
     if (glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS) {
         if (!f3PressedLastFrame) {
@@ -102,27 +153,111 @@ void Game::update() {
     }
 }
 
-// 2. Traverse the Scene Graph and pass the data down
-void Game::render() {
+// 2. Copy what the frame needs out of the scene graph
+void Game::extractFrame(FramePacket& packet) {
+    // While debug mode is on, report the previous frame's counters about once a second
+    packet.printStats = false;
+    if (debugMode) {
+        statsTimer += deltaTime;
+        if (statsTimer >= 1.0f) {
+            statsTimer = 0.0f;
+            packet.printStats = true;
+        }
+    }
+
+    packet.toggleDeferredShading = toggleDeferredShading;
+    packet.toggleDepthPrepass = toggleDepthPrepass;
+    toggleDeferredShading = false;
+    toggleDepthPrepass = false;
+
+    // The renderers' spatial index replaces walking the scene graph: only
+    // objects near the view are visited
+    renderer.extractFrame(activeCamera, packet);
+
+    packet.debug = debugMode;
+    if (debugMode) {
+        renderer.extractDebug(packet);
+    }
+}
+
+// 3. Draw it
+void Game::renderFrame(const FramePacket& packet) {
+    if (packet.toggleDeferredShading) renderer.deferredShading = !renderer.deferredShading;
+    if (packet.toggleDepthPrepass) renderer.depthPrepass = !renderer.depthPrepass;
+    if (packet.printStats) printRenderStats();
+
     renderer.clear();
     
     // Setup scene global data
-    if (activeCamera) {
-        renderer.beginScene(activeCamera);
-    }
+    renderer.beginScene(packet);
 
-    // Lambda for recursive drawing
-    // We can't use a local lambda easily with recursion in C++ without std::function overhead or auto deduction tricks
-    // So let's just make a member helper or a free function helper that takes the renderer
-    
-    // Let's use a standard implementation
-    for (auto& rootNode : entities) {
-        renderer.submitNode(rootNode);
+    renderer.endScene();
+
+    if (packet.debug) {
+        renderer.renderDebug(debugCubeModel, packet);
     }
+}
 
-    renderer.endScene();
+void Game::render() {
+    extractFrame(framePacket);
+    renderFrame(framePacket);
+}
 
-    if (debugMode) {
-        renderer.renderDebug(debugCubeModel);
+void Game::printRenderStats() {
+    RenderStats stats = renderer.getStats();
+    std::cout << "[Renderer] draws: " << stats.drawCalls << " (" << stats.instances << " meshes)"
+              << " | uniform lookups: " << stats.uniformLookups
+              << " uploads: " << stats.uniformUploads
+              << " skipped: " << stats.uniformUploadsSkipped
+              << " | switches: shader " << stats.shaderSwitches
+              << " material " << stats.materialSwitches
+              << " mesh " << stats.meshSwitches
+              << " | material uploads: " << stats.materialUploads
+              << " | transforms: " << stats.transformBytesUploaded << " bytes in "
+              << stats.transformUploadSpans << " ranges"
+              << " | visible: " << stats.objectsVisible << " culled: " << stats.objectsCulled
+              << " (+" << stats.subtreesCulled << " subtrees, " << stats.bvhNodesVisited << " BVH nodes)"
+              << " | queue: " << stats.queueBuildMs << " ms in " << stats.queueChunks << " chunks on "
+              << JobSystem::getThreadLimit() << " threads"
+              << " | occluded: " << stats.objectsOccluded << " by " << stats.occluders << " occluders ("
+              << stats.occluderTriangles << " triangles, raster " << stats.occlusionRasterMs << " ms, test "
+              << stats.occlusionTestMs << " ms)"
+              << " | GL binds: " << stats.glBinds << " skipped: " << stats.glBindsSkipped
+              << " | triangles: " << stats.trianglesDrawn << " (" << stats.lodSwitches << " LOD switches)"
+              << " | meshlets culled: " << stats.meshletsCulled << " of " << stats.meshletsTested
+              << " (" << stats.meshletTrianglesCulled << " triangles)"
+              << " | impostors: " << stats.impostors;
+    std::cout << " | " << (renderer.deferredShading ? "deferred" : "forward") << " GPU: " << stats.gpuFrameMs << " ms";
+    if (stats.lightVolumes > 0) std::cout << " (" << stats.lightVolumes << " light volumes)";
+    std::cout << " | opaque: " << stats.opaqueGpuMs << " ms GPU, " << stats.opaqueFragments << " fragments ("
+              << stats.overdraw << " per pixel)";
+    if (renderer.depthPrepass) std::cout << " after a " << stats.depthPrepassGpuMs << " ms depth prepass";
+    if (stats.clusterLights > 0) {
+        std::cout << " | clustered lights: " << stats.clusterLights << " (" << stats.clusterAssignments
+                  << " assignments, max " << stats.clusterMaxLights << " per cluster, " << stats.clusterBuildMs << " ms)";
+    }
+    GeometryPoolStats pool = GeometryPool::getStats();
+    std::cout << " | geometry pool: " << pool.allocations << " meshes, vertices " << pool.usedVertexBytes / 1024 << " of "
+              << pool.vertexBytes / 1024 << " KB, indices " << pool.usedIndexBytes / 1024 << " of " << pool.indexBytes / 1024
+              << " KB, " << pool.freeRanges << " free ranges (" << pool.grows << " grows, " << pool.defragments << " defragments)"
+              << " | indirect commands: " << stats.indirectCommands;
+    TextureArrayStats arrays = TextureArrays::getStats();
+    std::cout << " | texture arrays: " << arrays.usedLayers << " of " << arrays.layers << " layers in " << arrays.pages
+              << " pages (" << arrays.bytes / 1024 << " KB, " << arrays.leftOut << " textures left out), "
+              << stats.materialsBatched << " materials batched";
+    const ShaderVariantStats& variants = ShaderVariants::stats;
+    std::cout << " | shader variants: " << variants.variants << " built from " << variants.sets << " sets in "
+              << variants.buildMs << " ms (" << ShaderCache::stats.hits << " from the binary cache)";
+    if (StreamRing::isAvailable()) {
+        const StreamRingStats& ring = StreamRing::stats;
+        std::cout << " | stream ring: " << ring.bytes / 1024 << " of " << StreamRing::getRegionBytes() / 1024 << " KB in "
+                  << ring.allocations << " allocations, " << ring.overflows << " overflows, stalled " << ring.stallMs
+                  << " ms (" << ring.fenceWaits << " waits)";
     }
-}
\ No newline at end of file
+    if (renderer.gpuCulling && !renderer.renderThread && GpuCuller::isAvailable()) {
+        // Reading the GPU's count back stalls, but this only runs once a second
+        std::cout << " | GPU culling: " << GpuCuller::readVisibleCount() << " of " << stats.gpuInstances
+                  << " instances in " << stats.gpuMultiDraws << " multi-draws";
+    }
+    std::cout << std::endl;
+}
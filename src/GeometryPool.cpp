@@ -0,0 +1,280 @@
+#include "../include/GeometryPool.h"
+#include "../include/TransformBuffer.h"
+#include "../include/GLState.h"
+#include <algorithm>
+#include <map>
+
+unsigned int GeometryPool::indexBuffer = 0;
+unsigned int GeometryPool::scratchBuffer = 0;
+size_t GeometryPool::scratchBytes = 0;
+uint32_t GeometryPool::generation = 0;
+unsigned int GeometryPool::grows = 0;
+unsigned int GeometryPool::defragments = 0;
+
+namespace {
+    // Capacity that leaves room for `needed` more at the end
+    uint32_t grownCapacity(uint32_t capacity, uint32_t needed) {
+        uint32_t grown = std::max(capacity, 1u);
+        while (grown < capacity + needed) grown *= 2;
+        return grown;
+    }
+}
+
+bool GeometryPool::createIndexBuffer() {
+    if (indexBuffer) return true;
+
+    glGenBuffers(1, &indexBuffer);
+    glGenBuffers(1, &scratchBuffer);
+
+    // Filled through the copy target: GL_ELEMENT_ARRAY_BUFFER would change whichever VAO is bound
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, InitialIndices * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+    storage().indices.grow(InitialIndices);
+    return indexBuffer != 0;
+}
+
+bool GeometryPool::createLayout(int layout) {
+    Storage& table = storage();
+    Layout& pool = table.layouts[layout];
+    if (pool.vertexArray) return true;
+
+    bool hasNormals = (layout & 1) != 0;
+    bool hasUVs = (layout & 2) != 0;
+    bool hasTangents = hasNormals && hasUVs;
+    pool.stride = 3 + (hasNormals ? 3 : 0) + (hasUVs ? 2 : 0) + (hasTangents ? 3 : 0);
+    int strideBytes = pool.stride * sizeof(float);
+
+    glGenVertexArrays(1, &pool.vertexArray);
+    glGenVertexArrays(1, &pool.positionVAO);
+    glGenBuffers(1, &pool.vertexBuffer);
+    glGenBuffers(1, &pool.positionBuffer);
+    pool.vertices.grow(InitialVertices);
+
+    // 1. The interleaved vertices, with the same attribute locations Mesh always used
+    GLState::bindVertexArray(pool.vertexArray);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, pool.vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(InitialVertices) * strideBytes, nullptr, GL_STATIC_DRAW);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, strideBytes, (void*)0);
+    glEnableVertexAttribArray(0);
+
+    int offset = 3;
+    if (hasNormals) {
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, strideBytes, (void*)(offset * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        offset += 3;
+    }
+
+    if (hasUVs) {
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, strideBytes, (void*)(offset * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        offset += 2;
+    } else {
+        glDisableVertexAttribArray(2);
+        glVertexAttrib2f(2, 0.0f, 0.0f); // Default UV
+    }
+
+    if (hasTangents) {
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, strideBytes, (void*)(offset * sizeof(float)));
+        glEnableVertexAttribArray(3);
+    } else {
+        glDisableVertexAttribArray(3);
+        glVertexAttrib3f(3, 1.0f, 0.0f, 0.0f); // Default Tangent (Tangent X-axis)
+    }
+    TransformBuffer::bindIndexAttribute(pool.vertexArray);
+
+    // 2. The position-only stream, with the same indices
+    GLState::bindVertexArray(pool.positionVAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, pool.positionBuffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(InitialVertices) * 3 * sizeof(float), nullptr, GL_STATIC_DRAW);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    TransformBuffer::bindIndexAttribute(pool.positionVAO);
+
+    GLState::bindVertexArray(0);
+    return true;
+}
+
+int GeometryPool::allocate(int layout, const std::vector<float>& vertices, const std::vector<unsigned int>& indexList) {
+    Storage& table = storage();
+    if (layout < 0 || layout >= LayoutCount || !createIndexBuffer() || !createLayout(layout)) return Invalid;
+    Layout& pool = table.layouts[layout];
+
+    uint32_t vertexCount = static_cast<uint32_t>(vertices.size() / pool.stride);
+    uint32_t indexCount = static_cast<uint32_t>(indexList.size());
+    size_t vertexBytes = static_cast<size_t>(pool.stride) * sizeof(float);
+
+    // 1. Ranges for both, growing a buffer that has no hole big enough
+    uint32_t baseVertex = pool.vertices.allocate(vertexCount);
+    if (baseVertex == RangeAllocator::Invalid && vertexCount > 0) {
+        uint32_t capacity = pool.vertices.getCapacity();
+        uint32_t grown = grownCapacity(capacity, vertexCount);
+        resize(pool.vertexBuffer, capacity * vertexBytes, grown * vertexBytes);
+        resize(pool.positionBuffer, capacity * 3 * sizeof(float), grown * 3 * sizeof(float));
+        pool.vertices.grow(grown);
+        baseVertex = pool.vertices.allocate(vertexCount);
+        grows++;
+    }
+    uint32_t firstIndex = table.indices.allocate(indexCount);
+    if (firstIndex == RangeAllocator::Invalid && indexCount > 0) {
+        uint32_t capacity = table.indices.getCapacity();
+        uint32_t grown = grownCapacity(capacity, indexCount);
+        resize(indexBuffer, capacity * sizeof(unsigned int), grown * sizeof(unsigned int));
+        table.indices.grow(grown);
+        firstIndex = table.indices.allocate(indexCount);
+        grows++;
+    }
+
+    // 2. Upload. The indices stay local to the mesh; draws add the base vertex.
+    std::vector<float> positions;
+    positions.reserve(static_cast<size_t>(vertexCount) * 3);
+    for (size_t i = 0; i + 2 < vertices.size(); i += pool.stride) {
+        positions.insert(positions.end(), vertices.begin() + i, vertices.begin() + i + 3);
+    }
+    if (vertexCount > 0) {
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, pool.vertexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, baseVertex * vertexBytes, vertexCount * vertexBytes, vertices.data());
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, pool.positionBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, baseVertex * 3 * sizeof(float), positions.size() * sizeof(float), positions.data());
+    }
+    if (indexCount > 0) {
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, firstIndex * sizeof(unsigned int), indexCount * sizeof(unsigned int), indexList.data());
+    }
+
+    // 3. A handle, reusing a released one if there is one
+    Allocation allocation;
+    allocation.layout = layout;
+    allocation.baseVertex = vertexCount > 0 ? baseVertex : 0;
+    allocation.vertexCount = vertexCount;
+    allocation.firstIndex = indexCount > 0 ? firstIndex : 0;
+    allocation.indexCount = indexCount;
+
+    int handle;
+    if (!table.freeHandles.empty()) {
+        handle = table.freeHandles.back();
+        table.freeHandles.pop_back();
+        table.allocations[handle] = allocation;
+        table.live[handle] = 1;
+    } else {
+        handle = static_cast<int>(table.allocations.size());
+        table.allocations.push_back(allocation);
+        table.live.push_back(1);
+    }
+    return handle;
+}
+
+void GeometryPool::release(int handle) {
+    Storage& table = storage();
+    if (handle < 0 || handle >= static_cast<int>(table.allocations.size()) || !table.live[handle]) return;
+
+    const Allocation& allocation = table.allocations[handle];
+    if (allocation.vertexCount > 0) table.layouts[allocation.layout].vertices.free(allocation.baseVertex);
+    if (allocation.indexCount > 0) table.indices.free(allocation.firstIndex);
+    table.live[handle] = 0;
+    table.freeHandles.push_back(handle);
+}
+
+void GeometryPool::resize(unsigned int buffer, size_t oldBytes, size_t newBytes) {
+    // glBufferData throws the contents away, so they wait in the scratch buffer meanwhile.
+    // Re-specifying keeps the buffer name, so every VAO that points at it stays valid.
+    saveToScratch(buffer, oldBytes);
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(newBytes), nullptr, GL_STATIC_DRAW);
+    GLState::bindBuffer(GL_COPY_READ_BUFFER, scratchBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<GLsizeiptr>(oldBytes));
+}
+
+void GeometryPool::saveToScratch(unsigned int buffer, size_t bytes) {
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, scratchBuffer);
+    if (bytes > scratchBytes) {
+        scratchBytes = bytes;
+        glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(scratchBytes), nullptr, GL_STREAM_COPY);
+    }
+    GLState::bindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<GLsizeiptr>(bytes));
+}
+
+void GeometryPool::applyMoves(unsigned int buffer, const std::vector<RangeAllocator::Move>& moves, size_t unit, size_t bytes) {
+    // Ranges only ever move down, but they can land on each other's old place, so
+    // every one is copied from the saved contents rather than from the buffer itself
+    saveToScratch(buffer, bytes);
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    GLState::bindBuffer(GL_COPY_READ_BUFFER, scratchBuffer);
+    for (const RangeAllocator::Move& move : moves) {
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, move.from * unit, move.to * unit, move.size * unit);
+    }
+}
+
+bool GeometryPool::defragment(float threshold) {
+    Storage& table = storage();
+    bool moved = false;
+
+    // 1. Vertices, layout by layout
+    for (int layout = 0; layout < LayoutCount; ++layout) {
+        Layout& pool = table.layouts[layout];
+        if (!pool.vertexArray || pool.vertices.getFragmentation() <= threshold) continue;
+
+        std::vector<RangeAllocator::Move> moves = pool.vertices.compact();
+        if (moves.empty()) continue;
+
+        size_t vertexBytes = static_cast<size_t>(pool.stride) * sizeof(float);
+        applyMoves(pool.vertexBuffer, moves, vertexBytes, pool.vertices.getCapacity() * vertexBytes);
+        applyMoves(pool.positionBuffer, moves, 3 * sizeof(float), pool.vertices.getCapacity() * 3 * sizeof(float));
+
+        std::map<uint32_t, uint32_t> destinations;
+        for (const RangeAllocator::Move& move : moves) destinations[move.from] = move.to;
+        for (size_t handle = 0; handle < table.allocations.size(); ++handle) {
+            Allocation& allocation = table.allocations[handle];
+            if (!table.live[handle] || allocation.layout != layout || allocation.vertexCount == 0) continue;
+            auto found = destinations.find(allocation.baseVertex);
+            if (found != destinations.end()) allocation.baseVertex = found->second;
+        }
+        moved = true;
+    }
+
+    // 2. The shared indices
+    if (indexBuffer && table.indices.getFragmentation() > threshold) {
+        std::vector<RangeAllocator::Move> moves = table.indices.compact();
+        if (!moves.empty()) {
+            applyMoves(indexBuffer, moves, sizeof(unsigned int), table.indices.getCapacity() * sizeof(unsigned int));
+
+            std::map<uint32_t, uint32_t> destinations;
+            for (const RangeAllocator::Move& move : moves) destinations[move.from] = move.to;
+            for (size_t handle = 0; handle < table.allocations.size(); ++handle) {
+                Allocation& allocation = table.allocations[handle];
+                if (!table.live[handle] || allocation.indexCount == 0) continue;
+                auto found = destinations.find(allocation.firstIndex);
+                if (found != destinations.end()) allocation.firstIndex = found->second;
+            }
+            moved = true;
+        }
+    }
+
+    if (moved) {
+        generation++;
+        defragments++;
+    }
+    return moved;
+}
+
+GeometryPoolStats GeometryPool::getStats() {
+    Storage& table = storage();
+    GeometryPoolStats stats;
+    stats.allocations = static_cast<unsigned int>(table.allocations.size() - table.freeHandles.size());
+    for (const Layout& pool : table.layouts) {
+        if (!pool.vertexArray) continue;
+        unsigned int bytesPerVertex = (pool.stride + 3) * sizeof(float);
+        stats.vertexBytes += pool.vertices.getCapacity() * bytesPerVertex;
+        stats.usedVertexBytes += pool.vertices.getUsed() * bytesPerVertex;
+        stats.freeRanges += static_cast<unsigned int>(pool.vertices.getFreeRangeCount());
+    }
+    stats.indexBytes = table.indices.getCapacity() * sizeof(unsigned int);
+    stats.usedIndexBytes = table.indices.getUsed() * sizeof(unsigned int);
+    stats.freeRanges += static_cast<unsigned int>(table.indices.getFreeRangeCount());
+    stats.grows = grows;
+    stats.defragments = defragments;
+    return stats;
+}
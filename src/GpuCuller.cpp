@@ -0,0 +1,609 @@
+#include "../include/GpuCuller.h"
+#include "../include/RendererComponent.h"
+#include "../include/ShaderBindings.h"
+#include "../include/TransformBuffer.h"
+#include "../include/GLState.h"
+#include "../include/GeometryPool.h"
+#include "../include/Shader.h"
+#include "../include/Frustum.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+namespace {
+
+// One thread per instance: frustum, then Hi-Z, then level of detail, then append
+const char* CullShader = R"(#version 430 core
+layout(local_size_x = 64) in;
+
+struct CullInstance {
+    vec4 sphere;
+    vec4 modelSphere;
+    uint transformSlot;
+    uint group;
+    uint alive;
+    uint materialBits;
+    vec4 lodScreenSizes;
+};
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    uint baseVertex;
+    uint baseInstance;
+};
+
+layout(std430) readonly buffer TransformData { mat4 transforms[]; };
+layout(std430) readonly buffer CullInstances { CullInstance instances[]; };
+layout(std430) readonly buffer CullGroups { uvec2 groups[]; }; // First command, level count
+layout(std430) buffer DrawCommands { DrawCommand commands[]; };
+layout(std430) writeonly buffer VisibleInstances { uint visibleSlots[]; };
+
+uniform int instanceCount;
+uniform vec4 frustumPlanes[6];
+uniform vec3 viewPos;
+uniform float projectionScale; // projection[1][1]; 0 for orthographic cameras or no LODs
+
+uniform int useHiZ;
+uniform sampler2D hiZ;
+uniform int hiZLevels;
+uniform vec2 hiZSize;
+uniform mat4 hiZView;
+uniform mat4 hiZProjection;
+
+// True if the sphere was behind last frame's depth everywhere it covers
+bool occluded(vec3 center, float radius) {
+    vec3 viewCenter = (hiZView * vec4(center, 1.0)).xyz;
+
+    // 1. Screen rectangle of the box around the sphere (the camera looks down -z)
+    vec2 minUV = vec2(1.0);
+    vec2 maxUV = vec2(0.0);
+    for (int i = 0; i < 8; ++i) {
+        vec3 corner = viewCenter + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = hiZProjection * vec4(corner, 1.0);
+        if (clip.w <= 0.0 || clip.z < -clip.w) return false; // Reaches past the near plane
+        vec2 uv = clip.xy / clip.w * 0.5 + 0.5;
+        minUV = min(minUV, uv);
+        maxUV = max(maxUV, uv);
+    }
+    minUV = clamp(minUV, 0.0, 1.0);
+    maxUV = clamp(maxUV, 0.0, 1.0);
+
+    // 2. Depth of the sphere's nearest point
+    vec4 nearestClip = hiZProjection * vec4(viewCenter.xy, viewCenter.z + radius, 1.0);
+    float nearestDepth = nearestClip.z / nearestClip.w * 0.5 + 0.5;
+
+    // 3. The level where the rectangle spans at most 2x2 texels; its 4 corners cover it
+    vec2 size = (maxUV - minUV) * hiZSize;
+    float level = clamp(ceil(log2(max(max(size.x, size.y), 1.0))), 0.0, float(hiZLevels - 1));
+    float farthest = max(max(textureLod(hiZ, minUV, level).r, textureLod(hiZ, vec2(maxUV.x, minUV.y), level).r),
+                         max(textureLod(hiZ, vec2(minUV.x, maxUV.y), level).r, textureLod(hiZ, maxUV, level).r));
+    return nearestDepth > farthest;
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= uint(instanceCount)) return;
+    CullInstance instance = instances[index];
+    if (instance.alive == 0u) return;
+
+    // 1. World sphere (non-uniform scale grows it by the largest axis, like BoundingSphere)
+    mat4 world = transforms[instance.transformSlot];
+    vec3 center = (world * vec4(instance.sphere.xyz, 1.0)).xyz;
+    float scale = sqrt(max(max(dot(world[0].xyz, world[0].xyz), dot(world[1].xyz, world[1].xyz)), dot(world[2].xyz, world[2].xyz)));
+    float radius = instance.sphere.w * scale;
+
+    // 2. Frustum, then last frame's depth
+    for (int p = 0; p < 6; ++p) {
+        if (dot(frustumPlanes[p].xyz, center) + frustumPlanes[p].w < -radius) return;
+    }
+    if (useHiZ != 0 && occluded(center, radius)) return;
+
+    // 3. Level i (from 1) below lodScreenSizes[i - 1], as Renderer::selectLod (without hysteresis)
+    uvec2 group = groups[instance.group];
+    uint lod = 0u;
+    if (projectionScale > 0.0) {
+        vec3 modelCenter = (world * vec4(instance.modelSphere.xyz, 1.0)).xyz;
+        float modelRadius = instance.modelSphere.w * scale;
+        float distance = length(modelCenter - viewPos);
+        float screenSize = distance > modelRadius ? modelRadius * projectionScale / distance : 1e30;
+        while (lod + 1u < group.y && lod < 4u && screenSize < instance.lodScreenSizes[lod]) lod++;
+    }
+
+    // 4. Append the transform slot (and the material, if the shader wants it) to the command's range
+    uint command = group.x + lod;
+    uint slot = atomicAdd(commands[command].instanceCount, 1u);
+    visibleSlots[commands[command].baseInstance + slot] = instance.transformSlot | instance.materialBits;
+}
+)";
+
+// Builds one Hi-Z level: every texel is the farthest depth under it in the level above.
+// Level 0 reads the depth texture (FROM_DEPTH), the others the previous level.
+const char* HiZShader = R"(
+layout(local_size_x = 8, local_size_y = 8) in;
+#ifdef FROM_DEPTH
+uniform sampler2D depthTexture;
+#else
+layout(binding = 0, r32f) readonly uniform image2D source;
+#endif
+layout(binding = 1, r32f) writeonly uniform image2D destination;
+uniform ivec2 sourceSize;
+uniform ivec2 destinationSize;
+
+void main() {
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (texel.x >= destinationSize.x || texel.y >= destinationSize.y) return;
+
+    // The source texels this one covers (2x2 between power-of-two levels, up to 3x3 from the depth)
+    ivec2 begin = texel * sourceSize / destinationSize;
+    ivec2 end = min(((texel + 1) * sourceSize + destinationSize - 1) / destinationSize, sourceSize);
+    float farthest = 0.0;
+    for (int y = begin.y; y < end.y; ++y) {
+        for (int x = begin.x; x < end.x; ++x) {
+#ifdef FROM_DEPTH
+            farthest = max(farthest, texelFetch(depthTexture, ivec2(x, y), 0).r);
+#else
+            farthest = max(farthest, imageLoad(source, ivec2(x, y)).r);
+#endif
+        }
+    }
+    imageStore(destination, texel, vec4(farthest));
+}
+)";
+
+std::shared_ptr<Shader> cullProgram;
+std::shared_ptr<Shader> hiZFromDepthProgram;
+std::shared_ptr<Shader> hiZDownsampleProgram;
+
+uint64_t groupKey(uint32_t mesh, uint32_t material) {
+    return (static_cast<uint64_t>(mesh) << 32) | material;
+}
+
+// Largest power of two not above value
+int floorPowerOfTwo(int value) {
+    int result = 1;
+    while (result * 2 <= value) result *= 2;
+    return result;
+}
+
+}
+
+unsigned int GpuCuller::instanceBuffer = 0;
+unsigned int GpuCuller::groupBuffer = 0;
+unsigned int GpuCuller::commandTemplate = 0;
+unsigned int GpuCuller::commandBuffer = 0;
+unsigned int GpuCuller::visibleBuffer = 0;
+size_t GpuCuller::instanceCapacity = 0;
+size_t GpuCuller::visibleCapacity = 0;
+std::vector<GpuCuller::CullInstance> GpuCuller::instances;
+std::vector<RendererComponent*> GpuCuller::instanceOwners;
+std::vector<int> GpuCuller::freeInstances;
+size_t GpuCuller::liveInstances = 0;
+size_t GpuCuller::dirtyBegin = 0;
+size_t GpuCuller::dirtyEnd = 0;
+std::vector<GpuCuller::DrawGroup> GpuCuller::groups;
+std::unordered_map<uint64_t, uint32_t> GpuCuller::groupIndex;
+std::vector<GpuCuller::DrawGroup> GpuCuller::drawOrder;
+uint32_t GpuCuller::commandCount = 0;
+bool GpuCuller::layoutDirty = false;
+uint32_t GpuCuller::poolGeneration = 0;
+std::vector<RendererComponent*> GpuCuller::fallbackRenderers;
+unsigned int GpuCuller::depthTexture = 0;
+unsigned int GpuCuller::hiZTexture = 0;
+int GpuCuller::depthWidth = 0;
+int GpuCuller::depthHeight = 0;
+int GpuCuller::hiZWidth = 0;
+int GpuCuller::hiZHeight = 0;
+int GpuCuller::hiZLevels = 0;
+bool GpuCuller::hiZValid = false;
+glm::mat4 GpuCuller::hiZView(1.0f);
+glm::mat4 GpuCuller::hiZProjection(1.0f);
+
+bool GpuCuller::init() {
+    if (instanceBuffer) return true;
+
+    // Compute shaders and storage buffers are GL 4.3, and the draws read their
+    // matrices from the TransformBuffer
+    if (!GLAD_GL_VERSION_4_3 || !TransformBuffer::isAvailable()) return false;
+
+    cullProgram = Shader::fromComputeSource(CullShader);
+    hiZFromDepthProgram = Shader::fromComputeSource(std::string("#version 430 core\n#define FROM_DEPTH\n") + HiZShader);
+    hiZDownsampleProgram = Shader::fromComputeSource(std::string("#version 430 core\n") + HiZShader);
+
+    glGenBuffers(1, &instanceBuffer);
+    glGenBuffers(1, &groupBuffer);
+    glGenBuffers(1, &commandTemplate);
+    glGenBuffers(1, &commandBuffer);
+    glGenBuffers(1, &visibleBuffer);
+    return true;
+}
+
+void GpuCuller::sync(bool everything) {
+    if (!instanceBuffer) return;
+
+    if (everything) {
+        RendererComponent::spatialIndex.query(Frustum(), [](void* userData) {
+            refresh(static_cast<RendererComponent*>(userData));
+        });
+        invalidateHiZ();
+    }
+    for (RendererComponent* renderer : RendererComponent::dirtyRenderers) {
+        refresh(renderer);
+    }
+}
+
+void GpuCuller::refresh(RendererComponent* renderer) {
+    // 1. Models are drawn this way if every mesh's shader reads TransformData
+    bool eligible = renderer->model && renderer->owner && renderer->impostorDistance <= 0.0f;
+    if (eligible) {
+        const Model& model = *renderer->model;
+        for (size_t i = 0; i < model.meshes.size(); ++i) {
+            Material* material = i < model.materials.size() ? model.materials[i].get() : nullptr;
+            if (model.meshes[i] && (!material || !material->shader || !material->shader->hasStorageBlock("TransformData"))) {
+                eligible = false;
+            }
+        }
+    }
+
+    // 2. A new model (or a change of path) rebuilds the renderer's instances
+    bool registered = !renderer->gpuInstances.empty() || renderer->gpuFallback;
+    bool changed = !registered || renderer->gpuModel != renderer->model.get() || renderer->gpuFallback == eligible;
+    if (changed) {
+        remove(renderer);
+        if (!renderer->model) return;
+        renderer->gpuModel = renderer->model.get();
+        if (eligible) {
+            addInstances(renderer);
+        } else {
+            renderer->gpuFallback = true;
+            fallbackRenderers.push_back(renderer);
+        }
+    }
+
+    // 3. The pass reads the matrix from the renderer's slot
+    if (!renderer->gpuInstances.empty()) {
+        TransformBuffer::set(renderer->transformSlot, renderer->owner->worldTransform);
+    }
+}
+
+void GpuCuller::addInstances(RendererComponent* renderer) {
+    const Model& model = *renderer->model;
+    if (renderer->transformSlot < 0) {
+        renderer->transformSlot = TransformBuffer::allocate();
+    }
+
+    BoundingSphere modelSphere = model.getBoundingSphere();
+    glm::vec4 lodScreenSizes(0.0f);
+    for (size_t i = 0; i < model.lodSettings.size() && i < 4; ++i) {
+        lodScreenSizes[static_cast<int>(i)] = model.lodSettings[i].screenSize;
+    }
+
+    for (size_t i = 0; i < model.meshes.size(); ++i) {
+        Mesh* mesh = model.meshes[i].get();
+        Material* material = i < model.materials.size() ? model.materials[i].get() : nullptr;
+        if (!mesh || !material) continue;
+
+        // 1. The mesh + material group, created the first time the pair shows up
+        uint64_t key = groupKey(mesh->renderId, material->renderId);
+        auto found = groupIndex.find(key);
+        uint32_t group;
+        if (found == groupIndex.end()) {
+            group = static_cast<uint32_t>(groups.size());
+            groups.push_back({ mesh->renderId, material->renderId, 0, static_cast<uint32_t>(std::min<size_t>(mesh->lods.size(), 4)), 0 });
+            groupIndex.emplace(key, group);
+        } else {
+            group = found->second;
+            // An empty group may still be waiting for layout() to drop it, and its mesh ID may belong
+            // to a different mesh by now
+            if (groups[group].instances == 0) groups[group].lodCount = static_cast<uint32_t>(std::min<size_t>(mesh->lods.size(), 4));
+        }
+        groups[group].instances++;
+        layoutDirty = true;
+
+        // 2. An instance entry, reusing a free one if there is one
+        CullInstance instance;
+        instance.sphere = glm::vec4(mesh->boundingSphere.center, mesh->boundingSphere.radius);
+        instance.modelSphere = glm::vec4(modelSphere.center, modelSphere.radius);
+        instance.transformSlot = static_cast<uint32_t>(renderer->transformSlot);
+        instance.group = group;
+        instance.alive = 1;
+        instance.materialBits = 0;
+        if (material->shader && material->shader->hasUniformBlock("MaterialLayers") && material->materialIndex >= 0) {
+            instance.materialBits = static_cast<uint32_t>(material->materialIndex) << ShaderBindings::TransformIndexBits;
+        }
+        instance.lodScreenSizes = lodScreenSizes;
+
+        size_t index;
+        if (!freeInstances.empty()) {
+            index = freeInstances.back();
+            freeInstances.pop_back();
+            instances[index] = instance;
+            instanceOwners[index] = renderer;
+        } else {
+            index = instances.size();
+            instances.push_back(instance);
+            instanceOwners.push_back(renderer);
+        }
+        renderer->gpuInstances.push_back(static_cast<int>(index));
+        liveInstances++;
+        markDirty(index);
+    }
+}
+
+void GpuCuller::remove(RendererComponent* renderer) {
+    for (int index : renderer->gpuInstances) {
+        groups[instances[index].group].instances--;
+        instances[index].alive = 0;
+        instanceOwners[index] = nullptr;
+        freeInstances.push_back(index);
+        liveInstances--;
+        layoutDirty = true;
+        markDirty(index);
+    }
+    renderer->gpuInstances.clear();
+
+    if (renderer->gpuFallback) {
+        fallbackRenderers.erase(std::remove(fallbackRenderers.begin(), fallbackRenderers.end(), renderer), fallbackRenderers.end());
+        renderer->gpuFallback = false;
+    }
+    renderer->gpuModel = nullptr;
+}
+
+void GpuCuller::markDirty(size_t index) {
+    if (dirtyBegin == dirtyEnd) {
+        dirtyBegin = index;
+        dirtyEnd = index + 1;
+    } else {
+        dirtyBegin = std::min(dirtyBegin, index);
+        dirtyEnd = std::max(dirtyEnd, index + 1);
+    }
+}
+
+void GpuCuller::dropEmptyGroups() {
+    // 1. Keep the groups with instances, in order
+    std::vector<uint32_t> remap(groups.size(), 0);
+    size_t kept = 0;
+    for (size_t i = 0; i < groups.size(); ++i) {
+        if (groups[i].instances == 0) continue;
+        remap[i] = static_cast<uint32_t>(kept);
+        groups[kept++] = groups[i];
+    }
+    if (kept == groups.size()) return;
+    groups.resize(kept);
+
+    groupIndex.clear();
+    for (uint32_t i = 0; i < groups.size(); ++i) {
+        groupIndex.emplace(groupKey(groups[i].mesh, groups[i].material), i);
+    }
+
+    // 2. Point the live instances at their group's new index
+    for (size_t index = 0; index < instances.size(); ++index) {
+        if (!instances[index].alive || instances[index].group == remap[instances[index].group]) continue;
+        instances[index].group = remap[instances[index].group];
+        markDirty(index);
+    }
+}
+
+void GpuCuller::layout() {
+    layoutDirty = false;
+    poolGeneration = GeometryPool::getGeneration();
+    dropEmptyGroups();
+
+    // 1. Each group gets lodCount commands; each command room for every instance of the group
+    std::vector<DrawCommand> commands;
+    uint32_t visible = 0;
+    for (DrawGroup& group : groups) {
+        group.firstCommand = static_cast<uint32_t>(commands.size());
+        const Mesh* mesh = RenderIdTable<Mesh>::get(group.mesh);
+        for (uint32_t lod = 0; lod < group.lodCount; ++lod) {
+            const MeshLod* level = mesh && group.instances > 0 ? &mesh->getLod(static_cast<int>(lod)) : nullptr;
+            DrawCommand command;
+            command.count = level ? static_cast<uint32_t>(level->indexCount) : 0;
+            command.instanceCount = 0;
+            command.firstIndex = level ? mesh->getFirstIndex() + level->firstIndex : 0;
+            command.baseVertex = level ? static_cast<uint32_t>(mesh->getBaseVertex()) : 0;
+            command.baseInstance = visible;
+            commands.push_back(command);
+            visible += group.instances;
+        }
+    }
+    commandCount = static_cast<uint32_t>(commands.size());
+
+    std::vector<glm::uvec2> groupData;
+    for (const DrawGroup& group : groups) groupData.push_back(glm::uvec2(group.firstCommand, group.lodCount));
+
+    // 2. Upload; cull() copies the template over the live commands every frame
+    if (!groupData.empty()) {
+        GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, groupBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, groupData.size() * sizeof(glm::uvec2), groupData.data(), GL_STATIC_DRAW);
+    }
+    if (!commands.empty()) {
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, commandTemplate);
+        glBufferData(GL_COPY_WRITE_BUFFER, commands.size() * sizeof(DrawCommand), commands.data(), GL_STATIC_DRAW);
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, commandBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, commands.size() * sizeof(DrawCommand), nullptr, GL_DYNAMIC_DRAW);
+    }
+    if (visible > visibleCapacity || visibleCapacity == 0) {
+        visibleCapacity = std::max<size_t>(visible, 1024);
+        GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, visibleBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, visibleCapacity * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    // 3. Draw order: by shader, then material, then mesh, so state changes stay few
+    drawOrder.clear();
+    for (const DrawGroup& group : groups) {
+        if (group.instances > 0 && RenderIdTable<Mesh>::get(group.mesh) && RenderIdTable<Material>::get(group.material)) {
+            drawOrder.push_back(group);
+        }
+    }
+    std::sort(drawOrder.begin(), drawOrder.end(), [](const DrawGroup& a, const DrawGroup& b) {
+        const Material* materialA = RenderIdTable<Material>::get(a.material);
+        const Material* materialB = RenderIdTable<Material>::get(b.material);
+        uint32_t shaderA = materialA->shader ? materialA->shader->renderId : 0;
+        uint32_t shaderB = materialB->shader ? materialB->shader->renderId : 0;
+        if (shaderA != shaderB) return shaderA < shaderB;
+        if (a.material != b.material) return a.material < b.material;
+        return a.mesh < b.mesh;
+    });
+}
+
+void GpuCuller::upload() {
+    if (instances.size() > instanceCapacity) {
+        // Grow, and send everything again
+        instanceCapacity = std::max<size_t>(instanceCapacity * 2, 1024);
+        while (instanceCapacity < instances.size()) instanceCapacity *= 2;
+        GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, instanceCapacity * sizeof(CullInstance), nullptr, GL_DYNAMIC_DRAW);
+        dirtyBegin = 0;
+        dirtyEnd = instances.size();
+    }
+    if (dirtyBegin == dirtyEnd) return;
+
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, dirtyBegin * sizeof(CullInstance), (dirtyEnd - dirtyBegin) * sizeof(CullInstance), &instances[dirtyBegin]);
+    dirtyBegin = dirtyEnd = 0;
+}
+
+void GpuCuller::cull(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos, bool selectLods) {
+    if (!instanceBuffer) return;
+
+    // 1. Bring the tables up to date
+    if (layoutDirty || poolGeneration != GeometryPool::getGeneration()) layout();
+    upload();
+    if (commandCount == 0 || instances.empty()) return;
+
+    // 2. Reset every command's instance count
+    GLState::bindBuffer(GL_COPY_READ_BUFFER, commandTemplate);
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, commandBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, commandCount * sizeof(DrawCommand));
+
+    // 3. Cull
+    Shader& shader = *cullProgram;
+    shader.use();
+    Frustum frustum(projection * view);
+    shader.set(shader.getUniform("instanceCount"), static_cast<int>(instances.size()));
+    for (int p = 0; p < Frustum::PlaneCount; ++p) {
+        shader.set(shader.getUniform("frustumPlanes[" + std::to_string(p) + "]"), frustum.planes[p]);
+    }
+    shader.set(shader.getUniform("viewPos"), viewPos);
+    shader.set(shader.getUniform("projectionScale"), selectLods && projection[2][3] != 0.0f ? projection[1][1] : 0.0f);
+
+    shader.set(shader.getUniform("useHiZ"), hiZValid ? 1 : 0);
+    if (hiZValid) {
+        GLState::bindTexture(0, GL_TEXTURE_2D, hiZTexture);
+        shader.set(shader.getUniform("hiZ"), 0);
+        shader.set(shader.getUniform("hiZLevels"), hiZLevels);
+        shader.set(shader.getUniform("hiZSize"), glm::vec2(static_cast<float>(hiZWidth), static_cast<float>(hiZHeight)));
+        shader.set(shader.getUniform("hiZView"), hiZView);
+        shader.set(shader.getUniform("hiZProjection"), hiZProjection);
+    }
+
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, ShaderBindings::CullInstances, instanceBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, ShaderBindings::CullGroups, groupBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, ShaderBindings::DrawCommands, commandBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, ShaderBindings::VisibleInstances, visibleBuffer);
+    glDispatchCompute(static_cast<GLuint>((instances.size() + ThreadsPerGroup - 1) / ThreadsPerGroup), 1, 1);
+
+    // 4. The draws read the results as indirect commands and as an instance attribute
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void GpuCuller::drawGroup(Mesh& mesh, const DrawGroup& group, bool positionsOnly) {
+    // 1. Point the mesh's transform index attribute at this frame's visible slots
+    GLState::bindVertexArray(mesh.getVertexArray(positionsOnly));
+    GLState::bindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+    glVertexAttribIPointer(ShaderBindings::TransformIndexAttribute, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void*)0);
+
+    // 2. One call for every level of detail of the group
+    GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(group.firstCommand * sizeof(DrawCommand)),
+                                static_cast<GLsizei>(group.lodCount), 0);
+
+    // 3. And back at the instance stream, for the CPU path's draws
+    TransformBuffer::bindIndexAttribute(mesh.getVertexArray(positionsOnly));
+}
+
+void GpuCuller::captureDepth(const glm::mat4& view, const glm::mat4& projection) {
+    if (!instanceBuffer) return;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    int width = viewport[2], height = viewport[3];
+    if (width <= 0 || height <= 0) return;
+
+    // 1. (Re)create the textures when the size changes. The Hi-Z is the largest
+    //    power of two that fits, so each level halves exactly.
+    if (width != depthWidth || height != depthHeight) {
+        if (!depthTexture) glGenTextures(1, &depthTexture);
+        GLState::bindTexture(0, GL_TEXTURE_2D, depthTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+        hiZWidth = floorPowerOfTwo(width);
+        hiZHeight = floorPowerOfTwo(height);
+        hiZLevels = 1;
+        while ((hiZWidth >> hiZLevels) > 0 || (hiZHeight >> hiZLevels) > 0) hiZLevels++;
+
+        // Immutable storage, so every level can be bound as an image
+        if (hiZTexture) glDeleteTextures(1, &hiZTexture);
+        glGenTextures(1, &hiZTexture);
+        GLState::invalidate(); // The old name may come back from glGenTextures
+        GLState::bindTexture(0, GL_TEXTURE_2D, hiZTexture);
+        glTexStorage2D(GL_TEXTURE_2D, hiZLevels, GL_R32F, hiZWidth, hiZHeight);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        depthWidth = width;
+        depthHeight = height;
+    }
+
+    // 2. Copy the frame's depth out of the default framebuffer
+    GLState::bindTexture(0, GL_TEXTURE_2D, depthTexture);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, viewport[0], viewport[1], width, height);
+
+    // 3. Level 0 from the depth, then every level from the one above it
+    int sourceWidth = width, sourceHeight = height;
+    for (int level = 0; level < hiZLevels; ++level) {
+        int levelWidth = std::max(hiZWidth >> level, 1);
+        int levelHeight = std::max(hiZHeight >> level, 1);
+
+        Shader& shader = level == 0 ? *hiZFromDepthProgram : *hiZDownsampleProgram;
+        shader.use();
+        if (level == 0) {
+            shader.set(shader.getUniform("depthTexture"), 0);
+        } else {
+            glBindImageTexture(0, hiZTexture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        }
+        glBindImageTexture(1, hiZTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        shader.set(shader.getUniform("sourceSize"), glm::ivec2(sourceWidth, sourceHeight));
+        shader.set(shader.getUniform("destinationSize"), glm::ivec2(levelWidth, levelHeight));
+        glDispatchCompute((levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        sourceWidth = levelWidth;
+        sourceHeight = levelHeight;
+    }
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    hiZView = view;
+    hiZProjection = projection;
+    hiZValid = true;
+}
+
+unsigned int GpuCuller::readVisibleCount() {
+    if (!instanceBuffer || commandCount == 0) return 0;
+
+    std::vector<DrawCommand> commands(commandCount);
+    GLState::bindBuffer(GL_COPY_READ_BUFFER, commandBuffer);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, commandCount * sizeof(DrawCommand), commands.data());
+
+    unsigned int visible = 0;
+    for (const DrawCommand& command : commands) visible += command.instanceCount;
+    return visible;
+}
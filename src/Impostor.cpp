@@ -0,0 +1,258 @@
+#include "../include/Impostor.h"
+#include "../include/Model.h"
+#include "../include/GLState.h"
+#include <glad/glad.h>
+#include <glm/glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+// Shared by the bake and draw shaders: the octahedral mapping between a unit direction
+// and a point in [-1, 1]^2 (the upper half of the sphere in the middle diamond, the lower
+// half folded into the corners), with y as the up axis
+const char* OctahedralGLSL = R"(
+vec2 octEncode(vec3 d) {
+    d /= abs(d.x) + abs(d.y) + abs(d.z);
+    vec2 e = d.xz;
+    if (d.y < 0.0) e = (1.0 - abs(d.zx)) * vec2(d.x >= 0.0 ? 1.0 : -1.0, d.z >= 0.0 ? 1.0 : -1.0);
+    return e;
+}
+vec3 octDecode(vec2 e) {
+    vec3 d = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+    if (d.y < 0.0) d.xz = (1.0 - abs(d.zx)) * vec2(d.x >= 0.0 ? 1.0 : -1.0, d.z >= 0.0 ? 1.0 : -1.0);
+    return normalize(d);
+}
+)";
+
+// Bakes one frame: the model's diffuse color with fixed lighting from above
+const char* BakeVertexShader = R"(#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+uniform mat4 viewProjection;
+out vec3 vNormal;
+out vec2 vTexCoords;
+void main() {
+    vNormal = aNormal;
+    vTexCoords = aTexCoords;
+    gl_Position = viewProjection * vec4(aPos, 1.0);
+}
+)";
+
+const char* BakeFragmentShader = R"(#version 330 core
+in vec3 vNormal;
+in vec2 vTexCoords;
+uniform sampler2D diffuseMap;
+uniform int hasDiffuse;
+uniform vec2 textureScale;
+out vec4 FragColor;
+void main() {
+    vec3 albedo = hasDiffuse != 0 ? texture(diffuseMap, vTexCoords * textureScale).rgb : vec3(0.8);
+    float normalLength = length(vNormal);
+    float light = normalLength > 0.0 ? max(dot(vNormal / normalLength, normalize(vec3(0.3, 1.0, 0.5))), 0.0) : 1.0;
+    FragColor = vec4(albedo * (0.35 + 0.65 * light), 1.0);
+}
+)";
+
+// One quad per instance, showing the frame baked closest to the camera's direction
+const char* DrawVertexShaderMain = R"(
+layout (location = 0) in vec2 aCorner;
+layout (location = 1) in vec4 aCenterRadius;
+layout (location = 2) in vec4 aAxisX;
+layout (location = 3) in vec4 aAxisY;
+layout (location = 4) in vec4 aAxisZ;
+uniform mat4 viewProjection;
+uniform vec3 viewPos;
+uniform float framesPerSide;
+out vec2 vTexCoords;
+void main() {
+    vec3 center = aCenterRadius.xyz;
+    mat3 rotation = mat3(aAxisX.xyz, aAxisY.xyz, aAxisZ.xyz);
+
+    // 1. Direction to the camera in the model's own space picks the frame
+    vec3 localDir = transpose(rotation) * normalize(viewPos - center);
+    vec2 grid = (octEncode(localDir) * 0.5 + 0.5) * framesPerSide;
+    vec2 cell = clamp(floor(grid), vec2(0.0), vec2(framesPerSide - 1.0));
+
+    // 2. The quad uses the same basis that frame was baked with, turned into world space
+    vec3 frameDir = octDecode((cell + 0.5) / framesPerSide * 2.0 - 1.0);
+    vec3 up = abs(frameDir.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(up, frameDir));
+    up = cross(frameDir, right);
+    vec3 worldPos = center + rotation * (right * aCorner.x + up * aCorner.y) * aCenterRadius.w;
+
+    gl_Position = viewProjection * vec4(worldPos, 1.0);
+    vTexCoords = (cell + aCorner * 0.5 + 0.5) / framesPerSide;
+}
+)";
+
+const char* DrawFragmentShader = R"(#version 330 core
+in vec2 vTexCoords;
+uniform sampler2D atlas;
+out vec4 FragColor;
+void main() {
+    vec4 color = texture(atlas, vTexCoords);
+    if (color.a < 0.5) discard;
+    FragColor = vec4(color.rgb, 1.0);
+}
+)";
+
+// GL objects shared by every impostor, created on first use
+std::shared_ptr<Shader> bakeShader;
+std::shared_ptr<Shader> drawShader;
+unsigned int quadVAO = 0, quadVBO = 0, instanceVBO = 0;
+
+void initShared() {
+    if (drawShader) return;
+
+    bakeShader = Shader::fromSource(BakeVertexShader, BakeFragmentShader);
+    drawShader = Shader::fromSource(std::string("#version 330 core\n") + OctahedralGLSL + DrawVertexShaderMain, DrawFragmentShader);
+
+    // A unit quad as a triangle strip, plus a stream of Impostor::Instance per quad
+    const float corners[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+    glGenVertexArrays(1, &quadVAO);
+    glGenBuffers(1, &quadVBO);
+    glGenBuffers(1, &instanceVBO);
+
+    GLState::bindVertexArray(quadVAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    GLState::bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    for (int i = 0; i < 4; ++i) {
+        glEnableVertexAttribArray(1 + i);
+        glVertexAttribDivisor(1 + i, 1);
+    }
+}
+
+glm::vec3 octDecode(glm::vec2 e) {
+    glm::vec3 d(e.x, 1.0f - std::abs(e.x) - std::abs(e.y), e.y);
+    if (d.y < 0.0f) {
+        glm::vec2 folded((1.0f - std::abs(d.z)) * (d.x >= 0.0f ? 1.0f : -1.0f),
+                         (1.0f - std::abs(d.x)) * (d.z >= 0.0f ? 1.0f : -1.0f));
+        d.x = folded.x;
+        d.z = folded.y;
+    }
+    return glm::normalize(d);
+}
+
+}
+
+std::shared_ptr<Impostor> Impostor::bake(const Model& model, int framesPerSide, int frameSize) {
+    BoundingSphere sphere = model.getBoundingSphere();
+    if (model.meshes.empty() || sphere.radius <= 0.0f || framesPerSide <= 0 || frameSize <= 0) return nullptr;
+    initShared();
+
+    std::shared_ptr<Impostor> impostor(new Impostor());
+    impostor->framesPerSide = framesPerSide;
+    impostor->frameSize = frameSize;
+    impostor->bounds = sphere;
+    int atlasSize = framesPerSide * frameSize;
+
+    // 1. The atlas. Mip levels stop while a frame is still a few texels wide,
+    //    so frames don't bleed into each other at a distance.
+    int maxLevel = std::max(0, static_cast<int>(std::log2(static_cast<float>(frameSize))) - 2);
+    glGenTextures(1, &impostor->atlas);
+    GLState::bindTexture(0, GL_TEXTURE_2D, impostor->atlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasSize, atlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+
+    // 2. Render into it offscreen, remembering where the frame was being drawn
+    GLint previousFramebuffer = 0;
+    GLint viewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    unsigned int framebuffer, depthBuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, impostor->atlas, 0);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, atlasSize, atlasSize);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (complete) {
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        bakeShader->use();
+        UniformHandle viewProjectionHandle = bakeShader->getUniform("viewProjection");
+        UniformHandle hasDiffuseHandle = bakeShader->getUniform("hasDiffuse");
+        UniformHandle textureScaleHandle = bakeShader->getUniform("textureScale");
+        bakeShader->set(bakeShader->getUniform("diffuseMap"), 0);
+
+        // 3. One orthographic view per cell, looking at the sphere from the cell's direction
+        float radius = sphere.radius;
+        glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, radius * 0.5f, radius * 3.5f);
+        for (int y = 0; y < framesPerSide; ++y) {
+            for (int x = 0; x < framesPerSide; ++x) {
+                glm::vec2 cell = (glm::vec2(x, y) + 0.5f) / static_cast<float>(framesPerSide) * 2.0f - 1.0f;
+                glm::vec3 direction = octDecode(cell);
+                glm::vec3 up = std::abs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                glm::mat4 view = glm::lookAt(sphere.center + direction * radius * 2.0f, sphere.center, up);
+
+                glViewport(x * frameSize, y * frameSize, frameSize, frameSize);
+                bakeShader->set(viewProjectionHandle, projection * view);
+
+                for (size_t i = 0; i < model.meshes.size(); ++i) {
+                    Mesh* mesh = model.meshes[i].get();
+                    Material* material = i < model.materials.size() ? model.materials[i].get() : nullptr;
+                    if (!mesh) continue;
+
+                    bool hasDiffuse = material && material->diffuseMap;
+                    if (hasDiffuse) GLState::bindTexture(0, GL_TEXTURE_2D, material->diffuseMap->ID);
+                    bakeShader->set(hasDiffuseHandle, hasDiffuse ? 1 : 0);
+                    bakeShader->set(textureScaleHandle, material ? material->textureScale : glm::vec2(1.0f));
+                    mesh->draw(0);
+                }
+            }
+        }
+
+        GLState::bindTexture(0, GL_TEXTURE_2D, impostor->atlas);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    } else {
+        std::cout << "Error: impostor framebuffer is incomplete, the model keeps drawing its meshes." << std::endl;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+
+    if (!complete) return nullptr;
+    return impostor;
+}
+
+void Impostor::drawInstances(const std::vector<Instance>& instances, size_t first, size_t count,
+                             const glm::mat4& viewProjection, const glm::vec3& viewPos) const {
+    if (count == 0) return;
+    initShared();
+
+    // 1. This group's quads go into a fresh copy of the instance stream
+    GLState::bindVertexArray(quadVAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(Instance), &instances[first], GL_STREAM_DRAW);
+    for (int i = 0; i < 4; ++i) {
+        glVertexAttribPointer(1 + i, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(i * sizeof(glm::vec4)));
+    }
+
+    // 2. One draw for all of them
+    drawShader->use();
+    drawShader->set(drawShader->getUniform("viewProjection"), viewProjection);
+    drawShader->set(drawShader->getUniform("viewPos"), viewPos);
+    drawShader->set(drawShader->getUniform("framesPerSide"), static_cast<float>(framesPerSide));
+    drawShader->set(drawShader->getUniform("atlas"), 0);
+    GLState::bindTexture(0, GL_TEXTURE_2D, atlas);
+
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(count));
+}
@@ -0,0 +1,115 @@
+#include "../include/JobSystem.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Pool {
+    std::mutex callMutex; // One parallelFor at a time
+
+    std::mutex mutex;
+    std::condition_variable wake;     // Workers wait here for a new generation
+    std::condition_variable finished; // The caller waits here for the last job
+    unsigned int generation = 0;
+    unsigned int busyWorkers = 0;     // Workers still inside the current generation
+
+    const std::function<void(size_t, unsigned int)>* job = nullptr;
+    size_t count = 0;
+    std::atomic<size_t> next{0};
+
+    unsigned int threadCount = 1;
+    std::atomic<unsigned int> activeThreads{1}; // Of those, the ones taking jobs (see setThreadLimit)
+};
+
+// Takes indices until none are left
+void runJobs(Pool& pool, unsigned int thread) {
+    size_t count = pool.count;
+    const auto& job = *pool.job;
+    for (size_t index = pool.next.fetch_add(1); index < count; index = pool.next.fetch_add(1)) {
+        job(index, thread);
+    }
+}
+
+void workerLoop(Pool* pool, unsigned int thread) {
+    unsigned int seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->wake.wait(lock, [&] { return pool->generation != seen; });
+            seen = pool->generation;
+        }
+
+        if (thread < pool->activeThreads) runJobs(*pool, thread);
+
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if (--pool->busyWorkers == 0) pool->finished.notify_one();
+    }
+}
+
+// Never destroyed, so workers still asleep at exit don't touch freed memory
+Pool& pool() {
+    static Pool* instance = [] {
+        Pool* created = new Pool();
+        unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+        created->threadCount = std::min(hardware, 16u);
+        created->activeThreads = created->threadCount;
+        for (unsigned int thread = 1; thread < created->threadCount; ++thread) {
+            std::thread(workerLoop, created, thread).detach();
+        }
+        return created;
+    }();
+    return *instance;
+}
+
+}
+
+unsigned int JobSystem::getThreadCount() {
+    return pool().threadCount;
+}
+
+void JobSystem::setThreadLimit(unsigned int threads) {
+    Pool& p = pool();
+    std::lock_guard<std::mutex> call(p.callMutex);
+    p.activeThreads = threads == 0 ? p.threadCount : std::min(threads, p.threadCount);
+}
+
+unsigned int JobSystem::getThreadLimit() {
+    return pool().activeThreads;
+}
+
+void JobSystem::parallelFor(size_t count, const std::function<void(size_t index, unsigned int thread)>& job) {
+    if (count == 0) return;
+    Pool& p = pool();
+
+    // Taken before the serial path too: it runs as thread 0, whose scratch another call may be using
+    std::lock_guard<std::mutex> call(p.callMutex);
+
+    // Not worth waking anyone for a single job
+    if (count == 1 || p.activeThreads == 1) {
+        for (size_t index = 0; index < count; ++index) job(index, 0);
+        return;
+    }
+
+    // 1. Publish the loop and wake the workers
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        p.job = &job;
+        p.count = count;
+        p.next = 0;
+        p.busyWorkers = p.threadCount - 1;
+        p.generation++;
+    }
+    p.wake.notify_all();
+
+    // 2. Help out
+    runJobs(p, 0);
+
+    // 3. Wait until every worker has left this loop, so none of them can pick up
+    //    an index of the next call with this call's job
+    std::unique_lock<std::mutex> lock(p.mutex);
+    p.finished.wait(lock, [&] { return p.busyWorkers == 0; });
+}
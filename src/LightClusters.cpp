@@ -0,0 +1,104 @@
+#include "../include/LightClusters.h"
+#include "../include/JobSystem.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+float LightClusters::lightRange(const glm::vec3& color, float intensity, float constant, float linear, float quadratic) {
+    // Solve intensity * brightest / (constant + linear d + quadratic d^2) = Cutoff for d
+    float brightest = std::max(color.r, std::max(color.g, color.b));
+    float reach = intensity * brightest / Cutoff;
+    if (reach <= constant) return 0.0f;
+    if (quadratic > 0.0f) {
+        float discriminant = linear * linear - 4.0f * quadratic * (constant - reach);
+        return (-linear + std::sqrt(discriminant)) / (2.0f * quadratic);
+    }
+    if (linear > 0.0f) return (reach - constant) / linear;
+    return FLT_MAX; // Never fades
+}
+
+void LightClusters::build(const std::vector<ClusterLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+                          float nearPlane, float farPlane, int width, int height) {
+    // 1. Slice boundaries, spaced exponentially between the near and far planes
+    float logRatio = std::log(farPlane / nearPlane);
+    for (int s = 0; s <= Slices; ++s) {
+        m_sliceDepth[s] = nearPlane * std::exp(logRatio * s / Slices);
+    }
+    m_header.gridSize = glm::uvec4(TilesX, TilesY, Slices, static_cast<uint32_t>(lights.size()));
+    m_header.depthParams = glm::vec4(Slices / logRatio, Slices * std::log(nearPlane) / logRatio, 0.0f, 0.0f);
+    m_header.tileSize = glm::vec4(static_cast<float>(width) / TilesX, static_cast<float>(height) / TilesY, 0.0f, 0.0f);
+
+    // 2. Every light in view space once, with depth as a positive distance
+    m_viewLights.resize(lights.size());
+    for (size_t i = 0; i < lights.size(); ++i) {
+        glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(lights[i].positionRange), 1.0f));
+        m_viewLights[i] = glm::vec4(center.x, center.y, -center.z, lights[i].positionRange.w);
+    }
+
+    // 3. One job per slice: each light that reaches the slice goes into the tiles
+    //    its box covers there. NDC x of a view point is x * P00 / depth - P20.
+    float scaleX = projection[0][0], offsetX = projection[2][0];
+    float scaleY = projection[1][1], offsetY = projection[2][1];
+    JobSystem::parallelFor(Slices, [&](size_t slice, unsigned int) {
+        std::vector<uint32_t>* tiles = &m_tileLists[slice * TilesX * TilesY];
+        for (int t = 0; t < TilesX * TilesY; ++t) tiles[t].clear();
+
+        // A little overlap, so a fragment the shader rounds into the neighbouring slice still finds its lights
+        float sliceNear = m_sliceDepth[slice] * 0.999f;
+        float sliceFar = m_sliceDepth[slice + 1] * 1.001f;
+        for (size_t i = 0; i < m_viewLights.size(); ++i) {
+            const glm::vec4& light = m_viewLights[i];
+            float range = light.w;
+            if (range <= 0.0f || light.z + range < sliceNear || light.z - range > sliceFar) continue;
+
+            // a. The part of the light's box inside the slice; the rectangle is widest at one of its depths
+            float depths[2] = { std::max(light.z - range, sliceNear), std::min(light.z + range, sliceFar) };
+            float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+            for (float depth : depths) {
+                float inverse = 1.0f / depth;
+                float x0 = (light.x - range) * scaleX * inverse - offsetX;
+                float x1 = (light.x + range) * scaleX * inverse - offsetX;
+                float y0 = (light.y - range) * scaleY * inverse - offsetY;
+                float y1 = (light.y + range) * scaleY * inverse - offsetY;
+                minX = std::min(minX, x0); maxX = std::max(maxX, x1);
+                minY = std::min(minY, y0); maxY = std::max(maxY, y1);
+            }
+            if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f) continue;
+
+            // b. NDC to tiles (row 0 at the bottom, like gl_FragCoord)
+            int tileX0 = std::max(0, static_cast<int>((minX * 0.5f + 0.5f) * TilesX));
+            int tileX1 = std::min(TilesX - 1, static_cast<int>((maxX * 0.5f + 0.5f) * TilesX));
+            int tileY0 = std::max(0, static_cast<int>((minY * 0.5f + 0.5f) * TilesY));
+            int tileY1 = std::min(TilesY - 1, static_cast<int>((maxY * 0.5f + 0.5f) * TilesY));
+            for (int y = tileY0; y <= tileY1; ++y) {
+                for (int x = tileX0; x <= tileX1; ++x) {
+                    tiles[y * TilesX + x].push_back(static_cast<uint32_t>(i));
+                }
+            }
+        }
+    });
+
+    // 4. Flatten the lists into one index array, in cluster order
+    m_indices.clear();
+    m_maxPerCluster = 0;
+    for (int c = 0; c < ClusterCount; ++c) {
+        const std::vector<uint32_t>& list = m_tileLists[c];
+        m_clusters[c] = glm::uvec2(static_cast<uint32_t>(m_indices.size()), static_cast<uint32_t>(list.size()));
+        m_indices.insert(m_indices.end(), list.begin(), list.end());
+        m_maxPerCluster = std::max(m_maxPerCluster, static_cast<uint32_t>(list.size()));
+    }
+}
+
+int LightClusters::clusterAt(const glm::vec3& viewPosition, const glm::mat4& projection) const {
+    float depth = -viewPosition.z;
+    if (depth < m_sliceDepth[0] || depth >= m_sliceDepth[Slices]) return -1;
+
+    int slice = std::min(Slices - 1, std::max(0, static_cast<int>(std::log(depth) * m_header.depthParams.x - m_header.depthParams.y)));
+    float ndcX = viewPosition.x * projection[0][0] / depth - projection[2][0];
+    float ndcY = viewPosition.y * projection[1][1] / depth - projection[2][1];
+    if (ndcX < -1.0f || ndcX >= 1.0f || ndcY < -1.0f || ndcY >= 1.0f) return -1;
+
+    int x = static_cast<int>((ndcX * 0.5f + 0.5f) * TilesX);
+    int y = static_cast<int>((ndcY * 0.5f + 0.5f) * TilesY);
+    return (slice * TilesY + y) * TilesX + x;
+}
@@ -0,0 +1,79 @@
+#include "../include/MaterialTable.h"
+#include "../include/ShaderBindings.h"
+#include "../include/GLState.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstring>
+
+unsigned int MaterialTable::ubo = 0;
+unsigned int MaterialTable::layersUbo = 0;
+unsigned int MaterialTable::uploads = 0;
+
+void MaterialTable::init() {
+    if (ubo) return;
+
+    glGenBuffers(1, &ubo);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(MaterialParams) * Capacity, nullptr, GL_DYNAMIC_DRAW);
+    GLState::bindBufferBase(GL_UNIFORM_BUFFER, ShaderBindings::MaterialData, ubo);
+
+    // 4 KB more for the texture array layers
+    glGenBuffers(1, &layersUbo);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, layersUbo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::ivec4) * Capacity, nullptr, GL_DYNAMIC_DRAW);
+    GLState::bindBufferBase(GL_UNIFORM_BUFFER, ShaderBindings::MaterialLayers, layersUbo);
+
+    // Anything written before the buffers existed has to go up again
+    Storage& table = storage();
+    std::fill(table.valid.begin(), table.valid.end(), false);
+    std::fill(table.layersValid.begin(), table.layersValid.end(), false);
+}
+
+int MaterialTable::allocate() {
+    Storage& table = storage();
+    if (!table.freeSlots.empty()) {
+        int index = table.freeSlots.back();
+        table.freeSlots.pop_back();
+        return index;
+    }
+    if (table.nextSlot < Capacity) {
+        return table.nextSlot++;
+    }
+    return -1;
+}
+
+void MaterialTable::release(int index) {
+    if (index < 0 || index >= Capacity) return;
+    Storage& table = storage();
+    table.valid[index] = false;
+    table.layersValid[index] = false;
+    table.freeSlots.push_back(index);
+}
+
+bool MaterialTable::update(int index, const MaterialParams& params) {
+    if (!ubo || index < 0 || index >= Capacity) return false;
+    Storage& table = storage();
+    if (table.valid[index] && std::memcmp(&table.shadow[index], &params, sizeof(MaterialParams)) == 0) return false;
+
+    table.shadow[index] = params;
+    table.valid[index] = true;
+
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(MaterialParams) * index, sizeof(MaterialParams), &params);
+    uploads++;
+    return true;
+}
+
+bool MaterialTable::updateLayers(int index, const glm::ivec4& layers) {
+    if (!layersUbo || index < 0 || index >= Capacity) return false;
+    Storage& table = storage();
+    if (table.layersValid[index] && table.layerShadow[index] == layers) return false;
+
+    table.layerShadow[index] = layers;
+    table.layersValid[index] = true;
+
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, layersUbo);
+    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::ivec4) * index, sizeof(glm::ivec4), &layers);
+    uploads++;
+    return true;
+}
@@ -0,0 +1,263 @@
+#include "../include/MeshSimplifier.h"
+#include <glm/glm/glm.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// Sum of squared distances to a set of planes, as a symmetric 4x4 matrix (10 unique values)
+struct Quadric {
+    double a2 = 0, ab = 0, ac = 0, ad = 0;
+    double b2 = 0, bc = 0, bd = 0;
+    double c2 = 0, cd = 0;
+    double d2 = 0;
+    double weight = 0;
+
+    void addPlane(const glm::dvec3& normal, double d, double w) {
+        a2 += w * normal.x * normal.x; ab += w * normal.x * normal.y; ac += w * normal.x * normal.z; ad += w * normal.x * d;
+        b2 += w * normal.y * normal.y; bc += w * normal.y * normal.z; bd += w * normal.y * d;
+        c2 += w * normal.z * normal.z; cd += w * normal.z * d;
+        d2 += w * d * d;
+        weight += w;
+    }
+
+    void add(const Quadric& q) {
+        a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+        b2 += q.b2; bc += q.bc; bd += q.bd;
+        c2 += q.c2; cd += q.cd;
+        d2 += q.d2;
+        weight += q.weight;
+    }
+
+    // Average squared distance from p to the planes
+    double evaluate(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double sum = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                   + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                   + c2 * z * z + 2 * cd * z
+                   + d2;
+        return weight > 0 ? std::fabs(sum) / weight : 0.0;
+    }
+};
+
+struct Collapse {
+    unsigned int from;
+    unsigned int to;
+    double cost;
+};
+
+struct PositionKey {
+    uint32_t x, y, z;
+    bool operator==(const PositionKey& other) const { return x == other.x && y == other.y && z == other.z; }
+};
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey& key) const {
+        return (key.x * 73856093u) ^ (key.y * 19349663u) ^ (key.z * 83492791u);
+    }
+};
+
+uint64_t edgeKey(unsigned int a, unsigned int b) {
+    if (a > b) std::swap(a, b);
+    return (static_cast<uint64_t>(a) << 32) | b;
+}
+
+}
+
+std::vector<unsigned int> MeshSimplifier::simplify(const std::vector<float>& vertices, int stride,
+                                                   const std::vector<unsigned int>& indices,
+                                                   size_t targetIndexCount, float* error) {
+    std::vector<unsigned int> result = indices;
+    if (error) *error = 0.0f;
+    if (stride < 3 || indices.size() < 3 || result.size() <= targetIndexCount) return result;
+
+    size_t vertexCount = vertices.size() / stride;
+    auto position = [&](unsigned int v) {
+        return glm::vec3(vertices[v * stride], vertices[v * stride + 1], vertices[v * stride + 2]);
+    };
+
+    // 1. Vertices that share a position (split by UVs or normals) form one group.
+    //    Moving one copy and not the others would tear the surface, so seams are locked.
+    std::vector<unsigned int> positionGroup(vertexCount);
+    std::vector<unsigned int> groupSize(vertexCount, 0);
+    {
+        std::unordered_map<PositionKey, unsigned int, PositionKeyHash> firstWithPosition;
+        firstWithPosition.reserve(vertexCount);
+        for (unsigned int v = 0; v < vertexCount; ++v) {
+            PositionKey key;
+            std::memcpy(&key.x, &vertices[v * stride + 0], sizeof(float));
+            std::memcpy(&key.y, &vertices[v * stride + 1], sizeof(float));
+            std::memcpy(&key.z, &vertices[v * stride + 2], sizeof(float));
+            positionGroup[v] = firstWithPosition.emplace(key, v).first->second;
+            groupSize[positionGroup[v]]++;
+        }
+    }
+
+    std::vector<uint8_t> locked(vertexCount, 0);
+    for (unsigned int v = 0; v < vertexCount; ++v) {
+        if (groupSize[positionGroup[v]] > 1) locked[v] = 1;
+    }
+
+    // 2. Edges used by only one triangle are open borders; their vertices are locked too
+    {
+        std::unordered_map<uint64_t, int> edgeUses;
+        edgeUses.reserve(indices.size());
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            for (int e = 0; e < 3; ++e) {
+                unsigned int a = positionGroup[indices[i + e]];
+                unsigned int b = positionGroup[indices[i + (e + 1) % 3]];
+                edgeUses[edgeKey(a, b)]++;
+            }
+        }
+        std::vector<uint8_t> borderGroup(vertexCount, 0);
+        for (const auto& edge : edgeUses) {
+            if (edge.second != 1) continue;
+            borderGroup[static_cast<unsigned int>(edge.first >> 32)] = 1;
+            borderGroup[static_cast<unsigned int>(edge.first & 0xFFFFFFFFu)] = 1;
+        }
+        for (unsigned int v = 0; v < vertexCount; ++v) {
+            if (borderGroup[positionGroup[v]]) locked[v] = 1;
+        }
+    }
+
+    // 3. Every vertex starts with the planes of the triangles around it, weighted by area
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        glm::dvec3 p0 = position(indices[i]), p1 = position(indices[i + 1]), p2 = position(indices[i + 2]);
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(normal);
+        if (length <= 0.0) continue;
+        normal /= length;
+        double area = length * 0.5;
+        double d = -glm::dot(normal, p0);
+        for (int k = 0; k < 3; ++k) quadrics[indices[i + k]].addPlane(normal, d, area);
+    }
+
+    // 4. Collapse in passes. Each pass takes the cheapest collapses that don't touch each other,
+    //    then rewrites the index list, until the target is reached or nothing cheap is left.
+    std::vector<unsigned int> collapseTo(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<unsigned int> adjacencyStart(vertexCount + 1);
+    std::vector<unsigned int> adjacency;
+    std::vector<Collapse> candidates;
+    std::vector<double> bestCost(vertexCount);
+    std::vector<unsigned int> bestTarget(vertexCount);
+    double maxError = 0.0;
+
+    // Collapses that move the surface by more than this (5% of the mesh size) are never taken
+    glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+    for (unsigned int v = 0; v < vertexCount; ++v) {
+        boundsMin = glm::min(boundsMin, position(v));
+        boundsMax = glm::max(boundsMax, position(v));
+    }
+    double errorLimit = 0.05 * glm::length(boundsMax - boundsMin);
+    errorLimit *= errorLimit;
+
+    const int MaxPasses = 64;
+    for (int pass = 0; pass < MaxPasses && result.size() > targetIndexCount; ++pass) {
+        size_t triangleCount = result.size() / 3;
+
+        // Triangles around each vertex (compressed rows)
+        std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+        for (unsigned int index : result) adjacencyStart[index + 1]++;
+        for (size_t v = 0; v < vertexCount; ++v) adjacencyStart[v + 1] += adjacencyStart[v];
+        adjacency.resize(result.size());
+        {
+            std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+            for (size_t t = 0; t < triangleCount; ++t) {
+                for (int k = 0; k < 3; ++k) adjacency[fill[result[t * 3 + k]]++] = static_cast<unsigned int>(t);
+            }
+        }
+
+        // Cheapest target for every movable vertex. A target must have a single copy of its
+        // position, otherwise the triangles folded onto it could pick up the wrong UVs.
+        std::fill(bestCost.begin(), bestCost.end(), -1.0);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            for (int k = 0; k < 3; ++k) {
+                unsigned int from = result[t * 3 + k];
+                if (locked[from]) continue;
+                for (int j = 1; j < 3; ++j) {
+                    unsigned int to = result[t * 3 + (k + j) % 3];
+                    if (to == from || groupSize[positionGroup[to]] > 1) continue;
+                    double cost = quadrics[from].evaluate(position(to));
+                    if (bestCost[from] < 0.0 || cost < bestCost[from]) {
+                        bestCost[from] = cost;
+                        bestTarget[from] = to;
+                    }
+                }
+            }
+        }
+
+        candidates.clear();
+        for (unsigned int v = 0; v < vertexCount; ++v) {
+            if (bestCost[v] >= 0.0) candidates.push_back({ v, bestTarget[v], bestCost[v] });
+        }
+        if (candidates.empty()) break;
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+        for (unsigned int v = 0; v < vertexCount; ++v) collapseTo[v] = v;
+        std::fill(touched.begin(), touched.end(), 0);
+
+        size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+        size_t trianglesRemoved = 0;
+        bool collapsed = false;
+
+        for (const Collapse& collapse : candidates) {
+            if (trianglesRemoved >= trianglesToRemove || collapse.cost > errorLimit) break;
+            if (touched[collapse.from] || touched[collapse.to]) continue;
+
+            // Reject collapses that would flip a remaining triangle around the moved vertex
+            glm::vec3 target = position(collapse.to);
+            bool flips = false;
+            size_t removes = 0;
+            for (unsigned int a = adjacencyStart[collapse.from]; a < adjacencyStart[collapse.from + 1] && !flips; ++a) {
+                const unsigned int* tri = &result[adjacency[a] * 3];
+                if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to) {
+                    removes++;
+                    continue;
+                }
+                glm::vec3 before[3], after[3];
+                for (int k = 0; k < 3; ++k) {
+                    before[k] = position(tri[k]);
+                    after[k] = tri[k] == collapse.from ? target : before[k];
+                }
+                glm::vec3 oldNormal = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 newNormal = glm::cross(after[1] - after[0], after[2] - after[0]);
+                if (glm::dot(oldNormal, newNormal) <= 0.0f) flips = true;
+            }
+            if (flips || removes == 0) continue;
+
+            collapseTo[collapse.from] = collapse.to;
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            maxError = std::max(maxError, collapse.cost);
+            trianglesRemoved += removes;
+            collapsed = true;
+
+            // Everything sharing a triangle with the moved vertex waits for the next pass,
+            // so the flip test above always sees up-to-date triangles
+            for (unsigned int a = adjacencyStart[collapse.from]; a < adjacencyStart[collapse.from + 1]; ++a) {
+                const unsigned int* tri = &result[adjacency[a] * 3];
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+            }
+        }
+        if (!collapsed) break;
+
+        // Rewrite the triangles and drop the ones that collapsed to a line
+        size_t write = 0;
+        for (size_t i = 0; i + 2 < result.size(); i += 3) {
+            unsigned int a = collapseTo[result[i]], b = collapseTo[result[i + 1]], c = collapseTo[result[i + 2]];
+            if (a == b || b == c || a == c) continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    if (error) *error = static_cast<float>(std::sqrt(maxError));
+    return result;
+}
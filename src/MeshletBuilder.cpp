@@ -0,0 +1,199 @@
+#include "../include/MeshletBuilder.h"
+#include <glm/glm/glm.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace {
+
+// A meshlet being grown: its triangles, its vertices and running sums for the scoring
+struct Cluster {
+    std::vector<unsigned int> triangles;
+    std::vector<unsigned int> vertices;
+    glm::vec3 centroidSum = glm::vec3(0.0f);
+    glm::vec3 normalSum = glm::vec3(0.0f);
+
+    void clear() {
+        triangles.clear();
+        vertices.clear();
+        centroidSum = glm::vec3(0.0f);
+        normalSum = glm::vec3(0.0f);
+    }
+};
+
+// Sphere around the box of the cluster's vertices, reaching the farthest one (like Mesh::computeBounds)
+BoundingSphere clusterSphere(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& vertices) {
+    AABB box;
+    for (unsigned int vertex : vertices) box.expand(positions[vertex]);
+
+    BoundingSphere sphere;
+    sphere.center = box.center();
+    float radiusSquared = 0.0f;
+    for (unsigned int vertex : vertices) {
+        glm::vec3 offset = positions[vertex] - sphere.center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    sphere.radius = std::sqrt(radiusSquared);
+    return sphere;
+}
+
+} // namespace
+
+std::vector<Meshlet> MeshletBuilder::build(const std::vector<float>& vertices, int stride, std::vector<unsigned int>& indices) {
+    std::vector<Meshlet> meshlets;
+    size_t triangleCount = indices.size() / 3;
+    size_t vertexCount = vertices.size() / stride;
+    if (triangleCount == 0 || vertexCount == 0) return meshlets;
+
+    // 1. Positions, and each triangle's center and unit normal (zero for degenerate ones)
+    std::vector<glm::vec3> positions(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        positions[v] = glm::vec3(vertices[v * stride], vertices[v * stride + 1], vertices[v * stride + 2]);
+    }
+    std::vector<glm::vec3> centers(triangleCount), normals(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        const glm::vec3& a = positions[indices[t * 3]];
+        const glm::vec3& b = positions[indices[t * 3 + 1]];
+        const glm::vec3& c = positions[indices[t * 3 + 2]];
+        centers[t] = (a + b + c) / 3.0f;
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        normals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+    }
+
+    // 2. Triangles around each vertex (offsets into one flat list)
+    std::vector<unsigned int> adjacencyStart(vertexCount + 1, 0);
+    for (unsigned int index : indices) adjacencyStart[index + 1]++;
+    for (size_t v = 0; v < vertexCount; ++v) adjacencyStart[v + 1] += adjacencyStart[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i) {
+        adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+
+    // 3. Grow clusters. vertexStamp/candidateStamp mark what belongs to the current one.
+    std::vector<bool> used(triangleCount, false);
+    std::vector<unsigned int> vertexStamp(vertexCount, ~0u);
+    std::vector<unsigned int> candidateStamp(triangleCount, ~0u);
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> order;
+    order.reserve(indices.size());
+    Cluster cluster;
+    unsigned int clusterId = 0;
+    size_t nextSeed = 0;
+
+    auto newVertices = [&](unsigned int triangle) {
+        int count = 0;
+        for (int k = 0; k < 3; ++k) count += vertexStamp[indices[triangle * 3 + k]] != clusterId ? 1 : 0;
+        return count;
+    };
+
+    auto finish = [&]() {
+        if (cluster.triangles.empty()) return;
+        Meshlet meshlet;
+        meshlet.firstIndex = static_cast<unsigned int>(order.size());
+        meshlet.indexCount = static_cast<unsigned int>(cluster.triangles.size() * 3);
+        meshlet.sphere = clusterSphere(positions, cluster.vertices);
+
+        // The cone: around the average normal, as wide as the most tilted triangle,
+        // with its apex behind every triangle's plane
+        float axisLength = glm::length(cluster.normalSum);
+        if (axisLength > 0.0f) {
+            glm::vec3 axis = cluster.normalSum / axisLength;
+            float minDot = 1.0f;
+            for (unsigned int triangle : cluster.triangles) {
+                if (normals[triangle] != glm::vec3(0.0f)) minDot = std::min(minDot, glm::dot(axis, normals[triangle]));
+            }
+            if (minDot > 0.0f) {
+                float apexDistance = 0.0f;
+                for (unsigned int triangle : cluster.triangles) {
+                    const glm::vec3& normal = normals[triangle];
+                    if (normal == glm::vec3(0.0f)) continue;
+                    float along = glm::dot(positions[indices[triangle * 3]] - meshlet.sphere.center, normal);
+                    apexDistance = std::max(apexDistance, along / glm::dot(axis, normal));
+                }
+                meshlet.coneApex = meshlet.sphere.center - axis * apexDistance;
+                meshlet.coneAxis = axis;
+                meshlet.coneCutoff = std::sqrt(std::max(0.0f, 1.0f - minDot * minDot));
+            }
+        }
+
+        for (unsigned int triangle : cluster.triangles) {
+            order.push_back(indices[triangle * 3]);
+            order.push_back(indices[triangle * 3 + 1]);
+            order.push_back(indices[triangle * 3 + 2]);
+        }
+        meshlets.push_back(meshlet);
+        cluster.clear();
+        candidates.clear();
+        clusterId++;
+    };
+
+    auto add = [&](unsigned int triangle) {
+        used[triangle] = true;
+        cluster.triangles.push_back(triangle);
+        cluster.centroidSum += centers[triangle];
+        cluster.normalSum += normals[triangle];
+        for (int k = 0; k < 3; ++k) {
+            unsigned int vertex = indices[triangle * 3 + k];
+            if (vertexStamp[vertex] == clusterId) continue;
+            vertexStamp[vertex] = clusterId;
+            cluster.vertices.push_back(vertex);
+
+            // Triangles around a new vertex become candidates
+            for (unsigned int a = adjacencyStart[vertex]; a < adjacencyStart[vertex + 1]; ++a) {
+                unsigned int neighbour = adjacency[a];
+                if (!used[neighbour] && candidateStamp[neighbour] != clusterId) {
+                    candidateStamp[neighbour] = clusterId;
+                    candidates.push_back(neighbour);
+                }
+            }
+        }
+    };
+
+    while (true) {
+        // a. Seed with the first unused triangle
+        while (nextSeed < triangleCount && used[nextSeed]) nextSeed++;
+        if (nextSeed == triangleCount) break;
+        add(static_cast<unsigned int>(nextSeed));
+
+        // b. Take the best neighbour until the cluster is full or has none left
+        while (cluster.triangles.size() < MaxTriangles) {
+            glm::vec3 centroid = cluster.centroidSum / static_cast<float>(cluster.triangles.size());
+            float normalLength = glm::length(cluster.normalSum);
+            glm::vec3 axis = normalLength > 0.0f ? cluster.normalSum / normalLength : glm::vec3(0.0f);
+
+            int best = -1;
+            int bestNew = 4;
+            float bestScore = FLT_MAX;
+            for (size_t c = 0; c < candidates.size(); ++c) {
+                unsigned int triangle = candidates[c];
+                if (used[triangle]) {
+                    candidates[c--] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+                int added = newVertices(triangle);
+                if (cluster.vertices.size() + added > MaxVertices) continue;
+
+                // Fewest new vertices first, then nearest and best aligned
+                float score = glm::length(centers[triangle] - centroid) * (2.0f - glm::dot(normals[triangle], axis));
+                if (added < bestNew || (added == bestNew && score < bestScore)) {
+                    best = static_cast<int>(c);
+                    bestNew = added;
+                    bestScore = score;
+                }
+            }
+            if (best < 0) break;
+
+            unsigned int triangle = candidates[best];
+            candidates[best] = candidates.back();
+            candidates.pop_back();
+            add(triangle);
+        }
+        finish();
+    }
+
+    indices = order;
+    return meshlets;
+}
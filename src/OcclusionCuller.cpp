@@ -0,0 +1,241 @@
+#include "../include/OcclusionCuller.h"
+#include "../include/JobSystem.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef FORCE_OCCLUSION_SSE
+#include <emmintrin.h>
+#endif
+
+void OcclusionCuller::beginFrame(const glm::mat4& viewProjection) {
+    m_viewProjection = viewProjection;
+    m_occluders.clear();
+    m_triangles.clear();
+    std::fill(m_depth.begin(), m_depth.end(), 0.0f);
+}
+
+void OcclusionCuller::addOccluder(const glm::vec3* positions, const unsigned int* indices, size_t indexCount, const glm::mat4& world) {
+    if (!positions || !indices || indexCount < 3) return;
+    m_occluders.push_back({ positions, indices, indexCount, world });
+}
+
+void OcclusionCuller::setupTriangle(const glm::vec4 clip[3], std::vector<ScreenTriangle>& out) {
+    // 1. Clip against the near plane (z + w >= 0 in GL clip space). Whatever is left
+    //    has w > 0, so it can be divided through. A triangle gives at most a quad.
+    glm::vec4 polygon[4];
+    int count = 0;
+    for (int i = 0; i < 3; ++i) {
+        const glm::vec4& a = clip[i];
+        const glm::vec4& b = clip[(i + 1) % 3];
+        float da = a.z + a.w;
+        float db = b.z + b.w;
+        if (da >= 0.0f) polygon[count++] = a;
+        if ((da >= 0.0f) != (db >= 0.0f)) polygon[count++] = a + (b - a) * (da / (da - db));
+    }
+    if (count < 3) return;
+
+    // 2. To pixels
+    float sx[4], sy[4], invW[4];
+    for (int i = 0; i < count; ++i) {
+        float w = std::max(polygon[i].w, 1e-6f);
+        invW[i] = 1.0f / w;
+        sx[i] = (polygon[i].x * invW[i] * 0.5f + 0.5f) * Width;
+        sy[i] = (polygon[i].y * invW[i] * 0.5f + 0.5f) * Height;
+    }
+
+    // 3. Fan out the quad, dropping triangles that cover no pixel center
+    for (int i = 1; i + 1 < count; ++i) {
+        int v[3] = { 0, i, i + 1 };
+        float minX = std::min({ sx[v[0]], sx[v[1]], sx[v[2]] });
+        float maxX = std::max({ sx[v[0]], sx[v[1]], sx[v[2]] });
+        float minY = std::min({ sy[v[0]], sy[v[1]], sy[v[2]] });
+        float maxY = std::max({ sy[v[0]], sy[v[1]], sy[v[2]] });
+        if (maxX < 0.5f || minX > Width - 0.5f || maxY < 0.5f || minY > Height - 0.5f) continue;
+
+        float area = (sx[v[1]] - sx[v[0]]) * (sy[v[2]] - sy[v[0]]) - (sy[v[1]] - sy[v[0]]) * (sx[v[2]] - sx[v[0]]);
+        if (std::fabs(area) < 1e-8f) continue;
+
+        // Counter-clockwise on screen, so the inside is where every edge function is positive.
+        // Both windings are kept: the engine doesn't cull back faces either.
+        if (area < 0.0f) std::swap(v[1], v[2]);
+
+        ScreenTriangle triangle;
+        for (int k = 0; k < 3; ++k) {
+            triangle.x[k] = sx[v[k]];
+            triangle.y[k] = sy[v[k]];
+            triangle.invW[k] = invW[v[k]];
+        }
+        // Rows whose pixel centers (y + 0.5) the triangle can reach
+        triangle.minY = std::max(0, static_cast<int>(std::ceil(minY - 0.5f)));
+        triangle.maxY = std::min(Height - 1, static_cast<int>(std::floor(maxY - 0.5f)));
+        if (triangle.minY > triangle.maxY) continue;
+        out.push_back(triangle);
+    }
+}
+
+void OcclusionCuller::rasterize() {
+    // 1. Transform and clip the occluders, one job each, into per-thread lists
+    unsigned int threads = JobSystem::getThreadCount();
+    m_threadTriangles.resize(threads);
+    for (auto& list : m_threadTriangles) list.clear();
+
+    JobSystem::parallelFor(m_occluders.size(), [this](size_t index, unsigned int thread) {
+        const Occluder& occluder = m_occluders[index];
+        glm::mat4 toClip = m_viewProjection * occluder.world;
+        std::vector<ScreenTriangle>& out = m_threadTriangles[thread];
+        for (size_t i = 0; i + 2 < occluder.indexCount; i += 3) {
+            glm::vec4 clip[3];
+            for (int k = 0; k < 3; ++k) {
+                clip[k] = toClip * glm::vec4(occluder.positions[occluder.indices[i + k]], 1.0f);
+            }
+            setupTriangle(clip, out);
+        }
+    });
+
+    m_triangles.clear();
+    for (const auto& list : m_threadTriangles) m_triangles.insert(m_triangles.end(), list.begin(), list.end());
+    if (m_triangles.empty()) return;
+
+    // 2. Each band of rows is written by one job only, so no locking is needed
+    JobSystem::parallelFor(Height / BandHeight, [this](size_t band, unsigned int) {
+        rasterizeBand(static_cast<int>(band));
+    });
+}
+
+void OcclusionCuller::rasterizeBand(int band) {
+    int bandMinY = band * BandHeight;
+    int bandMaxY = bandMinY + BandHeight - 1;
+
+    for (const ScreenTriangle& triangle : m_triangles) {
+        int minY = std::max(triangle.minY, bandMinY);
+        int maxY = std::min(triangle.maxY, bandMaxY);
+        if (minY > maxY) continue;
+
+        const float* x = triangle.x;
+        const float* y = triangle.y;
+
+        // 1. Edge functions E(px, py) = a * px + b * py + c, positive inside.
+        //    Edge k runs from vertex k to vertex k + 1.
+        float a[3], b[3], c[3];
+        for (int k = 0; k < 3; ++k) {
+            int n = (k + 1) % 3;
+            a[k] = y[k] - y[n];
+            b[k] = x[n] - x[k];
+            c[k] = -(a[k] * x[k] + b[k] * y[k]);
+        }
+
+        // 2. 1/w as a plane over the screen: the weight of vertex 2 is edge 0 over the area, etc.
+        float area = c[0] + a[0] * x[2] + b[0] * y[2];
+        float inverseArea = 1.0f / area;
+        float z1 = (triangle.invW[1] - triangle.invW[0]) * inverseArea;
+        float z2 = (triangle.invW[2] - triangle.invW[0]) * inverseArea;
+        float zA = a[2] * z1 + a[0] * z2;
+        float zB = b[2] * z1 + b[0] * z2;
+        float zC = triangle.invW[0] + c[2] * z1 + c[0] * z2;
+
+        // Columns whose pixel centers the triangle can reach
+        float minXf = std::min({ x[0], x[1], x[2] });
+        float maxXf = std::max({ x[0], x[1], x[2] });
+        int minX = std::max(0, static_cast<int>(std::ceil(minXf - 0.5f)));
+        int maxX = std::min(Width - 1, static_cast<int>(std::floor(maxXf - 0.5f)));
+        if (minX > maxX) continue;
+
+        for (int row = minY; row <= maxY; ++row) {
+            float py = row + 0.5f;
+            float* depthRow = &m_depth[row * Width];
+            int px = minX;
+#ifdef FORCE_OCCLUSION_SSE
+            // 3. Four pixels per step; lanes outside the triangle keep their old depth
+            px = minX & ~3;
+            const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            const __m128 zero = _mm_setzero_ps();
+            __m128 edgeA[3], edgeRow[3];
+            for (int k = 0; k < 3; ++k) {
+                edgeA[k] = _mm_set1_ps(a[k]);
+                edgeRow[k] = _mm_set1_ps(b[k] * py + c[k]);
+            }
+            __m128 depthA = _mm_set1_ps(zA);
+            __m128 depthRowStart = _mm_set1_ps(zB * py + zC);
+            __m128i laneIndex = _mm_setr_epi32(0, 1, 2, 3);
+            __m128i firstColumn = _mm_set1_epi32(minX - 1);
+            __m128i lastColumn = _mm_set1_epi32(maxX + 1);
+
+            for (; px <= maxX; px += 4) {
+                __m128 centerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(px)), laneOffsets);
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(edgeA[0], centerX), edgeRow[0]);
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(edgeA[1], centerX), edgeRow[1]);
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(edgeA[2], centerX), edgeRow[2]);
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+
+                // The first and last group can stick out of the triangle's columns (or the buffer)
+                __m128i column = _mm_add_epi32(_mm_set1_epi32(px), laneIndex);
+                __m128i inColumns = _mm_and_si128(_mm_cmpgt_epi32(column, firstColumn), _mm_cmplt_epi32(column, lastColumn));
+                inside = _mm_and_ps(inside, _mm_castsi128_ps(inColumns));
+                if (_mm_movemask_ps(inside) == 0) continue;
+
+                __m128 depth = _mm_add_ps(_mm_mul_ps(depthA, centerX), depthRowStart);
+                __m128 old = _mm_loadu_ps(depthRow + px);
+                __m128 nearer = _mm_max_ps(old, depth);
+                _mm_storeu_ps(depthRow + px, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+            }
+#else
+            for (; px <= maxX; ++px) {
+                float cx = px + 0.5f;
+                if (a[0] * cx + b[0] * py + c[0] < 0.0f) continue;
+                if (a[1] * cx + b[1] * py + c[1] < 0.0f) continue;
+                if (a[2] * cx + b[2] * py + c[2] < 0.0f) continue;
+                float depth = zA * cx + zB * py + zC;
+                depthRow[px] = std::max(depthRow[px], depth);
+            }
+#endif
+        }
+    }
+}
+
+bool OcclusionCuller::isOccluded(const AABB& worldBox) const {
+    if (worldBox.isEmpty()) return false;
+
+    // 1. Project the corners. The nearest corner stands in for the whole box.
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+    float nearest = 0.0f; // Largest 1/w
+    for (int i = 0; i < 8; ++i) {
+        glm::vec3 corner((i & 1) ? worldBox.max.x : worldBox.min.x,
+                         (i & 2) ? worldBox.max.y : worldBox.min.y,
+                         (i & 4) ? worldBox.max.z : worldBox.min.z);
+        glm::vec4 clip = m_viewProjection * glm::vec4(corner, 1.0f);
+        if (clip.z + clip.w < 0.0f || clip.w <= 0.0f) return false; // Reaches past the near plane
+
+        float invW = 1.0f / clip.w;
+        float sx = (clip.x * invW * 0.5f + 0.5f) * Width;
+        float sy = (clip.y * invW * 0.5f + 0.5f) * Height;
+        minX = std::min(minX, sx);
+        maxX = std::max(maxX, sx);
+        minY = std::min(minY, sy);
+        maxY = std::max(maxY, sy);
+        nearest = std::max(nearest, invW);
+    }
+
+    // 2. Every pixel the rectangle touches (not just the centers inside it)
+    int x0 = std::max(0, static_cast<int>(std::floor(minX)));
+    int x1 = std::min(Width - 1, static_cast<int>(std::floor(maxX)));
+    int y0 = std::max(0, static_cast<int>(std::floor(minY)));
+    int y1 = std::min(Height - 1, static_cast<int>(std::floor(maxY)));
+    if (x0 > x1 || y0 > y1) return false; // Off screen; that's for the frustum test to decide
+
+    // 3. Hidden only if an occluder is strictly nearer at every one of them
+    for (int row = y0; row <= y1; ++row) {
+        const float* depthRow = &m_depth[row * Width];
+        int px = x0;
+#ifdef FORCE_OCCLUSION_SSE
+        __m128 boxDepth = _mm_set1_ps(nearest);
+        for (; px + 4 <= x1 + 1; px += 4) {
+            __m128 behind = _mm_cmple_ps(_mm_loadu_ps(depthRow + px), boxDepth);
+            if (_mm_movemask_ps(behind)) return false;
+        }
+#endif
+        for (; px <= x1; ++px) {
+            if (depthRow[px] <= nearest) return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,96 @@
+#include "../include/RangeAllocator.h"
+#include <algorithm>
+#include <iostream>
+
+RangeAllocator::RangeAllocator(uint32_t capacity) {
+    grow(capacity);
+}
+
+uint32_t RangeAllocator::allocate(uint32_t size) {
+    if (size == 0) return Invalid;
+
+    // First fit: the lowest hole that is big enough, so the top of the space stays free longest
+    for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+        if (it->second < size) continue;
+
+        uint32_t offset = it->first;
+        uint32_t remaining = it->second - size;
+        m_free.erase(it);
+        if (remaining > 0) m_free[offset + size] = remaining;
+
+        m_allocated[offset] = size;
+        m_used += size;
+        return offset;
+    }
+    return Invalid;
+}
+
+void RangeAllocator::free(uint32_t offset) {
+    auto it = m_allocated.find(offset);
+    if (it == m_allocated.end()) {
+        std::cout << "Error: RangeAllocator::free of an offset that isn't allocated (" << offset << ")" << std::endl;
+        return;
+    }
+    uint32_t size = it->second;
+    m_allocated.erase(it);
+    m_used -= size;
+    insertFree(offset, size);
+}
+
+void RangeAllocator::grow(uint32_t capacity) {
+    if (capacity <= m_capacity) return;
+    uint32_t added = capacity - m_capacity;
+    uint32_t offset = m_capacity;
+    m_capacity = capacity;
+    insertFree(offset, added);
+}
+
+std::vector<RangeAllocator::Move> RangeAllocator::compact() {
+    std::vector<Move> moves;
+    std::map<uint32_t, uint32_t> packed;
+    uint32_t next = 0;
+    for (const auto& allocation : m_allocated) {
+        if (allocation.first != next) moves.push_back({ allocation.first, next, allocation.second });
+        packed[next] = allocation.second;
+        next += allocation.second;
+    }
+    m_allocated.swap(packed);
+
+    m_free.clear();
+    if (next < m_capacity) m_free[next] = m_capacity - next;
+    return moves;
+}
+
+uint32_t RangeAllocator::getLargestFreeRange() const {
+    uint32_t largest = 0;
+    for (const auto& range : m_free) largest = std::max(largest, range.second);
+    return largest;
+}
+
+float RangeAllocator::getFragmentation() const {
+    uint32_t freeSpace = m_capacity - m_used;
+    if (freeSpace == 0) return 0.0f;
+    return 1.0f - static_cast<float>(getLargestFreeRange()) / freeSpace;
+}
+
+void RangeAllocator::insertFree(uint32_t offset, uint32_t size) {
+    if (size == 0) return;
+
+    // 1. Merge with the range that ends where this one starts
+    auto next = m_free.lower_bound(offset);
+    if (next != m_free.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            m_free.erase(previous);
+        }
+    }
+
+    // 2. And with the one that starts where it ends
+    if (next != m_free.end() && offset + size == next->first) {
+        size += next->second;
+        m_free.erase(next);
+    }
+    m_free[offset] = size;
+}
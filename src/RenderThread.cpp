@@ -0,0 +1,59 @@
+#include "../include/RenderThread.h"
+#include <GLFW/glfw3.h>
+
+void RenderThread::start(GLFWwindow* window, std::function<void(const FramePacket&)> render) {
+    if (isRunning()) return;
+    this->window = window;
+    this->render = std::move(render);
+    quit = false;
+    pending = -1;
+
+    // A context can only be current on one thread at a time
+    glfwMakeContextCurrent(nullptr);
+    thread = std::thread(&RenderThread::run, this);
+}
+
+void RenderThread::run() {
+    glfwMakeContextCurrent(window);
+
+    while (true) {
+        // 1. Wait for a packet
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return pending >= 0 || quit; });
+            if (pending < 0) break;
+            index = pending;
+            pending = -1;
+        }
+        // 2. Taking it frees the simulation to fill the other one
+        wake.notify_all();
+
+        // 3. Draw it. The simulation doesn't touch this packet until the next submit() returns,
+        //    which needs this loop to come back for the next one.
+        render(packets[index]);
+        glfwSwapBuffers(window);
+    }
+
+    glfwMakeContextCurrent(nullptr);
+}
+
+void RenderThread::submit() {
+    if (!isRunning()) return;
+    std::unique_lock<std::mutex> lock(mutex);
+    pending = writeIndex;
+    wake.notify_all();
+    wake.wait(lock, [this] { return pending < 0; });
+    writeIndex ^= 1;
+}
+
+void RenderThread::stop() {
+    if (!isRunning()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    thread.join();
+    glfwMakeContextCurrent(window);
+}
@@ -4,9 +4,55 @@
 #include <glad/glad.h>
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <cstddef>
 #include <glm/glm/gtc/matrix_transform.hpp>
 #include "../include/LightComponent.h"
 #include "../include/ColliderComponent.h"
+#include "../include/ShaderBindings.h"
+#include "../include/TransformBuffer.h"
+#include "../include/RadixSort.h"
+#include "../include/GLState.h"
+#include "../include/JobSystem.h"
+#include "../include/GpuCuller.h"
+#include "../include/GeometryPool.h"
+#include "../include/StreamRing.h"
+#include "../include/ShaderVariants.h"
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+// Depth prepass program: positions only, and the same gl_Position math as material
+// shaders so their depths match in the shading pass. Same math isn't enough across two
+// programs (the compiler may order or fuse it differently), so gl_Position is invariant
+// here and has to be in material vertex shaders too. TRANSFORM_DATA is defined on 4.3.
+const char* DepthVertexShader = R"(
+invariant gl_Position;
+layout (location = 0) in vec3 aPos;
+struct Light { vec3 position; float intensity; vec3 color; };
+layout(std140) uniform FrameData { mat4 view; mat4 projection; vec3 viewPos; int numLights; Light lights[64]; };
+#ifdef TRANSFORM_DATA
+layout(std430, binding = 0) readonly buffer TransformData { mat4 models[]; };
+layout (location = 4) in uint aTransformIndex;
+#else
+uniform mat4 model;
+#endif
+void main() {
+#ifdef TRANSFORM_DATA
+    mat4 model = models[aTransformIndex & 0xFFFFFFu]; // The rest is a material, for shaders that want it
+#endif
+    vec3 worldPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
+)";
+
+const char* DepthFragmentShader = R"(
+void main() {
+}
+)";
+
+}
 
 Renderer::Renderer() {
 }
@@ -16,6 +62,160 @@ Renderer::~Renderer() {
 
 void Renderer::init() {
     glEnable(GL_DEPTH_TEST);
+
+    // One uniform buffer holds the per-frame camera and lights for every shader
+    glGenBuffers(1, &m_frameDataUBO);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, m_frameDataUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_DYNAMIC_DRAW);
+    GLState::bindBufferBase(GL_UNIFORM_BUFFER, ShaderBindings::FrameData, m_frameDataUBO);
+
+    // Persistent table of material constants, indexed per draw
+    MaterialTable::init();
+
+    // Persistently mapped ring for the data rewritten every frame (GL 4.4+, otherwise each
+    // upload keeps its own buffer)
+    StreamRing::init();
+
+    // Persistent per-object model matrices (GL 4.3+, otherwise draws keep the model uniform)
+    TransformBuffer::init();
+
+    // Compute culling and indirect draws (GL 4.3+, only used when gpuCulling is on)
+    GpuCuller::init();
+
+    // GPU timing of endScene and its opaque draws, for comparing forward, deferred and the depth prepass
+    for (FrameQueries& queries : m_frameQueries) {
+        glGenQueries(1, &queries.elapsed);
+        glGenQueries(1, &queries.prepassStart);
+        glGenQueries(1, &queries.opaqueStart);
+        glGenQueries(1, &queries.opaqueEnd);
+        glGenQueries(1, &queries.opaqueFragments);
+    }
+
+    // Depth-only programs for the depth prepass
+    const std::string header = "#version 330 core\n";
+    m_depthShader = Shader::fromSource(header + DepthVertexShader, header + DepthFragmentShader);
+    if (TransformBuffer::isAvailable()) {
+        const std::string instancedHeader = "#version 430 core\n#define TRANSFORM_DATA\n";
+        m_depthShaderInstanced = Shader::fromSource(instancedHeader + DepthVertexShader, instancedHeader + DepthFragmentShader);
+    }
+    GLint linked = GL_FALSE;
+    glGetProgramiv(m_depthShader->ID, GL_LINK_STATUS, &linked);
+    if (linked && m_depthShaderInstanced) glGetProgramiv(m_depthShaderInstanced->ID, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        std::cout << "Error: depth prepass programs failed to build, the prepass stays off." << std::endl;
+        m_depthShader = nullptr;
+        m_depthShaderInstanced = nullptr;
+    }
+
+    // Indirect commands for instanced batches and meshlet runs (instanced shaders need GL 4.3 anyway)
+    if (GLAD_GL_VERSION_4_3) {
+        glGenBuffers(1, &m_indirectCommandBuffer);
+
+        // Light lists for clustered lighting
+        glGenBuffers(1, &m_clusterLightBuffer);
+        glGenBuffers(1, &m_clusterGridBuffer);
+        glGenBuffers(1, &m_clusterIndexBuffer);
+    }
+
+    // What every shader variant gets this run, on top of its material's maps (see ShaderVariants)
+    uint32_t contextFeatures = 0;
+    if (TransformBuffer::isAvailable()) contextFeatures |= ShaderVariants::TransformData;
+    if (clusteredLighting && m_clusterLightBuffer) contextFeatures |= ShaderVariants::ClusteredLights;
+    ShaderVariants::setContextFeatures(contextFeatures);
+}
+
+void Renderer::uploadFrameData() {
+    if (!m_frameDataUBO) return;
+
+    FrameData data;
+    data.view = m_viewMatrix;
+    data.projection = m_projectionMatrix;
+    data.viewPos = m_viewPos;
+    data.numLights = static_cast<int>(std::min(activeLights.size(), static_cast<size_t>(MaxFrameLights)));
+    for (int i = 0; i < data.numLights; ++i) {
+        data.lights[i].position = activeLights[i].position;
+        data.lights[i].intensity = activeLights[i].intensity;
+        data.lights[i].color = activeLights[i].color;
+        data.lights[i].padding = 0.0f;
+    }
+
+    // Only upload the lights that are in use. A range of the ring is bound at the
+    // block's full size, but the unused lights in it are never read.
+    size_t bytes = offsetof(FrameData, lights) + sizeof(FrameLightData) * data.numLights;
+    size_t offset = StreamRing::allocate(sizeof(FrameData), StreamRing::getUniformAlignment());
+    if (offset != StreamRing::Invalid) {
+        std::memcpy(StreamRing::map(offset), &data, bytes);
+        GLState::bindBufferRange(GL_UNIFORM_BUFFER, ShaderBindings::FrameData, StreamRing::getBuffer(), offset, sizeof(FrameData));
+        m_stats.frameDataUploads++;
+        return;
+    }
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, m_frameDataUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, bytes, &data);
+    GLState::bindBufferBase(GL_UNIFORM_BUFFER, ShaderBindings::FrameData, m_frameDataUBO);
+    m_stats.frameDataUploads++;
+}
+
+void Renderer::buildLightClusters() {
+    if (!clusteredLighting || !m_clusterLightBuffer || !m_hasCamera) return;
+
+    // 1. Sort the lights into the clusters of the current viewport
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    auto start = std::chrono::steady_clock::now();
+    m_lightClusters.build(m_clusterLights, m_viewMatrix, m_projectionMatrix, m_nearPlane, m_farPlane, viewport[2], viewport[3]);
+    m_stats.clusterBuildMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // 2. Upload the lights, the grid and the lists (never empty, GL doesn't like zero-sized buffers)
+    const std::vector<glm::uvec2>& clusters = m_lightClusters.getClusters();
+    const std::vector<uint32_t>& indices = m_lightClusters.getLightIndices();
+    ClusterLight none = {};
+    uint32_t noIndex = 0;
+    const void* lightData = m_clusterLights.empty() ? static_cast<const void*>(&none) : m_clusterLights.data();
+    size_t lightBytes = sizeof(ClusterLight) * std::max<size_t>(m_clusterLights.size(), 1);
+    size_t gridBytes = sizeof(ClusterGridHeader) + sizeof(glm::uvec2) * clusters.size();
+    const void* indexData = indices.empty() ? static_cast<const void*>(&noIndex) : indices.data();
+    size_t indexBytes = sizeof(uint32_t) * std::max<size_t>(indices.size(), 1);
+
+    // Into the ring if all three fit
+    size_t alignment = StreamRing::getStorageAlignment();
+    size_t lightOffset = StreamRing::write(lightData, lightBytes, alignment);
+    size_t gridOffset = StreamRing::allocate(gridBytes, alignment);
+    size_t indexOffset = StreamRing::write(indexData, indexBytes, alignment);
+    if (lightOffset != StreamRing::Invalid && gridOffset != StreamRing::Invalid && indexOffset != StreamRing::Invalid) {
+        uint8_t* grid = static_cast<uint8_t*>(StreamRing::map(gridOffset));
+        std::memcpy(grid, &m_lightClusters.getHeader(), sizeof(ClusterGridHeader));
+        std::memcpy(grid + sizeof(ClusterGridHeader), clusters.data(), sizeof(glm::uvec2) * clusters.size());
+
+        unsigned int ring = StreamRing::getBuffer();
+        GLState::bindBufferRange(GL_SHADER_STORAGE_BUFFER, ShaderBindings::ClusterLights, ring, lightOffset, lightBytes);
+        GLState::bindBufferRange(GL_SHADER_STORAGE_BUFFER, ShaderBindings::ClusterGrid, ring, gridOffset, gridBytes);
+        GLState::bindBufferRange(GL_SHADER_STORAGE_BUFFER, ShaderBindings::ClusterLightIndices, ring, indexOffset, indexBytes);
+    } else {
+        uploadClusterBuffers(lightData, lightBytes, gridBytes, indexData, indexBytes);
+    }
+
+    m_stats.clusterLights = static_cast<unsigned int>(m_clusterLights.size());
+    m_stats.clusterAssignments = static_cast<unsigned int>(indices.size());
+    m_stats.clusterMaxLights = m_lightClusters.getMaxLightsPerCluster();
+}
+
+void Renderer::uploadClusterBuffers(const void* lightData, size_t lightBytes, size_t gridBytes, const void* indexData, size_t indexBytes) {
+    const std::vector<glm::uvec2>& clusters = m_lightClusters.getClusters();
+
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, m_clusterLightBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, lightBytes, lightData, GL_STREAM_DRAW);
+
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, m_clusterGridBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, gridBytes, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(ClusterGridHeader), &m_lightClusters.getHeader());
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(ClusterGridHeader), sizeof(glm::uvec2) * clusters.size(), clusters.data());
+
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, m_clusterIndexBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, indexBytes, indexData, GL_STREAM_DRAW);
+
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, ShaderBindings::ClusterLights, m_clusterLightBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, ShaderBindings::ClusterGrid, m_clusterGridBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, ShaderBindings::ClusterLightIndices, m_clusterIndexBuffer);
 }
 
 void Renderer::clear() {
@@ -23,98 +223,978 @@ void Renderer::clear() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
-void Renderer::beginScene(CameraComponent* camera) {
+void Renderer::extractFrame(CameraComponent* camera, FramePacket& packet) {
+    packet.frame++;
+    packet.hasCamera = camera != nullptr;
     if (camera) {
-        m_viewMatrix = camera->getViewMatrix();
-        m_projectionMatrix = camera->getProjectionMatrix();
-        if (camera->owner) {
-            m_viewPos = glm::vec3(camera->owner->worldTransform[3]);
-        }
+        packet.view = camera->getViewMatrix();
+        packet.projection = camera->getProjectionMatrix();
+        packet.farPlane = camera->farPlane;
+        packet.nearPlane = camera->nearPlane;
+        packet.viewPos = camera->owner ? glm::vec3(camera->owner->worldTransform[3]) : glm::vec3(0.0f);
     } else {
-        m_viewMatrix = glm::mat4(1.0f);
-        m_projectionMatrix = glm::mat4(1.0f);
-        m_viewPos = glm::vec3(0.0f);
+        packet.view = glm::mat4(1.0f);
+        packet.projection = glm::mat4(1.0f);
+        packet.viewPos = glm::vec3(0.0f);
     }
+    packet.lights.clear();
+    packet.renderables.clear();
+    packet.renderersCulled = 0;
+    packet.subtreesCulled = 0;
+    packet.bvhNodesVisited = 0;
+    packet.debugBoxes.clear();
 
-    activeLights.clear();
-    renderQueue.clear();
+    // Lights come from the registry rather than the traversal, so a culled hierarchy still lights the scene
+    for (auto* light : LightComponent::allLights) {
+        if (!light || !light->owner) continue;
+        glm::vec3 worldPos = glm::vec3(light->owner->worldTransform[3]);
+        packet.lights.push_back({worldPos, light->color, light->intensity, light->constant, light->linear, light->quadratic});
+    }
+
+    // 1. The GPU path keeps its own tables of the same renderers, read straight from the scene,
+    //    so it only runs when drawing happens right after this (no render thread). After frames
+    //    without it, everything is refreshed once (renderers may have moved while it wasn't looking).
+    packet.gpuCulling = gpuCulling && !renderThread && camera != nullptr && GpuCuller::isAvailable();
+    if (packet.gpuCulling) {
+        GpuCuller::sync(!m_gpuLastFrame);
+    }
+    m_gpuLastFrame = packet.gpuCulling;
+
+    // 2. Refit the leaves of renderers that moved since last frame
+    RendererComponent::updateSpatialIndex();
+
+    // 3. On the GPU path only the renderers it can't draw go through the CPU
+    if (packet.gpuCulling) {
+        for (RendererComponent* renderComp : GpuCuller::getFallbackRenderers()) {
+            if (renderComp->model && renderComp->owner) addRenderable(packet, renderComp, renderComp->owner);
+        }
+        return;
+    }
+
+    // 4. Walk the tree with the frustum; whole branches outside it are skipped,
+    //    and branches fully inside are taken without further tests.
+    //    With culling off, the default frustum accepts everything.
+    bool cull = frustumCulling && camera != nullptr;
+    const DynamicAABBTree& index = RendererComponent::spatialIndex;
+    index.query(cull ? Frustum(packet.projection * packet.view) : Frustum(), [&](void* userData) {
+        auto* renderComp = static_cast<RendererComponent*>(userData);
+        if (!renderComp->model || !renderComp->owner) return;
+        addRenderable(packet, renderComp, renderComp->owner);
+    });
+
+    // 5. The survivors still get the tighter sphere test in buildRenderQueue
+    packet.renderersCulled = static_cast<unsigned int>(index.getProxyCount() - packet.renderables.size());
+    packet.bvhNodesVisited = static_cast<unsigned int>(index.getNodesVisited());
 }
 
-void Renderer::submitNode(std::shared_ptr<Entity> node) {
-    // 1. Extract light data
-    auto lightComp = node->getComponent<LightComponent>();
-    if (lightComp) {
-        glm::vec3 worldPos = glm::vec3(node->worldTransform[3]);
-        activeLights.push_back({worldPos, lightComp->color, lightComp->intensity});
+void Renderer::addRenderable(FramePacket& packet, RendererComponent* renderer, Entity* entity) {
+    // The slot also identifies the renderer to the drawing side, so every renderer gets one
+    // (without a TransformBuffer it's only a number)
+    if (renderer->transformSlot < 0) {
+        renderer->transformSlot = TransformBuffer::allocate();
     }
-    
+    packet.renderables.push_back({ renderer->model.get(), entity->worldTransform, renderer->transformSlot,
+                                   renderer->impostorDistance, renderer->occluder });
+}
+
+void Renderer::extractNode(std::shared_ptr<Entity> node, FramePacket& packet) {
+    // 1. A hierarchy whose whole box is off screen is skipped with one test.
+    //    Single entities are left to the batched sphere test in buildRenderQueue.
+    if (frustumCulling && packet.hasCamera && !node->children.empty() && !node->subtreeBounds.isEmpty() &&
+        !Frustum(packet.projection * packet.view).intersects(node->subtreeBounds)) {
+        packet.subtreesCulled++;
+        return;
+    }
+
     // 2. Extract render data
     auto renderComp = node->getComponent<RendererComponent>();
     
     if (renderComp && renderComp->model) {
-        auto model = renderComp->model;
-        
-        // Loop through the corresponding meshes and materials
-        for (size_t i = 0; i < model->meshes.size(); ++i) {
-            auto mesh = model->meshes[i];
-            
-            // Safety check in case a material is missing
-            auto material = (i < model->materials.size()) ? model->materials[i] : nullptr; 
-
-            // Pass the single mesh and material to the GPU
-            if (mesh && material) {
-                renderQueue.push_back({mesh, material, node->worldTransform});
-            }
-        }
+        addRenderable(packet, renderComp.get(), node.get());
     }
 
     // Recurse through all children
     for (auto& child : node->children) {
-        submitNode(child);
+        extractNode(child, packet);
     }
 }
 
-void Renderer::draw(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material, const glm::mat4& modelMatrix) {
-    if (!mesh || !material || !material->shader) return;
+void Renderer::extractDebug(FramePacket& packet) {
+    for (auto* collider : ColliderComponent::allColliders) {
+        if (!collider || !collider->owner) continue;
+        packet.debugBoxes.push_back(glm::scale(collider->owner->worldTransform, collider->size));
+    }
+}
+
+void Renderer::beginScene(const FramePacket& packet) {
+    m_packet = &packet;
+    m_viewMatrix = packet.view;
+    m_projectionMatrix = packet.projection;
+    m_viewPos = packet.viewPos;
+    m_farPlane = packet.farPlane;
+    m_nearPlane = packet.nearPlane;
+    m_frustum = Frustum(m_projectionMatrix * m_viewMatrix);
 
-    auto shader = material->shader;
-    shader->use();
+    m_hasCamera = packet.hasCamera;
+    activeLights.assign(packet.lights.begin(), packet.lights.end());
+    renderQueue.clear();
+    m_frameTransforms.clear();
+    m_impostorQueue.clear();
+    m_cullThisFrame = frustumCulling && packet.hasCamera;
+    m_gpuThisFrame = packet.gpuCulling;
 
-    // Set Global Uniforms
-    shader->setMat4("view", m_viewMatrix);
-    shader->setMat4("projection", m_projectionMatrix);
-    shader->setFloat("viewPos", m_viewPos.x, m_viewPos.y, m_viewPos.z);
+    m_stats = RenderStats();
+    m_stats.objectsCulled = packet.renderersCulled;
+    m_stats.subtreesCulled = packet.subtreesCulled;
+    m_stats.bvhNodesVisited = packet.bvhNodesVisited;
+    Shader::resetStats();
+    MaterialTable::resetStats();
+    TransformBuffer::resetStats();
+    GLState::resetStats();
+    StreamRing::resetStats();
+    StreamRing::beginFrame();
+    TransformBuffer::beginFrame();
 
-    // Send light data to shader
-    shader->setInt("numLights", activeLights.size());
+    // Other code may have touched GL state between frames, so forget what is bound
+    m_frameIndex++;
+    m_lastShader = nullptr;
+    m_lastMaterial = nullptr;
+    m_lastMesh = nullptr;
+}
 
-    // Loop through the vector and set the uniforms for each light
-    for (size_t i = 0; i < activeLights.size(); ++i) {
+RenderStats Renderer::getStats() const {
+    RenderStats stats = m_stats;
+    stats.uniformLookups = Shader::stats.lookups;
+    stats.uniformUploads = Shader::stats.uploads;
+    stats.uniformUploadsSkipped = Shader::stats.skippedUploads;
+    stats.materialUploads = MaterialTable::uploads;
+    stats.transformBytesUploaded = TransformBuffer::stats.bytesUploaded;
+    stats.transformUploadSpans = TransformBuffer::stats.uploadSpans;
+    stats.glBinds = GLState::stats.binds;
+    stats.glBindsSkipped = GLState::stats.skipped;
+    return stats;
+}
+
+const Renderer::SceneUniforms& Renderer::getSceneUniforms(const Shader& shader) {
+    auto it = m_sceneUniforms.find(shader.ID);
+    if (it != m_sceneUniforms.end()) return it->second;
+
+    SceneUniforms uniforms;
+    uniforms.usesFrameData = shader.hasUniformBlock("FrameData");
+    uniforms.usesTransformData = TransformBuffer::isAvailable() && shader.hasStorageBlock("TransformData");
+    uniforms.usesMaterialLayers = uniforms.usesTransformData && shader.hasUniformBlock("MaterialLayers");
+    uniforms.view = shader.getUniform("view");
+    uniforms.projection = shader.getUniform("projection");
+    uniforms.viewPos = shader.getUniform("viewPos");
+    uniforms.numLights = shader.getUniform("numLights");
+    uniforms.model = shader.getUniform("model");
+
+    // Build the per-light names once, instead of formatting them for every draw
+    for (size_t i = 0; ; ++i) {
         std::string number = std::to_string(i);
-        shader->setFloat(("lights[" + number + "].position").c_str(), activeLights[i].position.x, activeLights[i].position.y, activeLights[i].position.z);
-        shader->setFloat(("lights[" + number + "].color").c_str(), activeLights[i].color.x, activeLights[i].color.y, activeLights[i].color.z);
-        shader->setFloat(("lights[" + number + "].intensity").c_str(), activeLights[i].intensity);
+        LightUniforms light;
+        light.position = shader.getUniform("lights[" + number + "].position");
+        light.color = shader.getUniform("lights[" + number + "].color");
+        light.intensity = shader.getUniform("lights[" + number + "].intensity");
+        if (light.position < 0 && light.color < 0 && light.intensity < 0) break;
+        uniforms.lights.push_back(light);
+    }
+
+    return m_sceneUniforms.emplace(shader.ID, std::move(uniforms)).first->second;
+}
+
+void Renderer::gatherLights() {
+    // The packet's lights with the distance where each fades out, for clustered and deferred lighting
+    m_clusterLights.resize(activeLights.size());
+    for (size_t i = 0; i < activeLights.size(); ++i) {
+        const PointLightData& light = activeLights[i];
+        float range = LightClusters::lightRange(light.color, light.intensity, light.constant, light.linear, light.quadratic);
+        m_clusterLights[i].positionRange = glm::vec4(light.position, range);
+        m_clusterLights[i].colorIntensity = glm::vec4(light.color, light.intensity);
+        m_clusterLights[i].attenuation = glm::vec4(light.constant, light.linear, light.quadratic, 0.0f);
+    }
+}
+
+void Renderer::buildRenderQueue() {
+    auto start = std::chrono::steady_clock::now();
+    const std::vector<FramePacket::Renderable>& renderables = m_packet->renderables;
+    size_t count = renderables.size();
+    size_t chunkCount = (count + QueueChunkSize - 1) / QueueChunkSize;
+    m_stats.queueChunks = static_cast<unsigned int>(chunkCount);
+
+    // 1. World bounding spheres of every candidate, tested against the frustum a chunk at a time
+    m_cullX.resize(count);
+    m_cullY.resize(count);
+    m_cullZ.resize(count);
+    m_cullRadius.resize(count);
+    m_cullVisible.resize(count);
+    JobSystem::parallelFor(chunkCount, [&](size_t chunk, unsigned int) {
+        size_t first = chunk * QueueChunkSize;
+        size_t end = std::min(count, first + QueueChunkSize);
+        for (size_t c = first; c < end; ++c) {
+            const FramePacket::Renderable& renderable = renderables[c];
+            BoundingSphere sphere = renderable.model->getBoundingSphere().transformed(renderable.worldTransform);
+            m_cullX[c] = sphere.center.x;
+            m_cullY[c] = sphere.center.y;
+            m_cullZ[c] = sphere.center.z;
+            m_cullRadius[c] = sphere.radius;
+            m_cullVisible[c] = CullVisible;
+        }
+        if (m_cullThisFrame) {
+            m_frustum.testSpheres(&m_cullX[first], &m_cullY[first], &m_cullZ[first], &m_cullRadius[first], end - first, &m_cullVisible[first]);
+        }
+    });
+
+    // 2. Then drop what the occluders hide
+    if (m_cullThisFrame && occlusionCulling) {
+        cullOccluded();
+    }
+
+    // 3. Each job turns its chunk of survivors into packets, in lists of its own
+    if (m_queueChunks.size() < chunkCount) m_queueChunks.resize(chunkCount);
+    m_lodLevels.resize(TransformBuffer::prepareSlots(), 0);
+    JobSystem::parallelFor(chunkCount, [&](size_t chunk, unsigned int) {
+        QueueChunk& out = m_queueChunks[chunk];
+        out.packets.clear();
+        out.transforms.clear();
+        out.impostors.clear();
+        out.dirtySlots.clear();
+        out.needsImpostor.clear();
+        out.visible = out.culled = out.occluded = out.lodSwitches = 0;
+
+        size_t end = std::min(count, (chunk + 1) * QueueChunkSize);
+        for (size_t c = chunk * QueueChunkSize; c < end; ++c) {
+            if (m_cullVisible[c] == CullHidden) {
+                out.culled++;
+                continue;
+            }
+            if (m_cullVisible[c] == CullOccluded) {
+                out.occluded++;
+                continue;
+            }
+            out.visible++;
+            if (!queueCandidate(c, out)) out.needsImpostor.push_back(static_cast<uint32_t>(c));
+        }
+    });
+
+    // 4. Merge the lists in chunk order
+    size_t packetCount = renderQueue.size();
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) packetCount += m_queueChunks[chunk].packets.size();
+    renderQueue.reserve(packetCount);
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+        mergeQueueChunk(m_queueChunks[chunk]);
+    }
+
+    // 5. Models seen from far away for the first time: bake their impostors here, then queue them
+    if (chunkCount > 0) {
+        QueueChunk& late = m_queueChunks[0];
+        late.packets.clear();
+        late.transforms.clear();
+        late.impostors.clear();
+        late.dirtySlots.clear();
+        late.visible = late.culled = late.occluded = late.lodSwitches = 0;
+        for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+            for (uint32_t c : m_queueChunks[chunk].needsImpostor) {
+                getImpostor(*renderables[c].model);
+                queueCandidate(c, late);
+            }
+        }
+        mergeQueueChunk(late);
+    }
+
+    m_stats.queueBuildMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Renderer::queueCandidate(size_t c, QueueChunk& chunk) {
+    const FramePacket::Renderable& renderable = m_packet->renderables[c];
+    Model* model = renderable.model;
+    const glm::mat4& world = renderable.worldTransform;
+
+    BoundingSphere worldSphere;
+    worldSphere.center = glm::vec3(m_cullX[c], m_cullY[c], m_cullZ[c]);
+    worldSphere.radius = m_cullRadius[c];
+
+    // Far away: one quad from the impostor atlas instead of the meshes
+    if (impostors && renderable.impostorDistance > 0.0f &&
+        glm::length(worldSphere.center - m_viewPos) > renderable.impostorDistance) {
+        if (!model->impostor && !model->impostorFailed) return false;
+        if (Impostor* impostor = model->impostor.get()) {
+            ImpostorDraw draw;
+            draw.impostor = impostor;
+            draw.instance.centerRadius = glm::vec4(worldSphere.center, worldSphere.radius);
+            draw.instance.axisX = glm::vec4(glm::normalize(glm::vec3(world[0])), 0.0f);
+            draw.instance.axisY = glm::vec4(glm::normalize(glm::vec3(world[1])), 0.0f);
+            draw.instance.axisZ = glm::vec4(glm::normalize(glm::vec3(world[2])), 0.0f);
+            chunk.impostors.push_back(draw);
+            return true;
+        }
     }
-    // Apply Material Properties
-    material->apply();
 
-    // Set Model Matrix
-    shader->setMat4("model", modelMatrix);
+    // Keep the object's slot current; nothing is uploaded unless the matrix changed
+    int transformSlot = TransformBuffer::isAvailable() ? renderable.transformSlot : -1;
+    if (transformSlot >= 0 && TransformBuffer::store(transformSlot, world)) {
+        chunk.dirtySlots.push_back(transformSlot);
+    }
+
+    // One copy of the matrix and one view depth for all of the model's meshes
+    uint32_t transformIndex = static_cast<uint32_t>(chunk.transforms.size());
+    chunk.transforms.push_back(world);
+    float viewDepth = -(m_viewMatrix * world[3]).z;
+    float normalizedDepth = m_farPlane > 0.0f ? viewDepth / m_farPlane : 0.0f;
+    bool testMeshes = m_cullThisFrame && model->meshes.size() > 1;
+
+    // One level of detail for the whole model, from its size on screen
+    int lod = meshLods ? selectLod(renderable, worldSphere, chunk.lodSwitches) : 0;
+
+    // Loop through the corresponding meshes and materials
+    for (size_t i = 0; i < model->meshes.size(); ++i) {
+        auto& mesh = model->meshes[i];
+
+        // Safety check in case a material is missing
+        Material* material = (i < model->materials.size()) ? model->materials[i].get() : nullptr;
+        if (!mesh || !material || !material->shader) continue;
+
+        // Models made of several meshes also test each mesh's box
+        if (testMeshes && !m_frustum.intersects(mesh->bounds.transformed(world))) continue;
+
+        // Queue the single mesh and material as a packet; endScene sorts and draws them
+        RenderPacket packet;
+        packet.key = makeSortKey(material->shader->renderId, material->renderId, mesh->renderId, lod, normalizedDepth);
+        packet.mesh = mesh->renderId;
+        packet.lod = static_cast<uint8_t>(lod);
+        packet.material = material->renderId;
+        packet.transform = transformIndex;
+        packet.transformSlot = transformSlot;
+        chunk.packets.push_back(packet);
+    }
+    return true;
+}
+
+void Renderer::mergeQueueChunk(QueueChunk& chunk) {
+    uint32_t transformBase = static_cast<uint32_t>(m_frameTransforms.size());
+    m_frameTransforms.insert(m_frameTransforms.end(), chunk.transforms.begin(), chunk.transforms.end());
+    for (RenderPacket packet : chunk.packets) {
+        packet.transform += transformBase;
+        renderQueue.push_back(packet);
+    }
+    m_impostorQueue.insert(m_impostorQueue.end(), chunk.impostors.begin(), chunk.impostors.end());
+    for (int slot : chunk.dirtySlots) TransformBuffer::markDirty(slot);
+
+    m_stats.objectsVisible += chunk.visible;
+    m_stats.objectsCulled += chunk.culled;
+    m_stats.objectsOccluded += chunk.occluded;
+    m_stats.lodSwitches += chunk.lodSwitches;
+}
+
+void Renderer::cullOccluded() {
+    // Orthographic cameras would need a different depth; leave them to the frustum test
+    if (m_projectionMatrix[2][3] == 0.0f) return;
+
+    // 1. Rasterize the occluders that survived the frustum test
+    auto start = std::chrono::steady_clock::now();
+    m_occlusion.beginFrame(m_projectionMatrix * m_viewMatrix);
+    const std::vector<FramePacket::Renderable>& renderables = m_packet->renderables;
+    size_t count = renderables.size();
+    for (size_t c = 0; c < count; ++c) {
+        if (!m_cullVisible[c] || !renderables[c].occluder) continue;
+        for (const auto& mesh : renderables[c].model->meshes) {
+            if (!mesh) continue;
+            m_occlusion.addOccluder(mesh->occluderPositions.data(), mesh->occluderIndices.data(),
+                                    mesh->occluderIndices.size(), renderables[c].worldTransform);
+        }
+        m_stats.occluders++;
+    }
+    if (m_stats.occluders == 0) return;
+    m_occlusion.rasterize();
+    m_stats.occluderTriangles = static_cast<unsigned int>(m_occlusion.getTrianglesRasterized());
+    m_stats.occlusionRasterMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // 2. Test everything else in view, in blocks spread over the workers.
+    //    Occluders aren't tested: they're drawn anyway, and their own depth would hide them.
+    start = std::chrono::steady_clock::now();
+    const size_t BlockSize = 256;
+    JobSystem::parallelFor((count + BlockSize - 1) / BlockSize, [&](size_t block, unsigned int) {
+        size_t end = std::min(count, (block + 1) * BlockSize);
+        for (size_t c = block * BlockSize; c < end; ++c) {
+            if (!m_cullVisible[c] || renderables[c].occluder) continue;
+            AABB worldBox = renderables[c].model->getBounds().transformed(renderables[c].worldTransform);
+            if (m_occlusion.isOccluded(worldBox)) m_cullVisible[c] = CullOccluded;
+        }
+    });
+    m_stats.occlusionTestMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+Impostor* Renderer::getImpostor(Model& model) {
+    if (!model.impostor && !model.impostorFailed) {
+        model.impostor = Impostor::bake(model, impostorFrames, impostorFrameSize);
+        model.impostorFailed = !model.impostor;
+        m_stats.impostorsBaked++;
+
+        // Baking used its own program and textures
+        m_lastShader = nullptr;
+        m_lastMaterial = nullptr;
+        m_lastMesh = nullptr;
+    }
+    return model.impostor.get();
+}
+
+void Renderer::drawImpostors() {
+    if (m_impostorQueue.empty()) return;
+
+    // Group the quads by atlas, then draw each group at once
+    std::sort(m_impostorQueue.begin(), m_impostorQueue.end(),
+              [](const ImpostorDraw& a, const ImpostorDraw& b) { return a.impostor < b.impostor; });
+    m_impostorInstances.clear();
+    for (const auto& draw : m_impostorQueue) m_impostorInstances.push_back(draw.instance);
+
+    glm::mat4 viewProjection = m_projectionMatrix * m_viewMatrix;
+    size_t first = 0;
+    while (first < m_impostorQueue.size()) {
+        size_t end = first + 1;
+        while (end < m_impostorQueue.size() && m_impostorQueue[end].impostor == m_impostorQueue[first].impostor) ++end;
+
+        m_impostorQueue[first].impostor->drawInstances(m_impostorInstances, first, end - first, viewProjection, m_viewPos);
+        m_stats.drawCalls++;
+        m_stats.impostors += static_cast<unsigned int>(end - first);
+        m_stats.trianglesDrawn += static_cast<unsigned int>(end - first) * 2;
+        first = end;
+    }
 
-    // Draw the specific mesh!
-    mesh->draw(); 
+    // The quads used their own program, vertex array and texture
+    m_lastShader = nullptr;
+    m_lastMaterial = nullptr;
+    m_lastMesh = nullptr;
+}
+
+int Renderer::selectLod(const FramePacket::Renderable& renderable, const BoundingSphere& worldSphere, unsigned int& lodSwitches) {
+    const auto& settings = renderable.model->lodSettings;
+    if (settings.empty()) return 0;
+
+    // 1. Height of the sphere as a fraction of the viewport height
+    float screenSize;
+    bool perspective = m_projectionMatrix[2][3] != 0.0f;
+    if (perspective) {
+        float distance = glm::length(worldSphere.center - m_viewPos);
+        if (distance <= worldSphere.radius) {
+            screenSize = FLT_MAX; // The camera is inside it
+        } else {
+            screenSize = worldSphere.radius * m_projectionMatrix[1][1] / distance;
+        }
+    } else {
+        screenSize = worldSphere.radius * m_projectionMatrix[1][1];
+    }
+
+    // 2. Level i (from 1) is used below settings[i - 1].screenSize. Leaving the current level
+    //    takes a margin past the threshold, so an object sitting on it doesn't flicker.
+    uint8_t& level = m_lodLevels[renderable.transformSlot];
+    int lod = std::min<int>(level, static_cast<int>(settings.size()));
+    while (lod < static_cast<int>(settings.size()) && screenSize < settings[lod].screenSize * (1.0f - lodHysteresis)) {
+        lod++;
+    }
+    while (lod > 0 && screenSize > settings[lod - 1].screenSize * (1.0f + lodHysteresis)) {
+        lod--;
+    }
+
+    if (lod != level) lodSwitches++;
+    level = static_cast<uint8_t>(lod);
+    return lod;
+}
+
+void Renderer::draw(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material, const glm::mat4& modelMatrix, int transformSlot) {
+    if (!mesh || !material) return;
+    drawMesh(*mesh, *material, modelMatrix, transformSlot, 0);
+}
+
+const Renderer::SceneUniforms& Renderer::bindState(Mesh& mesh, Material& material) {
+    Shader* shader = m_shaderOverride ? m_shaderOverride
+                   : m_deferredGeometryPass ? &m_deferred.getGeometryShader(material) : material.shader.get();
+    if (shader != m_lastShader) {
+        shader->use();
+        m_lastShader = shader;
+        m_lastMaterial = nullptr; // The material's uniforms belong to the program
+        m_stats.shaderSwitches++;
+    }
+    const SceneUniforms& uniforms = getSceneUniforms(*shader);
+
+    // Shaders with the FrameData block already have the camera and lights.
+    // Older shaders still get them as plain uniforms (the shader skips values it already has).
+    if (!uniforms.usesFrameData) {
+        shader->set(uniforms.view, m_viewMatrix);
+        shader->set(uniforms.projection, m_projectionMatrix);
+        shader->set(uniforms.viewPos, m_viewPos);
+
+        // Send light data to shader, clamped to the size of its lights[] array
+        size_t lightCount = std::min(activeLights.size(), uniforms.lights.size());
+        shader->set(uniforms.numLights, static_cast<int>(lightCount));
+
+        // Loop through the vector and set the uniforms for each light
+        for (size_t i = 0; i < lightCount; ++i) {
+            shader->set(uniforms.lights[i].position, activeLights[i].position);
+            shader->set(uniforms.lights[i].color, activeLights[i].color);
+            shader->set(uniforms.lights[i].intensity, activeLights[i].intensity);
+        }
+    }
+    // Apply Material Properties, unless the previous draw already did
+    if (material.syncedFrame != m_frameIndex) {
+        material.syncParams();
+        material.syncedFrame = m_frameIndex;
+    }
+    // The depth-only programs read no material
+    if (&material != m_lastMaterial && !m_positionsOnly) {
+        material.apply(*shader);
+        m_lastMaterial = &material;
+        m_stats.materialSwitches++;
+    }
+    if (&mesh != m_lastMesh) {
+        m_lastMesh = &mesh;
+        m_stats.meshSwitches++;
+    }
+    return uniforms;
+}
+
+void Renderer::drawMesh(Mesh& mesh, Material& material, const glm::mat4& modelMatrix, int transformSlot, int lod) {
+    if (!material.shader) return;
+
+    const SceneUniforms& uniforms = bindState(mesh, material);
+    Shader* shader = m_lastShader;
+
+    if (uniforms.usesTransformData) {
+        // One-off draws (debug wireframes) have no slot of their own, so borrow one for this frame
+        if (transformSlot < 0) {
+            transformSlot = TransformBuffer::allocateTransient();
+            TransformBuffer::set(transformSlot, modelMatrix);
+            TransformBuffer::upload();
+        }
+        unsigned int baseInstance = TransformBuffer::streamInstance(transformSlot, uniforms.usesMaterialLayers ? material.materialIndex : -1);
+        TransformBuffer::flushInstances();
+        mesh.drawInstanced(1, baseInstance, lod, m_positionsOnly);
+    } else {
+        // Set Model Matrix
+        shader->set(uniforms.model, modelMatrix);
+
+        // Draw the specific mesh!
+        mesh.draw(lod, m_positionsOnly);
+    }
+    m_stats.drawCalls++;
+    m_stats.instances++;
+    m_stats.trianglesDrawn += mesh.getLod(lod).indexCount / 3;
 }
 
 void Renderer::endScene() {
-    // We now have a complete list of lights and a complete list of meshes!
-    
-    for (const auto& cmd : renderQueue) {
-        // We pass the activeLights array to your low-level draw function
-        this->draw(cmd.mesh, cmd.material, cmd.transform);
+    // GPU time of everything below. The queries used here were issued two frames ago,
+    // so their results are normally in and reading them doesn't wait.
+    FrameQueries& queries = m_frameQueries[m_frameIndex % 2];
+    if (queries.elapsed) {
+        readFrameQueries(queries);
+        glBeginQuery(GL_TIME_ELAPSED, queries.elapsed);
+    }
+
+    // We now have a complete list of renderers!
+    // Upload the frame-wide data once; every draw below shares it.
+    gatherLights();
+    uploadFrameData();
+    buildLightClusters();
+
+    // Close the holes freed meshes left in the shared vertex and index buffers, once there are enough of them
+    GeometryPool::defragment(GeometryDefragmentThreshold);
+
+    // Drop what the camera can't see and queue the rest
+    buildRenderQueue();
+
+    // Push any changed material constants before the first draw reads the table. Materials
+    // that share their textures get one ID in the sort key, so their packets end up together.
+    for (auto& packet : renderQueue) {
+        Material* material = RenderIdTable<Material>::get(packet.material);
+        if (!material) continue;
+        if (material->syncedFrame != m_frameIndex) {
+            material->syncParams();
+            material->syncedFrame = m_frameIndex;
+            material->sortId = getSortId(*material);
+        }
+        if (material->sortId != material->renderId) {
+            packet.key = sortKeyWithMaterial(packet.key, material->sortId);
+        }
+    }
+
+    // Group the packets by shader, material and mesh (front to back within each)
+    radixSortByKey(renderQueue, m_sortScratch);
+
+    // Send the model matrices that changed since last frame
+    TransformBuffer::upload();
+
+    // The GPU path's culling pass reads those matrices, so it goes right after
+    if (m_gpuThisFrame) {
+        GpuCuller::cull(m_viewMatrix, m_projectionMatrix, m_viewPos, meshLods);
+        m_lastShader = nullptr; // The pass used its own program
+    }
+
+    // Deferred frames draw their opaque packets into the G-buffer, with its program
+    m_deferredThisFrame = deferredShading && m_hasCamera && m_deferred.beginGeometry();
+
+    // 1. Split the sorted queue into batches. Neighbouring packets with the same mesh and
+    //    material become one instanced draw if the shader reads its matrices from TransformData,
+    //    and neighbouring instanced draws with the same material one multi-draw. Shaders that
+    //    read MaterialLayers take the material per instance, so for them "the same material"
+    //    is any material that binds the same textures (see Material::sharesTextures).
+    //    Packets of meshes with meshlets are drawn one by one, in runs of visible meshlets.
+    m_batches.clear();
+    m_indirectCommands.clear();
+    TransformBuffer::reserveInstances(renderQueue.size()); // At most one entry per packet
+    size_t first = 0;
+    while (first < renderQueue.size()) {
+        const RenderPacket& head = renderQueue[first];
+        Material* material = RenderIdTable<Material>::get(head.material);
+        Shader* shader = material ? material->shader.get() : nullptr;
+        if (shader && m_deferredThisFrame) {
+            shader = &m_deferred.getGeometryShader(*material);
+        }
+        bool instanced = shader && head.transformSlot >= 0 && getSceneUniforms(*shader).usesTransformData;
+        bool layered = instanced && getSceneUniforms(*shader).usesMaterialLayers;
+
+        size_t end = first + 1;
+        while (end < renderQueue.size() && renderQueue[end].mesh == head.mesh && renderQueue[end].lod == head.lod &&
+               (renderQueue[end].material == head.material ||
+                (layered && sharesTextures(head.material, renderQueue[end].material)))) {
+            if (renderQueue[end].material != renderQueue[end - 1].material) m_stats.materialsBatched++;
+            ++end;
+        }
+
+        // The instance stream entry of a packet: its slot, and its material for layered shaders
+        auto streamPacket = [&](const RenderPacket& packet) {
+            if (!layered) return TransformBuffer::streamInstance(packet.transformSlot);
+            return TransformBuffer::streamInstance(packet.transformSlot, RenderIdTable<Material>::get(packet.material)->materialIndex);
+        };
+
+        Mesh* mesh = RenderIdTable<Mesh>::get(head.mesh);
+        bool clustered = meshletCulling && m_cullThisFrame && mesh && !mesh->meshlets.empty() &&
+                         mesh->getLod(head.lod).firstIndex == 0 && (!instanced || m_indirectCommandBuffer != 0);
+
+        if (clustered) {
+            for (size_t i = first; i < end; ++i) {
+                DrawBatch batch = { static_cast<uint32_t>(i), 1, NotInstanced };
+                batch.layered = layered;
+                if (instanced) batch.baseInstance = streamPacket(renderQueue[i]);
+                batch.firstCommand = static_cast<uint32_t>(m_indirectCommands.size());
+                batch.commandCount = cullMeshlets(*mesh, m_frameTransforms[renderQueue[i].transform], batch.baseInstance);
+                if (batch.commandCount == 0) continue;
+                if (instanced) {
+                    addIndirectBatch(batch);
+                } else {
+                    m_batches.push_back(batch);
+                }
+            }
+        } else if (instanced) {
+            DrawBatch batch = { static_cast<uint32_t>(first), static_cast<uint32_t>(end - first), 0 };
+            batch.layered = layered;
+            batch.baseInstance = streamPacket(head);
+            for (size_t i = first + 1; i < end; ++i) {
+                streamPacket(renderQueue[i]);
+            }
+            if (m_indirectCommandBuffer && mesh) {
+                const MeshLod& level = mesh->getLod(head.lod);
+                batch.firstCommand = static_cast<uint32_t>(m_indirectCommands.size());
+                batch.commandCount = 1;
+                m_indirectCommands.push_back({ static_cast<uint32_t>(level.indexCount), batch.count, mesh->getFirstIndex() + level.firstIndex,
+                                               static_cast<uint32_t>(mesh->getBaseVertex()), batch.baseInstance });
+                addIndirectBatch(batch);
+            } else {
+                m_batches.push_back(batch);
+            }
+        } else {
+            // Older shaders take the matrix as a uniform, so each packet is its own draw
+            for (size_t i = first; i < end; ++i) {
+                m_batches.push_back({ static_cast<uint32_t>(i), 1, NotInstanced });
+            }
+        }
+        first = end;
+    }
+
+    // 2. The slots of every batch go up in one upload, and so do the indirect commands
+    TransformBuffer::flushInstances();
+    if (m_indirectCommandBuffer && !m_indirectCommands.empty()) {
+        size_t bytes = m_indirectCommands.size() * sizeof(IndirectCommand);
+        m_indirectOffset = StreamRing::write(m_indirectCommands.data(), bytes, sizeof(uint32_t));
+        if (m_indirectOffset != StreamRing::Invalid) {
+            m_indirectDrawBuffer = StreamRing::getBuffer();
+        } else {
+            m_indirectDrawBuffer = m_indirectCommandBuffer;
+            m_indirectOffset = 0;
+            GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectCommandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, bytes, m_indirectCommands.data(), GL_STREAM_DRAW);
+        }
+    }
+
+    // 3. Draw the batches and what the GPU culling pass kept. A depth prepass lays
+    //    down their depth first; in a deferred frame they only fill the G-buffer.
+    bool prepass = depthPrepass && !m_deferredThisFrame && m_depthShader;
+    if (queries.elapsed) {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        queries.viewportPixels = static_cast<unsigned int>(viewport[2] * viewport[3]);
+        queries.prepass = prepass;
+        queries.issued = true;
+        if (prepass) glQueryCounter(queries.prepassStart, GL_TIMESTAMP);
+    }
+    if (prepass) drawDepthPrepass();
+
+    if (queries.elapsed) {
+        glQueryCounter(queries.opaqueStart, GL_TIMESTAMP);
+        glBeginQuery(GL_SAMPLES_PASSED, queries.opaqueFragments);
+    }
+    m_deferredGeometryPass = m_deferredThisFrame;
+    for (const DrawBatch& batch : m_batches) {
+        drawBatch(batch);
+    }
+    if (m_gpuThisFrame) {
+        drawGpuGroups();
     }
+    if (queries.elapsed) {
+        glEndQuery(GL_SAMPLES_PASSED);
+        glQueryCounter(queries.opaqueEnd, GL_TIMESTAMP);
+    }
+
+    // 4. Back to the usual depth test once the opaque meshes have been shaded
+    if (prepass) {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+
+    // 5. Light the G-buffer into the framebuffer
+    if (m_deferredThisFrame) {
+        m_deferredGeometryPass = false;
+        m_stats.lightVolumes = m_deferred.light(m_clusterLights, m_viewMatrix, m_projectionMatrix, m_viewPos, m_nearPlane, m_farPlane);
+        m_stats.drawCalls += 2;
+
+        // The lighting passes used their own programs, vertex arrays and textures
+        m_lastShader = nullptr;
+        m_lastMaterial = nullptr;
+        m_lastMesh = nullptr;
+    }
+
+    // 6. Distant renderers as impostor quads
+    drawImpostors();
+
+    // 7. This frame's depth becomes the Hi-Z next frame's culling pass tests against
+    if (m_gpuThisFrame) {
+        GpuCuller::captureDepth(m_viewMatrix, m_projectionMatrix);
+        m_lastShader = nullptr; // The Hi-Z passes used their own programs
+    }
+
+    if (queries.elapsed) glEndQuery(GL_TIME_ELAPSED);
+}
+
+void Renderer::readFrameQueries(FrameQueries& queries) {
+    if (!queries.issued) return;
+
+    GLuint64 elapsed = 0, prepassStart = 0, opaqueStart = 0, opaqueEnd = 0, fragments = 0;
+    glGetQueryObjectui64v(queries.elapsed, GL_QUERY_RESULT, &elapsed);
+    glGetQueryObjectui64v(queries.opaqueStart, GL_QUERY_RESULT, &opaqueStart);
+    glGetQueryObjectui64v(queries.opaqueEnd, GL_QUERY_RESULT, &opaqueEnd);
+    glGetQueryObjectui64v(queries.opaqueFragments, GL_QUERY_RESULT, &fragments);
+    if (queries.prepass) {
+        glGetQueryObjectui64v(queries.prepassStart, GL_QUERY_RESULT, &prepassStart);
+        m_stats.depthPrepassGpuMs = static_cast<float>((opaqueStart - prepassStart) / 1.0e6);
+    }
+    m_stats.gpuFrameMs = static_cast<float>(elapsed / 1.0e6);
+    m_stats.opaqueGpuMs = static_cast<float>((opaqueEnd - opaqueStart) / 1.0e6);
+    m_stats.opaqueFragments = static_cast<unsigned int>(fragments);
+    m_stats.overdraw = queries.viewportPixels > 0 ? static_cast<float>(fragments) / queries.viewportPixels : 0.0f;
 }
 
-void Renderer::renderDebug(std::shared_ptr<Model> cubeModel) {
+void Renderer::drawDepthPrepass() {
+    // 1. The batches by their nearest packet (the first one, packets of the same state
+    //    are sorted front to back), so near meshes hide the far ones early
+    m_prepassOrder.resize(m_batches.size());
+    for (size_t i = 0; i < m_batches.size(); ++i) m_prepassOrder[i] = static_cast<uint32_t>(i);
+    std::sort(m_prepassOrder.begin(), m_prepassOrder.end(), [this](uint32_t a, uint32_t b) {
+        return sortKeyDepth(renderQueue[m_batches[a].first].key) < sortKeyDepth(renderQueue[m_batches[b].first].key);
+    });
+
+    // 2. Depth only, from the position streams. Instanced batches need the program that
+    //    reads TransformData, the others the one that takes the model uniform.
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    m_positionsOnly = true;
+    for (uint32_t index : m_prepassOrder) {
+        const DrawBatch& batch = m_batches[index];
+        m_shaderOverride = batch.baseInstance != NotInstanced ? m_depthShaderInstanced.get() : m_depthShader.get();
+        drawBatch(batch);
+    }
+    if (m_gpuThisFrame) {
+        m_shaderOverride = m_depthShaderInstanced.get();
+        drawGpuGroups();
+    }
+    m_positionsOnly = false;
+    m_shaderOverride = nullptr;
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    // 3. The shading pass only draws the nearest surface, and runs its fragment shader once a pixel.
+    // GL_LEQUAL rather than GL_EQUAL: a material depth a hair nearer than the prepass's still shades.
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_FALSE);
+}
+
+void Renderer::drawBatch(const DrawBatch& batch) {
+    const RenderPacket& head = renderQueue[batch.first];
+    Mesh* mesh = RenderIdTable<Mesh>::get(head.mesh);
+    Material* material = RenderIdTable<Material>::get(head.material);
+    if (!mesh || !material || !material->shader) return;
+
+    if (batch.commandCount > 0) {
+        drawIndirect(batch);
+        return;
+    }
+
+    if (batch.baseInstance == NotInstanced) {
+        this->drawMesh(*mesh, *material, m_frameTransforms[head.transform], head.transformSlot, head.lod);
+        return;
+    }
+
+    bindState(*mesh, *material);
+    mesh->drawInstanced(static_cast<int>(batch.count), batch.baseInstance, head.lod, m_positionsOnly);
+    m_stats.drawCalls++;
+    m_stats.instances += batch.count;
+    m_stats.trianglesDrawn += mesh->getLod(head.lod).indexCount / 3 * batch.count;
+}
+
+uint32_t Renderer::cullMeshlets(const Mesh& mesh, const glm::mat4& modelMatrix, uint32_t baseInstance) {
+    // 1. Bring the camera into the mesh's space instead of every meshlet into the world:
+    //    the frustum of projection * view * model has local-space planes
+    Frustum localFrustum(m_projectionMatrix * m_viewMatrix * modelMatrix);
+    glm::vec3 localCamera = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(m_viewPos, 1.0f));
+    bool cones = meshletConeCulling && m_projectionMatrix[2][3] != 0.0f; // Cones need a camera position
+
+    // 2. Test every meshlet, merging neighbours that survive into one run.
+    //    Meshlets are contiguous in the index buffer, so a run is a single range.
+    uint32_t before = static_cast<uint32_t>(m_indirectCommands.size());
+    uint32_t meshFirstIndex = mesh.getFirstIndex();
+    uint32_t baseVertex = static_cast<uint32_t>(mesh.getBaseVertex());
+    bool extending = false;
+    for (const Meshlet& meshlet : mesh.meshlets) {
+        m_stats.meshletsTested++;
+        if (!localFrustum.intersects(meshlet.sphere) || (cones && meshlet.isBackFacing(localCamera))) {
+            m_stats.meshletsCulled++;
+            m_stats.meshletTrianglesCulled += meshlet.indexCount / 3;
+            extending = false;
+            continue;
+        }
+        if (extending) {
+            m_indirectCommands.back().count += meshlet.indexCount;
+        } else {
+            m_indirectCommands.push_back({ meshlet.indexCount, 1, meshFirstIndex + meshlet.firstIndex, baseVertex, baseInstance });
+            extending = true;
+        }
+    }
+    return static_cast<uint32_t>(m_indirectCommands.size()) - before;
+}
+
+void Renderer::addIndirectBatch(const DrawBatch& batch) {
+    if (!m_batches.empty()) {
+        DrawBatch& last = m_batches.back();
+        const RenderPacket& lastHead = renderQueue[last.first];
+        const RenderPacket& head = renderQueue[batch.first];
+        Mesh* lastMesh = RenderIdTable<Mesh>::get(lastHead.mesh);
+        Mesh* mesh = RenderIdTable<Mesh>::get(head.mesh);
+
+        // Same program, material (or textures, see DrawBatch::layered) and VAO, and the
+        // commands follow on
+        bool sameMaterial = lastHead.material == head.material ||
+                            (last.layered && batch.layered && sharesTextures(lastHead.material, head.material));
+        if (last.baseInstance != NotInstanced && last.commandCount > 0 && last.firstCommand + last.commandCount == batch.firstCommand &&
+            sameMaterial && lastMesh && mesh &&
+            GeometryPool::get(lastMesh->geometry).layout == GeometryPool::get(mesh->geometry).layout) {
+            if (lastHead.material != head.material) m_stats.materialsBatched++;
+            last.count += batch.count;
+            last.commandCount += batch.commandCount;
+            return;
+        }
+    }
+    m_batches.push_back(batch);
+}
+
+bool Renderer::sharesTextures(uint32_t material, uint32_t other) const {
+    Material* first = RenderIdTable<Material>::get(material);
+    Material* second = RenderIdTable<Material>::get(other);
+    return first && second && first->sharesTextures(*second);
+}
+
+bool Renderer::getTextureSetKey(Material& material, uint64_t& key) {
+    if (!material.shader || material.materialIndex < 0 || !material.texturesInArrays() ||
+        !getSceneUniforms(*material.shader).usesMaterialLayers) {
+        return false;
+    }
+
+    // Program and the three pages (+1, so a missing map is 0)
+    glm::ivec4 pages = material.getPages() + 1;
+    key = static_cast<uint64_t>(material.shader->renderId & 0xFFFF) << 48 | static_cast<uint64_t>(pages.x & 0xFFFF) << 32 |
+          static_cast<uint64_t>(pages.y & 0xFFFF) << 16 | static_cast<uint64_t>(pages.z & 0xFFFF);
+    return true;
+}
+
+uint32_t Renderer::getSortId(Material& material) {
+    uint64_t key;
+    if (!getTextureSetKey(material, key)) return material.renderId;
+
+    // 1. The set's ID is the renderId of a material in it. If that material was released (its ID
+    // may belong to an unrelated material by now) or left the set, this one takes the set over.
+    auto [entry, added] = m_textureSetIds.emplace(key, material.renderId);
+    if (!added && entry->second != material.renderId) {
+        Material* owner = RenderIdTable<Material>::get(entry->second);
+        uint64_t ownerKey;
+        if (!owner || !getTextureSetKey(*owner, ownerKey) || ownerKey != key) {
+            entry->second = material.renderId;
+        }
+    }
+    return entry->second;
+}
+
+void Renderer::drawIndirect(const DrawBatch& batch) {
+    const RenderPacket& packet = renderQueue[batch.first];
+    Mesh* mesh = RenderIdTable<Mesh>::get(packet.mesh);
+    Material* material = RenderIdTable<Material>::get(packet.material);
+    const SceneUniforms& uniforms = bindState(*mesh, *material);
+
+    if (batch.baseInstance != NotInstanced) {
+        // Every command carries its own range, base vertex and instances, so one call draws them all
+        GLState::bindVertexArray(mesh->getVertexArray(m_positionsOnly));
+        GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectDrawBuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(m_indirectOffset + batch.firstCommand * sizeof(IndirectCommand)),
+                                    static_cast<GLsizei>(batch.commandCount), 0);
+        m_stats.indirectCommands += batch.commandCount;
+    } else {
+        m_lastShader->set(uniforms.model, m_frameTransforms[packet.transform]);
+        m_runCounts.clear();
+        m_runOffsets.clear();
+        m_runBaseVertices.clear();
+        for (uint32_t c = batch.firstCommand; c < batch.firstCommand + batch.commandCount; ++c) {
+            m_runCounts.push_back(static_cast<GLsizei>(m_indirectCommands[c].count));
+            m_runOffsets.push_back((const void*)(m_indirectCommands[c].firstIndex * sizeof(unsigned int)));
+            m_runBaseVertices.push_back(static_cast<GLint>(m_indirectCommands[c].baseVertex));
+        }
+        mesh->drawRanges(m_runCounts.data(), m_runOffsets.data(), m_runBaseVertices.data(), static_cast<int>(batch.commandCount), m_positionsOnly);
+    }
+
+    m_stats.drawCalls++;
+    m_stats.instances += batch.count;
+    for (uint32_t c = batch.firstCommand; c < batch.firstCommand + batch.commandCount; ++c) {
+        m_stats.trianglesDrawn += m_indirectCommands[c].count / 3 * m_indirectCommands[c].instanceCount;
+    }
+}
+
+void Renderer::drawGpuGroups() {
+    for (const GpuCuller::DrawGroup& group : GpuCuller::getDrawOrder()) {
+        Mesh* mesh = RenderIdTable<Mesh>::get(group.mesh);
+        Material* material = RenderIdTable<Material>::get(group.material);
+        if (!mesh || !material || !material->shader) continue;
+
+        bindState(*mesh, *material);
+        GpuCuller::drawGroup(*mesh, group, m_positionsOnly);
+        m_stats.drawCalls++;
+        m_stats.gpuMultiDraws++;
+    }
+    m_stats.gpuInstances = GpuCuller::getInstanceCount();
+}
+
+void Renderer::renderDebug(std::shared_ptr<Model> cubeModel, const FramePacket& packet) {
     if (!cubeModel || cubeModel->meshes.empty() || cubeModel->materials.empty()) return;
     auto mesh = cubeModel->meshes[0];
     auto material = cubeModel->materials[0];
@@ -122,18 +1202,15 @@ void Renderer::renderDebug(std::shared_ptr<Model> cubeModel) {
     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
     // Draw all active lights (fixed size 0.5 box)
-    for (const auto& light : activeLights) {
+    for (const auto& light : packet.lights) {
         glm::mat4 modelMat = glm::translate(glm::mat4(1.0f), light.position);
         modelMat = glm::scale(modelMat, glm::vec3(0.5f));
         this->draw(mesh, material, modelMat);
     }
 
     // Draw all colliders
-    for (auto* collider : ColliderComponent::allColliders) {
-        if (!collider || !collider->owner) continue;
-        glm::mat4 modelMat = collider->owner->worldTransform;
-        modelMat = glm::scale(modelMat, collider->size);
-        this->draw(mesh, material, modelMat);
+    for (const glm::mat4& box : packet.debugBoxes) {
+        this->draw(mesh, material, box);
     }
 
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
@@ -1,5 +1,10 @@
 #include "../include/Shader.h"
+#include "../include/ShaderBindings.h"
+#include "../include/GLState.h"
+#include "../include/ShaderCache.h"
+#include <chrono>
 #include <glm/glm/glm.hpp>
+#include <cstring>
 
 Shader::Shader(const char* vertexPath, const char* fragmentPath) {
     // 1. Retrieve the source code from file paths
@@ -34,74 +39,249 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
     }
     
-    const char* vShaderCode = vertexCode.c_str();
-    const char * fShaderCode = fragmentCode.c_str();
-    
-    // 2. Compile shaders
-    unsigned int vertex, fragment;
+    build(vertexCode, fragmentCode);
+}
+
+std::shared_ptr<Shader> Shader::fromSource(const std::string& vertexCode, const std::string& fragmentCode) {
+    std::shared_ptr<Shader> shader(new Shader());
+    shader->build(vertexCode, fragmentCode);
+    return shader;
+}
+
+std::shared_ptr<Shader> Shader::fromComputeSource(const std::string& computeCode) {
+    std::shared_ptr<Shader> shader(new Shader());
+    shader->link({ { GL_COMPUTE_SHADER, &computeCode, "COMPUTE" } });
+    return shader;
+}
+
+unsigned int Shader::compileStage(unsigned int type, const std::string& code, const char* stageName) {
+    const char* source = code.c_str();
+    unsigned int stage = glCreateShader(type);
+    glShaderSource(stage, 1, &source, NULL);
+    glCompileShader(stage);
+
+    // Print compile errors if any
     int success;
     char infoLog[512];
-    
-    // Vertex Shader
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-    glCompileShader(vertex);
-    
-    // Print compile errors if any
-    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(stage, GL_COMPILE_STATUS, &success);
     if (!success) {
-        glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+        glGetShaderInfoLog(stage, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::" << stageName << "::COMPILATION_FAILED\n" << infoLog << std::endl;
     }
-    
-    // Fragment Shader
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-    
-    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-    }
-    
-    // Shader Program
+    return stage;
+}
+
+void Shader::build(const std::string& vertexCode, const std::string& fragmentCode) {
+    link({ { GL_VERTEX_SHADER, &vertexCode, "VERTEX" }, { GL_FRAGMENT_SHADER, &fragmentCode, "FRAGMENT" } });
+}
+
+void Shader::link(std::initializer_list<Stage> stages) {
     ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    glLinkProgram(ID);
-    
-    // Delete the shaders as they're linked into our program now and no longer necessary
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+
+    // 1. The same sources were built on this driver before: load that binary instead
+    std::string sources;
+    for (const Stage& stage : stages) {
+        sources += *stage.code;
+        sources += '\0';
+    }
+    uint64_t key = ShaderCache::makeKey(sources);
+    if (!ShaderCache::load(ID, key)) {
+        // 2. Compile shaders
+        auto start = std::chrono::steady_clock::now();
+        std::vector<unsigned int> compiled;
+        for (const Stage& stage : stages) {
+            compiled.push_back(compileStage(stage.type, *stage.code, stage.name));
+            glAttachShader(ID, compiled.back());
+        }
+        ShaderCache::prepareLink(ID);
+        glLinkProgram(ID);
+
+        // Delete the shaders as they're linked into our program now and no longer necessary
+        for (unsigned int stage : compiled) {
+            glDeleteShader(stage);
+        }
+
+        GLint linked = GL_FALSE;
+        glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+        if (linked) {
+            ShaderCache::store(ID, key);
+        } else {
+            char infoLog[512];
+            glGetProgramInfoLog(ID, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        }
+        ShaderCache::stats.compiles++;
+        ShaderCache::stats.compileMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // 3. Resolve every uniform location once, up front
+    reflectUniforms();
+    bindUniformBlocks();
+    bindStorageBlocks();
+
+    renderId = RenderIdTable<Shader>::acquire(this);
+}
+
+Shader::~Shader() {
+    RenderIdTable<Shader>::release(renderId);
 }
 
 void Shader::use() { 
-    glUseProgram(ID); 
+    GLState::useProgram(ID); 
+}
+
+ShaderStats Shader::stats;
+
+void Shader::reflectUniforms() {
+    GLint count = 0;
+    GLint maxNameLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+    std::vector<char> nameBuffer(maxNameLength > 0 ? maxNameLength : 1);
+    for (GLint i = 0; i < count; ++i) {
+        GLint arraySize = 0;
+        GLenum type = 0;
+        GLsizei length = 0;
+        glGetActiveUniform(ID, static_cast<GLuint>(i), static_cast<GLsizei>(nameBuffer.size()), &length, &arraySize, &type, nameBuffer.data());
+        std::string name(nameBuffer.data(), length);
+
+        // Uniforms inside uniform blocks have no location of their own
+        GLint location = glGetUniformLocation(ID, name.c_str());
+        if (location < 0) continue;
+
+        // Arrays are reported once as "name[0]". Register every element,
+        // plus the bare name, so lookups work however the caller spells them.
+        size_t bracket = name.rfind("[0]");
+        if (bracket != std::string::npos && bracket + 3 == name.size()) {
+            std::string base = name.substr(0, bracket);
+            uniformTable[base] = static_cast<UniformHandle>(uniforms.size());
+            for (GLint element = 0; element < arraySize; ++element) {
+                std::string elementName = base + "[" + std::to_string(element) + "]";
+                uniformTable[elementName] = static_cast<UniformHandle>(uniforms.size());
+                uniforms.push_back({glGetUniformLocation(ID, elementName.c_str()), false, {}});
+            }
+        } else {
+            uniformTable[name] = static_cast<UniformHandle>(uniforms.size());
+            uniforms.push_back({location, false, {}});
+        }
+    }
+}
+
+void Shader::bindUniformBlocks() {
+    GLint count = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+
+    for (GLint i = 0; i < count; ++i) {
+        char name[128];
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(ID, static_cast<GLuint>(i), sizeof(name), &length, name);
+        uniformBlocks.emplace_back(name, length);
+
+        for (const auto& block : ShaderBindings::UniformBlocks) {
+            if (uniformBlocks.back() == block.name) {
+                glUniformBlockBinding(ID, static_cast<GLuint>(i), block.binding);
+            }
+        }
+    }
+}
+
+void Shader::bindStorageBlocks() {
+    // Program interface queries and storage blocks only exist from GL 4.3
+    if (!GLAD_GL_VERSION_4_3) return;
+
+    GLint count = 0;
+    glGetProgramInterfaceiv(ID, GL_SHADER_STORAGE_BLOCK, GL_ACTIVE_RESOURCES, &count);
+
+    for (GLint i = 0; i < count; ++i) {
+        char name[128];
+        GLsizei length = 0;
+        glGetProgramResourceName(ID, GL_SHADER_STORAGE_BLOCK, static_cast<GLuint>(i), sizeof(name), &length, name);
+        storageBlocks.emplace_back(name, length);
+
+        for (const auto& block : ShaderBindings::StorageBlocks) {
+            if (storageBlocks.back() == block.name) {
+                glShaderStorageBlockBinding(ID, static_cast<GLuint>(i), block.binding);
+            }
+        }
+    }
+}
+
+bool Shader::hasStorageBlock(const std::string &name) const {
+    for (const auto& block : storageBlocks) {
+        if (block == name) return true;
+    }
+    return false;
+}
+
+bool Shader::hasUniformBlock(const std::string &name) const {
+    for (const auto& block : uniformBlocks) {
+        if (block == name) return true;
+    }
+    return false;
+}
+
+UniformHandle Shader::getUniform(const std::string &name) const {
+    stats.lookups++;
+    auto it = uniformTable.find(name);
+    return it != uniformTable.end() ? it->second : -1;
+}
+
+bool Shader::updateShadow(UniformHandle handle, const void* data, size_t bytes) const {
+    if (handle < 0) return false;
+
+    UniformSlot& slot = uniforms[handle];
+    if (slot.hasValue && std::memcmp(slot.shadow, data, bytes) == 0) {
+        stats.skippedUploads++;
+        return false;
+    }
+
+    std::memcpy(slot.shadow, data, bytes);
+    slot.hasValue = true;
+    stats.uploads++;
+    return true;
+}
+
+void Shader::set(UniformHandle handle, int value) const {
+    if (updateShadow(handle, &value, sizeof(value))) glUniform1i(uniforms[handle].location, value);
+}
+void Shader::set(UniformHandle handle, float value) const {
+    if (updateShadow(handle, &value, sizeof(value))) glUniform1f(uniforms[handle].location, value);
+}
+void Shader::set(UniformHandle handle, const glm::vec2 &value) const {
+    if (updateShadow(handle, &value, sizeof(value))) glUniform2fv(uniforms[handle].location, 1, glm::value_ptr(value));
+}
+void Shader::set(UniformHandle handle, const glm::ivec2 &value) const {
+    if (updateShadow(handle, &value, sizeof(value))) glUniform2iv(uniforms[handle].location, 1, glm::value_ptr(value));
+}
+void Shader::set(UniformHandle handle, const glm::vec3 &value) const {
+    if (updateShadow(handle, &value, sizeof(value))) glUniform3fv(uniforms[handle].location, 1, glm::value_ptr(value));
+}
+void Shader::set(UniformHandle handle, const glm::vec4 &value) const {
+    if (updateShadow(handle, &value, sizeof(value))) glUniform4fv(uniforms[handle].location, 1, glm::value_ptr(value));
+}
+void Shader::set(UniformHandle handle, const glm::mat4 &value) const {
+    if (updateShadow(handle, &value, sizeof(value))) glUniformMatrix4fv(uniforms[handle].location, 1, GL_FALSE, glm::value_ptr(value));
 }
 
-void Shader::setBool(const std::string &name, bool value) const {         
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+void Shader::setBool(const std::string &name, bool value) const {
+    set(getUniform(name), static_cast<int>(value));
 }
-void Shader::setInt(const std::string &name, int value) const { 
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+void Shader::setInt(const std::string &name, int value) const {
+    set(getUniform(name), value);
 }
-void Shader::setFloat(const std::string &name, float value) const { 
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+void Shader::setFloat(const std::string &name, float value) const {
+    set(getUniform(name), value);
 }
 void Shader::setVec2(const std::string &name, const glm::vec2 &value) const {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    set(getUniform(name), value);
 }
 void Shader::setVec2(const std::string &name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+    set(getUniform(name), glm::vec2(x, y));
 }
 void Shader::setFloat(const std::string &name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    set(getUniform(name), glm::vec3(x, y, z));
 }
 void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const {
-    // 1. Find where the variable is located in the shader memory
-    unsigned int uniformLocation = glGetUniformLocation(ID, name.c_str());
-    
-    // 2. Send the matrix data to that location
-    glUniformMatrix4fv(uniformLocation, 1, GL_FALSE, glm::value_ptr(mat));
-}
\ No newline at end of file
+    set(getUniform(name), mat);
+}
@@ -0,0 +1,161 @@
+#include "../include/ShaderCache.h"
+#include <glad/glad.h>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+ShaderCacheStats ShaderCache::stats;
+bool ShaderCache::available = false;
+std::string ShaderCache::directory;
+std::string ShaderCache::driver;
+
+static const char* DriverFile = "driver.txt";
+
+bool ShaderCache::init(const std::string& cacheDirectory) {
+    directory = cacheDirectory;
+    available = false;
+
+    // glProgramBinary is GL 4.1, and a driver may still offer no format at all
+    if (!GLAD_GL_VERSION_4_1) return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0) return false;
+
+    // 1. The driver string goes into every key: a binary only loads on the driver that made it
+    auto glString = [](GLenum name) {
+        const GLubyte* value = glGetString(name);
+        return value ? std::string(reinterpret_cast<const char*>(value)) : std::string();
+    };
+    driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION) + "\n" +
+             glString(GL_SHADING_LANGUAGE_VERSION);
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cout << "Error: couldn't create the shader cache directory " << directory << ": " << error.message() << std::endl;
+        return false;
+    }
+
+    // 2. Binaries of another driver (an update, another GPU) are no use, start over
+    std::string stored;
+    std::ifstream in(directory + "/" + DriverFile);
+    if (in) {
+        std::stringstream contents;
+        contents << in.rdbuf();
+        stored = contents.str();
+    }
+    in.close();
+    if (stored != driver) {
+        clear();
+        std::ofstream out(directory + "/" + DriverFile, std::ios::trunc);
+        out << driver;
+    }
+
+    available = true;
+    return true;
+}
+
+void ShaderCache::clear() {
+    if (directory.empty()) return;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        std::filesystem::path extension = entry.path().extension();
+        if (extension == ".bin" || extension == ".tmp") std::filesystem::remove(entry.path(), error);
+    }
+}
+
+uint64_t ShaderCache::makeKey(const std::string& sources) {
+    // FNV-1a over the driver string and the sources
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](const std::string& text) {
+        for (unsigned char c : text) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+    };
+    add(driver);
+    add(std::string(1, '\0'));
+    add(sources);
+    return hash;
+}
+
+std::string ShaderCache::pathOf(uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return directory + "/" + name;
+}
+
+void ShaderCache::prepareLink(unsigned int program) {
+    if (available) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+bool ShaderCache::load(unsigned int program, uint64_t key) {
+    if (!available) return false;
+    auto start = std::chrono::steady_clock::now();
+
+    std::string path = pathOf(key);
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    // 1. A file that doesn't look like ours (or is cut short) is removed and the program compiled
+    FileHeader header = {};
+    std::vector<char> binary;
+    bool valid = static_cast<bool>(file.read(reinterpret_cast<char*>(&header), sizeof(header))) &&
+                 header.magic == Magic && header.version == Version && header.key == key && header.length > 0;
+    if (valid) {
+        binary.resize(header.length);
+        valid = static_cast<bool>(file.read(binary.data(), header.length));
+    }
+    file.close();
+
+    // 2. The driver may still refuse it (its own checks are stricter than the driver string)
+    GLint linked = GL_FALSE;
+    if (valid) {
+        glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(header.length));
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    }
+    if (!linked) {
+        std::error_code error;
+        std::filesystem::remove(path, error);
+        stats.rejected++;
+        return false;
+    }
+
+    stats.hits++;
+    stats.loadMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+void ShaderCache::store(unsigned int program, uint64_t key) {
+    if (!available) return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> binary(static_cast<size_t>(length));
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0) return;
+
+    // Written to a temporary name first, so a crash never leaves half a binary under the real one
+    std::string path = pathOf(key);
+    FileHeader header = { Magic, Version, format, static_cast<uint32_t>(written), key };
+    {
+        std::ofstream file(path + ".tmp", std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), written);
+        if (!file) {
+            std::cout << "Error: couldn't write the shader binary " << path << std::endl;
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(path + ".tmp", path, error);
+    if (!error) stats.stored++;
+}
@@ -0,0 +1,128 @@
+#include "../include/ShaderPreprocessor.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static bool readFile(const std::string& path, std::string& contents) {
+    std::ifstream file(path);
+    if (!file) return false;
+    std::stringstream stream;
+    stream << file.rdbuf();
+    contents = stream.str();
+    return true;
+}
+
+bool ShaderPreprocessor::loadFile(const std::string& path, std::string& out, std::vector<std::string>* files) {
+    std::string source;
+    if (!readFile(path, source)) {
+        std::cout << "Error: couldn't read shader file " << path << std::endl;
+        return false;
+    }
+    Context context;
+    context.root = std::filesystem::path(path).lexically_normal().string();
+    return expand(source, directoryOf(path), context, out, files);
+}
+
+bool ShaderPreprocessor::expand(const std::string& source, const std::string& directory, std::string& out,
+                                std::vector<std::string>* files) {
+    Context context;
+    return expand(source, directory, context, out, files);
+}
+
+bool ShaderPreprocessor::expand(const std::string& source, const std::string& directory, Context& context,
+                                std::string& out, std::vector<std::string>* files) {
+    out.clear();
+    bool expanded = expandInto(source, directory, 0, context, out);
+    if (files) *files = context.files;
+    return expanded;
+}
+
+bool ShaderPreprocessor::expandInto(const std::string& source, const std::string& directory, int sourceNumber,
+                                    Context& context, std::string& out) {
+    std::istringstream lines(source);
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(lines, line)) {
+        lineNumber++;
+        std::string name = includeName(line);
+        if (name.empty()) {
+            out += line;
+            out += '\n';
+            continue;
+        }
+
+        // 1. Each file once: a second include of it (or a cycle back to it, the root file included) is dropped
+        std::string path = std::filesystem::path(directory.empty() ? name : directory + "/" + name).lexically_normal().string();
+        if (path == context.root || std::find(context.files.begin(), context.files.end(), path) != context.files.end()) {
+            out += '\n'; // Keeps the line count
+            continue;
+        }
+        std::string included;
+        if (!readFile(path, included)) {
+            std::cout << "Error: couldn't read shader include " << path << " (line " << lineNumber << " of source string "
+                      << sourceNumber << ")" << std::endl;
+            return false;
+        }
+        context.files.push_back(path);
+
+        // 2. Its lines count as its own source string, then numbering goes back to ours
+        int includedNumber = static_cast<int>(context.files.size());
+        out += "#line 1 " + std::to_string(includedNumber) + "\n";
+        if (!expandInto(included, directoryOf(path), includedNumber, context, out)) return false;
+        out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(sourceNumber) + "\n";
+    }
+    return true;
+}
+
+std::string ShaderPreprocessor::includeName(const std::string& line) {
+    size_t i = line.find_first_not_of(" \t");
+    if (i == std::string::npos || line[i] != '#') return std::string();
+    i = line.find_first_not_of(" \t", i + 1);
+    if (i == std::string::npos || line.compare(i, 7, "include") != 0) return std::string();
+    size_t open = line.find('"', i + 7);
+    if (open == std::string::npos) return std::string();
+    size_t close = line.find('"', open + 1);
+    if (close == std::string::npos || close == open + 1) return std::string();
+    return line.substr(open + 1, close - open - 1);
+}
+
+std::string ShaderPreprocessor::directoryOf(const std::string& path) {
+    return std::filesystem::path(path).parent_path().string();
+}
+
+std::string ShaderPreprocessor::addDefines(const std::string& source, const std::vector<std::string>& defines) {
+    if (defines.empty()) return source;
+
+    std::string block;
+    for (const std::string& define : defines) {
+        block += "#define " + define + "\n";
+    }
+
+    // 1. After the #version line, which has to come first
+    size_t version = source.find("#version");
+    if (version != std::string::npos) {
+        size_t end = source.find('\n', version);
+        if (end == std::string::npos) return source + "\n" + block;
+        int line = 1 + static_cast<int>(std::count(source.begin(), source.begin() + end, '\n'));
+        return source.substr(0, end + 1) + block + "#line " + std::to_string(line + 1) + "\n" + source.substr(end + 1);
+    }
+
+    // 2. No #version: at the top
+    return block + "#line 1\n" + source;
+}
+
+bool ShaderPreprocessor::mentions(const std::string& source, const std::string& identifier) {
+    auto isIdentifier = [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; };
+    size_t at = source.find(identifier);
+    while (at != std::string::npos) {
+        size_t end = at + identifier.size();
+        bool startsWord = at == 0 || !isIdentifier(source[at - 1]);
+        bool endsWord = end == source.size() || !isIdentifier(source[end]);
+        if (startsWord && endsWord) return true;
+        at = source.find(identifier, at + 1);
+    }
+    return false;
+}
@@ -0,0 +1,60 @@
+#include "../include/ShaderVariants.h"
+#include "../include/ShaderPreprocessor.h"
+#include <chrono>
+#include <vector>
+
+ShaderVariantStats ShaderVariants::stats;
+uint32_t ShaderVariants::contextFeatures = 0;
+
+const char* ShaderVariants::defineOf(int featureBit) {
+    static const char* const defines[FeatureCount] = {
+        "HAS_DIFFUSE_MAP", "HAS_SPECULAR_MAP", "HAS_NORMAL_MAP", "TRANSFORM_DATA", "CLUSTERED_LIGHTS",
+    };
+    return featureBit >= 0 && featureBit < FeatureCount ? defines[featureBit] : "";
+}
+
+ShaderVariants::ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath) {
+    auto start = std::chrono::steady_clock::now();
+    valid = ShaderPreprocessor::loadFile(vertexPath, vertexCode) && ShaderPreprocessor::loadFile(fragmentPath, fragmentCode);
+    findUsedFeatures();
+    stats.sets++;
+    stats.buildMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::shared_ptr<ShaderVariants> ShaderVariants::fromSource(const std::string& vertexCode, const std::string& fragmentCode) {
+    std::shared_ptr<ShaderVariants> set(new ShaderVariants());
+    set->valid = ShaderPreprocessor::expand(vertexCode, "", set->vertexCode) &&
+                 ShaderPreprocessor::expand(fragmentCode, "", set->fragmentCode);
+    set->findUsedFeatures();
+    stats.sets++;
+    return set;
+}
+
+void ShaderVariants::findUsedFeatures() {
+    usedFeatures = 0;
+    for (int bit = 0; bit < FeatureCount; ++bit) {
+        if (ShaderPreprocessor::mentions(vertexCode, defineOf(bit)) || ShaderPreprocessor::mentions(fragmentCode, defineOf(bit))) {
+            usedFeatures |= 1u << bit;
+        }
+    }
+}
+
+std::shared_ptr<Shader> ShaderVariants::get(uint32_t features) {
+    // 1. Features the sources don't test would only make copies of the same program
+    uint32_t key = features & usedFeatures;
+    auto found = variants.find(key);
+    if (found != variants.end()) return found->second;
+
+    // 2. First request for this combination: its #defines go after #version
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> defines;
+    for (int bit = 0; bit < FeatureCount; ++bit) {
+        if (key & (1u << bit)) defines.push_back(defineOf(bit));
+    }
+    std::shared_ptr<Shader> shader = Shader::fromSource(ShaderPreprocessor::addDefines(vertexCode, defines),
+                                                        ShaderPreprocessor::addDefines(fragmentCode, defines));
+    variants[key] = shader;
+    stats.variants++;
+    stats.buildMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return shader;
+}
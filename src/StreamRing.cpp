@@ -0,0 +1,122 @@
+#include "../include/StreamRing.h"
+#include "../include/GLState.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+StreamRingStats StreamRing::stats;
+unsigned int StreamRing::buffer = 0;
+uint8_t* StreamRing::mapping = nullptr;
+size_t StreamRing::regionBytes = StreamRing::InitialRegionBytes;
+int StreamRing::region = 0;
+size_t StreamRing::head = 0;
+size_t StreamRing::needed = 0;
+bool StreamRing::frameStarted = false;
+void* StreamRing::fences[StreamRing::RegionCount] = {};
+size_t StreamRing::uniformAlignment = 256;
+size_t StreamRing::storageAlignment = 256;
+unsigned int StreamRing::grows = 0;
+
+bool StreamRing::init() {
+    if (buffer) return true;
+
+    // Immutable storage is GL 4.4
+    if (!GLAD_GL_VERSION_4_4) return false;
+
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment > 0) uniformAlignment = static_cast<size_t>(alignment);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment > 0) storageAlignment = static_cast<size_t>(alignment);
+
+    return create();
+}
+
+bool StreamRing::create() {
+    glGenBuffers(1, &buffer);
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+
+    // Coherent: what the CPU writes is visible to commands issued afterwards, no flush calls
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLsizeiptr size = static_cast<GLsizeiptr>(regionBytes * RegionCount);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+    mapping = static_cast<uint8_t*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+    if (!mapping) {
+        std::cout << "Error: couldn't map the stream ring, streaming through glBufferData instead." << std::endl;
+        glDeleteBuffers(1, &buffer);
+        GLState::invalidate();
+        buffer = 0;
+        return false;
+    }
+    return true;
+}
+
+void StreamRing::beginFrame() {
+    if (!buffer) return;
+
+    // 1. The GPU reads what the last frame wrote until its commands are done
+    if (frameStarted) {
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // 2. That frame ran out: bigger regions in a new buffer. Nothing new goes into the old
+    //    one, and GL keeps its storage alive until the draws that read it are done.
+    if (needed > regionBytes) {
+        while (regionBytes < needed) regionBytes *= 2;
+        for (void*& fence : fences) {
+            if (fence) glDeleteSync(static_cast<GLsync>(fence));
+            fence = nullptr;
+        }
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glDeleteBuffers(1, &buffer);
+        GLState::invalidate(); // The deleted name can come back
+        grows++;
+        if (!create()) return;
+    }
+
+    // 3. Next region, once the frame that used it RegionCount frames ago is done with it
+    region = (region + 1) % RegionCount;
+    head = 0;
+    needed = 0;
+    frameStarted = true;
+
+    GLsync fence = static_cast<GLsync>(fences[region]);
+    if (!fence) return;
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        auto start = std::chrono::steady_clock::now();
+        stats.fenceWaits++;
+        do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms at a time
+        } while (status == GL_TIMEOUT_EXPIRED);
+        stats.stallMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    glDeleteSync(fence);
+    fences[region] = nullptr;
+}
+
+size_t StreamRing::allocate(size_t bytes, size_t alignment) {
+    if (!buffer || !frameStarted) return Invalid;
+
+    size_t start = (head + alignment - 1) & ~(alignment - 1);
+    needed = std::max(needed, start + bytes);
+    if (start + bytes > regionBytes) {
+        needed += bytes; // Later allocations will also want room
+        stats.overflows++;
+        return Invalid;
+    }
+
+    stats.allocations++;
+    stats.bytes += static_cast<unsigned int>(start + bytes - head);
+    head = start + bytes;
+    return region * regionBytes + start;
+}
+
+size_t StreamRing::write(const void* data, size_t bytes, size_t alignment) {
+    size_t offset = allocate(bytes, alignment);
+    if (offset != Invalid) std::memcpy(mapping + offset, data, bytes);
+    return offset;
+}
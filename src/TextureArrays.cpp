@@ -0,0 +1,134 @@
+#include "../include/TextureArrays.h"
+#include "../include/GLState.h"
+#include <glad/glad.h>
+#include <algorithm>
+
+int TextureArrays::maxLayers = 0;
+unsigned int TextureArrays::leftOut = 0;
+
+namespace {
+
+bool isPowerOfTwo(int value) {
+    return value > 0 && (value & (value - 1)) == 0;
+}
+
+// Levels glGenerateMipmap makes for that size
+int mipLevels(int width, int height) {
+    int levels = 1;
+    for (int size = std::max(width, height); size > 1; size >>= 1) levels++;
+    return levels;
+}
+
+unsigned int bytesPerTexel(unsigned int internalFormat) {
+    switch (internalFormat) {
+        case GL_R8: return 1;
+        case GL_RGB8: return 3;
+        default: return 4;
+    }
+}
+
+}
+
+TextureArrays::Ref TextureArrays::add(unsigned int texture, int width, int height, unsigned int internalFormat) {
+    std::vector<Page>& pages = pageList();
+    Ref ref;
+
+    // 1. Odd sizes and formats keep their own texture only
+    bool fits = isPowerOfTwo(width) && isPowerOfTwo(height) && width >= MinSize && height >= MinSize &&
+                width <= MaxSize && height <= MaxSize &&
+                (internalFormat == GL_RGB8 || internalFormat == GL_RGBA8 || internalFormat == GL_R8);
+    if (!texture || !fits || !GLAD_GL_VERSION_4_3) {
+        leftOut++;
+        return ref;
+    }
+
+    // 2. A free layer in a page of the same kind
+    int page = findPage(width, height, internalFormat);
+    if (page == Invalid) {
+        leftOut++;
+        return ref;
+    }
+    ref.page = page;
+    ref.layer = pages[page].freeLayers.back();
+    pages[page].freeLayers.pop_back();
+
+    // 3. Copy every level on the GPU; the pixels never come back to the CPU
+    for (int level = 0; level < pages[page].levels; ++level) {
+        int levelWidth = std::max(width >> level, 1);
+        int levelHeight = std::max(height >> level, 1);
+        glCopyImageSubData(texture, GL_TEXTURE_2D, level, 0, 0, 0,
+                           pages[page].texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, ref.layer,
+                           levelWidth, levelHeight, 1);
+    }
+    return ref;
+}
+
+int TextureArrays::findPage(int width, int height, unsigned int internalFormat) {
+    std::vector<Page>& pages = pageList();
+    for (size_t i = 0; i < pages.size(); ++i) {
+        const Page& page = pages[i];
+        if (page.width == width && page.height == height && page.internalFormat == internalFormat && !page.freeLayers.empty()) {
+            return static_cast<int>(i);
+        }
+    }
+
+    if (maxLayers == 0) {
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+        if (maxLayers <= 0) maxLayers = 1;
+    }
+
+    // 1. A new page with the same sampling as Texture
+    Page page;
+    page.width = width;
+    page.height = height;
+    page.internalFormat = internalFormat;
+    page.levels = mipLevels(width, height);
+    page.layers = std::min(LayersPerPage, maxLayers);
+    glGenTextures(1, &page.texture);
+    GLState::bindTexture(0, GL_TEXTURE_2D_ARRAY, page.texture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, page.levels, internalFormat, width, height, page.layers);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (internalFormat == GL_R8) {
+        // Grayscale reads as (R, R, R, 1), like the single textures
+        GLint swizzleMask[] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+        glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, swizzleMask);
+    }
+
+    // 2. Layers are handed out from the front
+    for (int layer = page.layers - 1; layer >= 0; --layer) {
+        page.freeLayers.push_back(layer);
+    }
+    pages.push_back(page);
+    return static_cast<int>(pages.size()) - 1;
+}
+
+void TextureArrays::release(const Ref& ref) {
+    std::vector<Page>& pages = pageList();
+    if (ref.page < 0 || ref.page >= static_cast<int>(pages.size())) return;
+    pages[ref.page].freeLayers.push_back(ref.layer);
+}
+
+void TextureArrays::bind(int page, unsigned int unit) {
+    std::vector<Page>& pages = pageList();
+    if (page < 0 || page >= static_cast<int>(pages.size())) return;
+    GLState::bindTexture(unit, GL_TEXTURE_2D_ARRAY, pages[page].texture);
+}
+
+TextureArrayStats TextureArrays::getStats() {
+    std::vector<Page>& pages = pageList();
+    TextureArrayStats stats;
+    stats.pages = static_cast<unsigned int>(pages.size());
+    stats.leftOut = leftOut;
+    for (const Page& page : pages) {
+        stats.layers += page.layers;
+        stats.usedLayers += page.layers - static_cast<unsigned int>(page.freeLayers.size());
+
+        // Each level is a quarter of the one above, so the chain is about 4/3 of level 0
+        unsigned int levelBytes = static_cast<unsigned int>(page.width * page.height) * bytesPerTexel(page.internalFormat);
+        stats.bytes += levelBytes * page.layers / 3 * 4;
+    }
+    return stats;
+}
@@ -0,0 +1,254 @@
+#include "../include/TransformBuffer.h"
+#include "../include/ShaderBindings.h"
+#include "../include/GLState.h"
+#include "../include/StreamRing.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstring>
+
+TransformStats TransformBuffer::stats;
+unsigned int TransformBuffer::ssbo = 0;
+unsigned int TransformBuffer::streamBuffer = 0;
+int TransformBuffer::gpuCapacity = 0;
+size_t TransformBuffer::streamCapacity = 0;
+std::vector<glm::mat4> TransformBuffer::shadow;
+std::vector<uint8_t> TransformBuffer::dirtyFlags;
+std::vector<int> TransformBuffer::dirtySlots;
+std::vector<int> TransformBuffer::freeSlots;
+size_t TransformBuffer::slotCount = 0;
+std::mutex TransformBuffer::slotMutex;
+std::vector<int> TransformBuffer::transientSlots;
+size_t TransformBuffer::transientUsed = 0;
+std::vector<uint32_t> TransformBuffer::instanceStream;
+size_t TransformBuffer::instancesFlushed = 0;
+bool TransformBuffer::streamInRing = false;
+size_t TransformBuffer::ringChunk = 0;
+size_t TransformBuffer::ringChunkUsed = 0;
+size_t TransformBuffer::ringChunkSize = 0;
+std::vector<unsigned int> TransformBuffer::streamVAOs;
+unsigned int TransformBuffer::pointedBuffer = 0;
+unsigned int TransformBuffer::pointedRingGrows = 0;
+
+bool TransformBuffer::init() {
+    if (ssbo) return true;
+
+    // Storage buffers are GL 4.3, base-instance draws GL 4.2
+    if (!GLAD_GL_VERSION_4_3) return false;
+
+    glGenBuffers(1, &ssbo);
+    gpuCapacity = 0;
+    grow();
+
+    glGenBuffers(1, &streamBuffer);
+    streamCapacity = InitialCapacity;
+    GLState::bindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(uint32_t) * streamCapacity, nullptr, GL_STREAM_DRAW);
+    return true;
+}
+
+void TransformBuffer::grow() {
+    int capacity = std::max(gpuCapacity, InitialCapacity);
+    while (capacity < static_cast<int>(shadow.size())) capacity *= 2;
+
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::mat4) * capacity, nullptr, GL_DYNAMIC_DRAW);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, ShaderBindings::TransformData, ssbo);
+
+    gpuCapacity = capacity;
+
+    // The old contents are gone, so everything handed out goes up again
+    dirtySlots.clear();
+    for (size_t i = 0; i < shadow.size(); ++i) {
+        dirtyFlags[i] = 1;
+        dirtySlots.push_back(static_cast<int>(i));
+    }
+}
+
+int TransformBuffer::allocate() {
+    std::lock_guard<std::mutex> lock(slotMutex);
+    if (!freeSlots.empty()) {
+        int slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+    return static_cast<int>(slotCount++);
+}
+
+void TransformBuffer::release(int slot) {
+    std::lock_guard<std::mutex> lock(slotMutex);
+    if (slot < 0 || slot >= static_cast<int>(slotCount)) return;
+    freeSlots.push_back(slot);
+}
+
+size_t TransformBuffer::prepareSlots() {
+    size_t count;
+    {
+        std::lock_guard<std::mutex> lock(slotMutex);
+        count = slotCount;
+    }
+    // New slots start as the identity, like before anything was stored
+    if (shadow.size() < count) {
+        shadow.resize(count, glm::mat4(1.0f));
+        dirtyFlags.resize(count, 0);
+    }
+    return count;
+}
+
+int TransformBuffer::allocateTransient() {
+    if (transientUsed == transientSlots.size()) {
+        transientSlots.push_back(allocate());
+        prepareSlots();
+    }
+    return transientSlots[transientUsed++];
+}
+
+void TransformBuffer::beginFrame() {
+    transientUsed = 0;
+    instanceStream.clear();
+    instancesFlushed = 0;
+
+    // Back to the ring if last frame ran out of it (or it was replaced)
+    streamInRing = streamBuffer && StreamRing::isAvailable();
+    ringChunkUsed = 0;
+    ringChunkSize = 0;
+    pointStreamVAOs();
+}
+
+void TransformBuffer::reserveInstances(size_t count) {
+    if (!streamInRing || ringChunkSize - ringChunkUsed >= count) return;
+
+    // 1. A new chunk; entries already streamed stay where they are
+    size_t entries = std::max(count, MinRingChunk);
+    size_t offset = StreamRing::allocate(sizeof(uint32_t) * entries, sizeof(uint32_t));
+    if (offset != StreamRing::Invalid) {
+        ringChunk = offset / sizeof(uint32_t);
+        ringChunkUsed = 0;
+        ringChunkSize = entries;
+        return;
+    }
+
+    // 2. The ring is full: the rest of the frame goes through the stream buffer. Only draws
+    //    already issued read the ring entries, so the VAOs can be pointed away now.
+    streamInRing = false;
+    pointStreamVAOs();
+}
+
+unsigned int TransformBuffer::streamInstance(int slot, int material) {
+    uint32_t entry = static_cast<uint32_t>(slot);
+    if (material >= 0) entry |= static_cast<uint32_t>(material) << ShaderBindings::TransformIndexBits;
+
+    reserveInstances(1);
+    if (streamInRing) {
+        uint32_t* entries = static_cast<uint32_t*>(StreamRing::map(sizeof(uint32_t) * ringChunk));
+        entries[ringChunkUsed] = entry;
+        stats.instanceBytes += sizeof(uint32_t);
+        return static_cast<unsigned int>(ringChunk + ringChunkUsed++);
+    }
+    instanceStream.push_back(entry);
+    return static_cast<unsigned int>(instanceStream.size() - 1);
+}
+
+void TransformBuffer::flushInstances() {
+    if (!streamBuffer || instancesFlushed == instanceStream.size()) return;
+
+    GLState::bindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+
+    // First flush of the frame: orphan the store, so we don't wait on last frame's draws.
+    // Re-specifying it keeps the buffer name, so every VAO that points at it stays valid.
+    if (instancesFlushed == 0 || instanceStream.size() > streamCapacity) {
+        while (streamCapacity < instanceStream.size()) streamCapacity *= 2;
+        glBufferData(GL_ARRAY_BUFFER, sizeof(uint32_t) * streamCapacity, nullptr, GL_STREAM_DRAW);
+        instancesFlushed = 0;
+    }
+
+    GLsizeiptr bytes = sizeof(uint32_t) * (instanceStream.size() - instancesFlushed);
+    glBufferSubData(GL_ARRAY_BUFFER, sizeof(uint32_t) * instancesFlushed, bytes, &instanceStream[instancesFlushed]);
+    stats.instanceBytes += static_cast<unsigned int>(bytes);
+    instancesFlushed = instanceStream.size();
+}
+
+void TransformBuffer::set(int slot, const glm::mat4& transform) {
+    if (slot >= static_cast<int>(shadow.size())) prepareSlots();
+    if (store(slot, transform)) markDirty(slot);
+}
+
+bool TransformBuffer::store(int slot, const glm::mat4& transform) {
+    if (slot < 0 || slot >= static_cast<int>(shadow.size())) return false;
+    if (std::memcmp(&shadow[slot], &transform, sizeof(glm::mat4)) == 0) return false;
+
+    shadow[slot] = transform;
+    if (dirtyFlags[slot]) return false;
+    dirtyFlags[slot] = 1;
+    return true;
+}
+
+void TransformBuffer::upload() {
+    if (!ssbo) return;
+
+    if (static_cast<int>(shadow.size()) > gpuCapacity) {
+        grow();
+    }
+    if (dirtySlots.empty()) return;
+
+    std::sort(dirtySlots.begin(), dirtySlots.end());
+    stats.dirtySlots += static_cast<unsigned int>(dirtySlots.size());
+
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+
+    // Walk the sorted slots and send each run (gaps up to MergeGap included) in one call
+    size_t i = 0;
+    while (i < dirtySlots.size()) {
+        int first = dirtySlots[i];
+        int last = first;
+        while (i + 1 < dirtySlots.size() && dirtySlots[i + 1] - last <= MergeGap) {
+            last = dirtySlots[++i];
+        }
+        ++i;
+
+        GLsizeiptr bytes = sizeof(glm::mat4) * (last - first + 1);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::mat4) * first, bytes, &shadow[first]);
+        stats.bytesUploaded += static_cast<unsigned int>(bytes);
+        stats.uploadSpans++;
+    }
+
+    for (int slot : dirtySlots) dirtyFlags[slot] = 0;
+    dirtySlots.clear();
+}
+
+void TransformBuffer::bindIndexAttribute(unsigned int vertexArray) {
+    GLState::bindVertexArray(vertexArray);
+    GLuint location = ShaderBindings::TransformIndexAttribute;
+    if (!streamBuffer) {
+        // No storage buffers: the attribute is unused, give it a harmless constant
+        glDisableVertexAttribArray(location);
+        glVertexAttribI4ui(location, 0, 0, 0, 0);
+        return;
+    }
+
+    if (std::find(streamVAOs.begin(), streamVAOs.end(), vertexArray) == streamVAOs.end()) {
+        streamVAOs.push_back(vertexArray);
+    }
+
+    GLState::bindBuffer(GL_ARRAY_BUFFER, currentStreamBuffer());
+    glVertexAttribIPointer(location, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void*)0);
+    glVertexAttribDivisor(location, 1);
+    glEnableVertexAttribArray(location);
+}
+
+unsigned int TransformBuffer::currentStreamBuffer() {
+    return streamInRing ? StreamRing::getBuffer() : streamBuffer;
+}
+
+void TransformBuffer::pointStreamVAOs() {
+    unsigned int buffer = currentStreamBuffer();
+    if (buffer == pointedBuffer && StreamRing::getGrowCount() == pointedRingGrows) return;
+    pointedBuffer = buffer;
+    pointedRingGrows = StreamRing::getGrowCount();
+
+    GLState::bindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (unsigned int vertexArray : streamVAOs) {
+        GLState::bindVertexArray(vertexArray);
+        glVertexAttribIPointer(ShaderBindings::TransformIndexAttribute, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void*)0);
+    }
+    GLState::bindVertexArray(0);
+}
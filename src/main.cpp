@@ -1,16 +1,45 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <chrono>
+#include <cstring>
 #include <iostream>
 #include "../include/Game.h"
+#include "../include/RenderThread.h"
+#include "../include/ShaderCache.h"
+#include "../include/ShaderVariants.h"
+
+int main(int argc, char** argv) {
+    // --sync draws on the main thread, right after each update.
+    // --gpu-culling culls and builds the draws on the GPU (see GpuCuller). It reads the live
+    //   scene, so it implies --sync.
+    // --clear-shader-cache starts without stored program binaries (a cold start).
+    bool synchronous = false;
+    bool gpuCulling = false;
+    bool clearShaderCache = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--sync") == 0) synchronous = true;
+        if (std::strcmp(argv[i], "--gpu-culling") == 0) gpuCulling = true;
+        if (std::strcmp(argv[i], "--clear-shader-cache") == 0) clearShaderCache = true;
+    }
+    if (gpuCulling && !synchronous) {
+        std::cout << "GPU culling reads the scene while it draws, so frames are drawn on the main thread (--sync)." << std::endl;
+        synchronous = true;
+    }
+    auto startupBegin = std::chrono::steady_clock::now();
 
-int main() {
     // 1. Initialize GLFW and Window
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    // Ask for 4.3 first (storage buffers, base-instance draws); the renderer still runs on 3.3
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
     GLFWwindow* window = glfwCreateWindow(800, 600, "Force", NULL, NULL);
+    if (!window) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(800, 600, "Force", NULL, NULL);
+    }
     glfwMakeContextCurrent(window);
 
     // Hide the cursor and capture it for the 3D camera
@@ -20,14 +49,36 @@ int main() {
     gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
     glEnable(GL_DEPTH_TEST); // Enable 3D depth testing
 
+    // Linked programs are kept on disk between runs (GL 4.1+, otherwise every start compiles)
+    ShaderCache::init();
+    if (clearShaderCache) ShaderCache::clear();
+
     // 3. Instantiate and Initialize our Game
     Game myGame;
     myGame.init(window);
+    myGame.renderer.gpuCulling = gpuCulling;
+
+    // How long startup took, and how much of it went into shaders
+    const ShaderCacheStats& shaders = ShaderCache::stats;
+    std::cout << "[Startup] " << std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startupBegin).count()
+              << " ms | shaders: " << shaders.hits << " from the binary cache in " << shaders.loadMs << " ms, "
+              << shaders.compiles << " compiled in " << shaders.compileMs << " ms (" << shaders.stored << " stored, "
+              << shaders.rejected << " rejected), " << shaders.duplicates << " duplicate loads shared | variants: "
+              << ShaderVariants::stats.variants << " built from " << ShaderVariants::stats.sets << " sets in "
+              << ShaderVariants::stats.buildMs << " ms" << std::endl;
 
     // Store the Game pointer inside the window for our mouse callback
     glfwSetWindowUserPointer(window, &myGame);
 
-    // 4. The Master Game Loop
+    // 4. Hand the context to the render thread: from here on this thread only simulates
+    //    and extracts, and the render thread draws the frame before while it does
+    RenderThread renderThread;
+    if (!synchronous) {
+        myGame.renderer.renderThread = true;
+        renderThread.start(window, [&myGame](const FramePacket& packet) { myGame.renderFrame(packet); });
+    }
+
+    // 5. The Master Game Loop
     while (!glfwWindowShouldClose(window)) {
         // Calculate deltaTime
         float currentFrame = static_cast<float>(glfwGetTime());
@@ -37,12 +88,20 @@ int main() {
         // Execute Engine Stages
         myGame.processInput(window);
         myGame.update();
-        myGame.render();
 
-        glfwSwapBuffers(window);
+        if (renderThread.isRunning()) {
+            myGame.extractFrame(renderThread.beginPacket());
+            renderThread.submit();
+        } else {
+            myGame.render();
+            glfwSwapBuffers(window);
+        }
+
         glfwPollEvents();
     }
 
+    // The context comes back to this thread before the window goes
+    renderThread.stop();
     glfwTerminate();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,116 @@
+// Benchmarks the render-side BVH (DynamicAABBTree) at 10k/100k/1M objects:
+// build, update (10% of the objects move each frame) and frustum query,
+// against a flat loop over every box. Also checks both find the same objects.
+// Build: g++ -std=c++17 -O2 -I../include bvh_benchmark.cpp ../src/DynamicAABBTree.cpp
+
+#include "../include/DynamicAABBTree.h"
+
+#include <glm/glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int failures = 0;
+
+static void runBenchmark(int objectCount, std::mt19937& rng) {
+    // Objects spread over a square world that grows with the count (same density)
+    float worldSize = std::sqrt(static_cast<float>(objectCount)) * 4.0f;
+    std::uniform_real_distribution<float> position(-worldSize * 0.5f, worldSize * 0.5f);
+    std::uniform_real_distribution<float> height(0.0f, 20.0f);
+    std::uniform_real_distribution<float> step(-0.05f, 0.05f);
+
+    std::vector<AABB> boxes(objectCount);
+    for (auto& box : boxes) {
+        glm::vec3 center(position(rng), height(rng), position(rng));
+        box.min = center - glm::vec3(0.5f);
+        box.max = center + glm::vec3(0.5f);
+    }
+
+    // 1. Build
+    DynamicAABBTree tree;
+    std::vector<int> proxies(objectCount);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < objectCount; ++i) {
+        proxies[i] = tree.createProxy(boxes[i], reinterpret_cast<void*>(static_cast<intptr_t>(i)));
+    }
+    double buildTime = millisecondsSince(start);
+
+    // 2. Update: 10% of the objects move a frame's worth (most stay inside their fat box)
+    const int frames = 10;
+    int moved = objectCount / 10;
+    int reinserted = 0;
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; ++frame) {
+        for (int i = 0; i < moved; ++i) {
+            int index = (i * 7919) % objectCount;
+            glm::vec3 offset(step(rng), 0.0f, step(rng));
+            boxes[index].min += offset;
+            boxes[index].max += offset;
+            if (tree.moveProxy(proxies[index], boxes[index])) reinserted++;
+        }
+    }
+    double updateTime = millisecondsSince(start) / frames;
+
+    // 3. Query with a camera looking across the world
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 10.0f, worldSize * 0.5f), glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+    Frustum frustum(projection * view);
+
+    const int queries = 10;
+    size_t treeHits = 0;
+    start = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; ++q) {
+        treeHits = 0;
+        tree.query(frustum, [&](void*) { treeHits++; });
+    }
+    double queryTime = millisecondsSince(start) / queries;
+
+    size_t flatHits = 0;
+    start = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; ++q) {
+        flatHits = 0;
+        for (int i = 0; i < objectCount; ++i) {
+            if (frustum.intersects(tree.getFatAABB(proxies[i]))) flatHits++;
+        }
+    }
+    double flatTime = millisecondsSince(start) / queries;
+
+    std::cout << objectCount << " objects: build " << buildTime << " ms"
+              << " | update " << updateTime << " ms/frame (" << moved << " moved, " << reinserted / frames << " reinserted)"
+              << " | query " << queryTime << " ms, " << tree.getNodesVisited() << " nodes visited"
+              << " | flat loop " << flatTime << " ms"
+              << " | " << treeHits << " visible, tree height " << tree.getHeight() << std::endl;
+
+    if (treeHits != flatHits) {
+        std::cout << "FAIL: tree found " << treeHits << " objects, flat loop " << flatHits << std::endl;
+        failures++;
+    }
+
+    // 4. Removing everything leaves an empty tree
+    for (int proxy : proxies) tree.destroyProxy(proxy);
+    if (tree.getProxyCount() != 0 || tree.getHeight() != 0) {
+        std::cout << "FAIL: tree not empty after removing every proxy" << std::endl;
+        failures++;
+    }
+}
+
+int main() {
+    std::cout << "Starting BVH Benchmark..." << std::endl;
+    std::mt19937 rng(42);
+
+    runBenchmark(10000, rng);
+    runBenchmark(100000, rng);
+    runBenchmark(1000000, rng);
+
+    if (failures == 0) {
+        std::cout << "SUCCESS: BVH queries match the flat loop!" << std::endl;
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,101 @@
+// Sorts random point lights into clusters (LightClusters) and checks that every
+// light reaching a point is listed in that point's cluster, and that the range
+// really is where a light fades below the cutoff. Then times 4096 lights.
+// Build: g++ -std=c++17 -O2 -I../include clustered_lights.cpp ../src/LightClusters.cpp ../src/JobSystem.cpp -lpthread
+
+#include "../include/LightClusters.h"
+#include "../include/JobSystem.h"
+
+#include <glm/glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+static int failures = 0;
+
+static void expect(bool condition, const char* what) {
+    if (!condition) {
+        std::cout << "FAIL: " << what << std::endl;
+        failures++;
+    }
+}
+
+static std::vector<ClusterLight> randomLights(size_t count, std::mt19937& rng) {
+    std::uniform_real_distribution<float> position(-40.0f, 40.0f), channel(0.2f, 1.0f), quadratic(0.5f, 4.0f);
+    std::vector<ClusterLight> lights(count);
+    for (ClusterLight& light : lights) {
+        glm::vec3 color(channel(rng), channel(rng), channel(rng));
+        glm::vec3 attenuation(1.0f, 0.09f, quadratic(rng));
+        float range = LightClusters::lightRange(color, 1.0f, attenuation.x, attenuation.y, attenuation.z);
+        light.positionRange = glm::vec4(position(rng), position(rng) * 0.25f, position(rng) - 40.0f, range);
+        light.colorIntensity = glm::vec4(color, 1.0f);
+        light.attenuation = glm::vec4(attenuation, 0.0f);
+    }
+    return lights;
+}
+
+int main() {
+    std::cout << "Starting Clustered Lights Test..." << std::endl;
+
+    // 1. The range is where the brightest channel drops to the cutoff
+    float range = LightClusters::lightRange(glm::vec3(1.0f, 0.5f, 0.25f), 2.0f, 1.0f, 0.09f, 0.032f);
+    float atRange = 2.0f / (1.0f + 0.09f * range + 0.032f * range * range);
+    expect(std::fabs(atRange - LightClusters::Cutoff) < 1e-4f, "lightRange solves the attenuation for the cutoff");
+    expect(LightClusters::lightRange(glm::vec3(0.001f), 1.0f, 1.0f, 0.0f, 1.0f) == 0.0f, "a light dimmer than the cutoff has no range");
+
+    // 2. Random lights around a camera at the origin looking down -Z
+    std::mt19937 rng(7);
+    std::vector<ClusterLight> lights = randomLights(512, rng);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    LightClusters clusters;
+    clusters.build(lights, view, projection, 0.1f, 100.0f, 1280, 720);
+
+    // 3. Every light that reaches a random visible point must be in its cluster
+    const std::vector<glm::uvec2>& grid = clusters.getClusters();
+    const std::vector<uint32_t>& indices = clusters.getLightIndices();
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f), depth(0.2f, 90.0f);
+    size_t points = 0, checked = 0;
+    bool complete = true;
+    while (points < 20000) {
+        float z = depth(rng);
+        glm::vec3 point(unit(rng) * z, unit(rng) * z * 0.6f, -z);
+        int cluster = clusters.clusterAt(point, projection);
+        if (cluster < 0) continue;
+        points++;
+
+        glm::uvec2 list = grid[cluster];
+        for (uint32_t i = 0; i < lights.size(); ++i) {
+            if (glm::length(point - glm::vec3(lights[i].positionRange)) >= lights[i].positionRange.w) continue;
+            checked++;
+            if (std::find(indices.begin() + list.x, indices.begin() + list.x + list.y, i) == indices.begin() + list.x + list.y) {
+                complete = false;
+            }
+        }
+    }
+    expect(checked > 0, "some points are lit");
+    expect(complete, "every cluster lists all the lights that reach it");
+
+    // 4. 4096 lights, the size clustered lighting is meant for
+    std::vector<ClusterLight> many = randomLights(4096, rng);
+    clusters.build(many, view, projection, 0.1f, 100.0f, 1920, 1080);
+    const int runs = 20;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i) {
+        clusters.build(many, view, projection, 0.1f, 100.0f, 1920, 1080);
+    }
+    double buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / runs;
+
+    std::cout << points << " points, " << checked << " light hits checked"
+              << " | 4096 lights: " << buildTime << " ms per build on " << JobSystem::getThreadCount() << " threads, "
+              << clusters.getLightIndices().size() << " assignments, max " << clusters.getMaxLightsPerCluster()
+              << " per cluster" << std::endl;
+
+    if (failures == 0) {
+        std::cout << "SUCCESS: Clustered lights work!" << std::endl;
+        return 0;
+    }
+    return 1;
+}
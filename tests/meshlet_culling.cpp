@@ -0,0 +1,133 @@
+// Splits a dense sphere into meshlets (MeshletBuilder) and checks the limits,
+// that the reordered index list still holds every triangle, and that every
+// meshlet rejected by its normal cone really faces away from the camera.
+// Then counts the triangles a close-up camera submits before and after culling.
+// Build: g++ -std=c++17 -O2 -I../include meshlet_culling.cpp ../src/MeshletBuilder.cpp
+
+#include "../include/MeshletBuilder.h"
+#include "../include/Frustum.h"
+
+#include <glm/glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <set>
+#include <tuple>
+
+static int failures = 0;
+
+static void expect(bool condition, const char* what) {
+    if (!condition) {
+        std::cout << "FAIL: " << what << std::endl;
+        failures++;
+    }
+}
+
+// A UV sphere of radius 1, positions only
+static void buildSphere(int segments, std::vector<float>& vertices, std::vector<unsigned int>& indices) {
+    const float pi = 3.14159265f;
+    for (int y = 0; y <= segments; ++y) {
+        for (int x = 0; x <= segments * 2; ++x) {
+            float theta = static_cast<float>(y) / segments * pi;
+            float phi = static_cast<float>(x) / (segments * 2) * 2.0f * pi;
+            vertices.push_back(std::sin(theta) * std::cos(phi));
+            vertices.push_back(std::cos(theta));
+            vertices.push_back(std::sin(theta) * std::sin(phi));
+        }
+    }
+    int row = segments * 2 + 1;
+    for (int y = 0; y < segments; ++y) {
+        for (int x = 0; x < segments * 2; ++x) {
+            unsigned int a = y * row + x, b = a + 1, c = a + row, d = c + 1;
+            // Counter-clockwise seen from outside
+            if (y != 0) { indices.push_back(a); indices.push_back(b); indices.push_back(c); }
+            if (y != segments - 1) { indices.push_back(b); indices.push_back(d); indices.push_back(c); }
+        }
+    }
+}
+
+static glm::vec3 position(const std::vector<float>& vertices, unsigned int index) {
+    return glm::vec3(vertices[index * 3], vertices[index * 3 + 1], vertices[index * 3 + 2]);
+}
+
+int main() {
+    std::cout << "Starting Meshlet Culling Test..." << std::endl;
+
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    buildSphere(128, vertices, indices);
+    std::vector<unsigned int> original = indices;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Meshlet> meshlets = MeshletBuilder::build(vertices, 3, indices);
+    double buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // 1. Limits, and the meshlets tile the index list in order
+    unsigned int next = 0;
+    bool withinLimits = true, contiguous = true;
+    for (const Meshlet& meshlet : meshlets) {
+        std::set<unsigned int> unique(indices.begin() + meshlet.firstIndex, indices.begin() + meshlet.firstIndex + meshlet.indexCount);
+        withinLimits = withinLimits && unique.size() <= MeshletBuilder::MaxVertices && meshlet.indexCount / 3 <= MeshletBuilder::MaxTriangles;
+        contiguous = contiguous && meshlet.firstIndex == next;
+        next = meshlet.firstIndex + meshlet.indexCount;
+    }
+    expect(withinLimits, "meshlets stay within the vertex and triangle limits");
+    expect(contiguous && next == indices.size(), "meshlets cover the index list in order");
+
+    // 2. Same triangles with the same winding, just reordered
+    auto rotated = [](const std::vector<unsigned int>& list) {
+        std::multiset<std::tuple<unsigned int, unsigned int, unsigned int>> triangles;
+        for (size_t i = 0; i < list.size(); i += 3) {
+            unsigned int a = list[i], b = list[i + 1], c = list[i + 2];
+            // Start each triangle at its smallest index so rotations compare equal
+            if (b < a && b < c) { std::swap(a, b); std::swap(b, c); }
+            else if (c < a && c < b) { std::swap(a, c); std::swap(b, c); }
+            triangles.insert(std::make_tuple(a, b, c));
+        }
+        return triangles;
+    };
+    expect(rotated(indices) == rotated(original), "reordering keeps every triangle and its winding");
+
+    // 3. A camera 3 units from the center, looking at it
+    glm::vec3 camera(0.0f, 0.0f, 3.0f);
+    glm::mat4 view = glm::lookAt(camera, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(30.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+    Frustum frustum(projection * view);
+
+    size_t coneCulled = 0, frustumCulled = 0, submitted = 0, backFacing = 0;
+    bool conesHonest = true;
+    for (const Meshlet& meshlet : meshlets) {
+        for (unsigned int i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3) {
+            glm::vec3 a = position(vertices, indices[i]), b = position(vertices, indices[i + 1]), c = position(vertices, indices[i + 2]);
+            if (glm::dot(glm::cross(b - a, c - a), camera - a) <= 0.0f) backFacing++;
+        }
+
+        if (!frustum.intersects(meshlet.sphere)) {
+            frustumCulled++;
+        } else if (meshlet.isBackFacing(camera)) {
+            coneCulled++;
+            // Every triangle of a rejected meshlet must face away (or be edge-on)
+            for (unsigned int i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3) {
+                glm::vec3 a = position(vertices, indices[i]), b = position(vertices, indices[i + 1]), c = position(vertices, indices[i + 2]);
+                glm::vec3 normal = glm::cross(b - a, c - a);
+                if (glm::dot(normal, camera - a) > 1e-5f * glm::length(normal)) conesHonest = false;
+            }
+        } else {
+            submitted += meshlet.indexCount / 3;
+        }
+    }
+    expect(conesHonest, "cone culling only rejects back-facing meshlets");
+    expect(coneCulled > meshlets.size() / 3, "the far side of the sphere is rejected by the cones");
+
+    std::cout << indices.size() / 3 << " triangles in " << meshlets.size() << " meshlets (" << buildTime << " ms)"
+              << " | culled by frustum: " << frustumCulled << ", by cone: " << coneCulled
+              << " | triangles submitted: " << submitted << " of " << indices.size() / 3
+              << " (" << backFacing << " face away)" << std::endl;
+
+    if (failures == 0) {
+        std::cout << "SUCCESS: Meshlet culling works!" << std::endl;
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,130 @@
+// Checks the CPU occlusion culler (OcclusionCuller) on a wall with boxes around it,
+// then times rasterizing a city of box-shaped occluders at 256x128 and testing
+// 10k objects against it.
+// Build: g++ -std=c++17 -O2 -I../include occlusion_culling.cpp ../src/OcclusionCuller.cpp ../src/JobSystem.cpp -lpthread
+
+#include "../include/OcclusionCuller.h"
+#include "../include/JobSystem.h"
+
+#include <glm/glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+static int failures = 0;
+
+static void expect(bool condition, const char* what) {
+    if (!condition) {
+        std::cout << "FAIL: " << what << std::endl;
+        failures++;
+    }
+}
+
+static AABB boxAt(const glm::vec3& center, float halfSize) {
+    AABB box;
+    box.min = center - glm::vec3(halfSize);
+    box.max = center + glm::vec3(halfSize);
+    return box;
+}
+
+// A unit cube around the origin, 12 triangles
+static const glm::vec3 cubePositions[8] = {
+    { -0.5f, -0.5f, -0.5f }, { 0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, -0.5f }, { -0.5f, 0.5f, -0.5f },
+    { -0.5f, -0.5f, 0.5f },  { 0.5f, -0.5f, 0.5f },  { 0.5f, 0.5f, 0.5f },  { -0.5f, 0.5f, 0.5f },
+};
+static const unsigned int cubeIndices[36] = {
+    0, 1, 2, 0, 2, 3,  4, 6, 5, 4, 7, 6,  0, 4, 5, 0, 5, 1,
+    3, 2, 6, 3, 6, 7,  0, 3, 7, 0, 7, 4,  1, 5, 6, 1, 6, 2,
+};
+
+static void testWall() {
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f);
+
+    // A 10 x 6 wall, 10 units in front of the camera
+    glm::vec3 wall[4] = { { -5.0f, -3.0f, -10.0f }, { 5.0f, -3.0f, -10.0f }, { 5.0f, 3.0f, -10.0f }, { -5.0f, 3.0f, -10.0f } };
+    unsigned int wallIndices[6] = { 0, 1, 2, 0, 2, 3 };
+
+    OcclusionCuller culler;
+    culler.beginFrame(projection * view);
+    culler.addOccluder(wall, wallIndices, 6, glm::mat4(1.0f));
+    culler.rasterize();
+
+    // The middle of the wall is at depth 10
+    const float* depth = culler.getDepth();
+    float center = depth[(OcclusionCuller::Height / 2) * OcclusionCuller::Width + OcclusionCuller::Width / 2];
+    expect(std::fabs(center - 0.1f) < 1e-4f, "wall depth at the screen center is 1/10");
+    expect(depth[0] == 0.0f, "corner pixel outside the wall is empty");
+
+    expect(culler.isOccluded(boxAt(glm::vec3(0.0f, 0.0f, -20.0f), 1.0f)), "box straight behind the wall is hidden");
+    expect(!culler.isOccluded(boxAt(glm::vec3(0.0f, 0.0f, -5.0f), 1.0f)), "box in front of the wall is visible");
+    expect(!culler.isOccluded(boxAt(glm::vec3(0.0f, 0.0f, -10.5f), 1.0f)), "box cutting through the wall is visible");
+    expect(!culler.isOccluded(boxAt(glm::vec3(9.5f, 0.0f, -20.0f), 1.0f)), "box peeking out beside the wall is visible");
+    expect(!culler.isOccluded(boxAt(glm::vec3(0.0f, 0.0f, 0.0f), 1.0f)), "box around the camera is visible");
+
+    // A wall crossing the near plane still hides what is behind it
+    glm::vec3 floorWall[4] = { { -5.0f, -3.0f, 2.0f }, { 5.0f, -3.0f, 2.0f }, { 5.0f, 3.0f, -20.0f }, { -5.0f, 3.0f, -20.0f } };
+    culler.beginFrame(projection * view);
+    culler.addOccluder(floorWall, wallIndices, 6, glm::mat4(1.0f));
+    culler.rasterize();
+    expect(culler.isOccluded(boxAt(glm::vec3(0.0f, 0.0f, -40.0f), 1.0f)), "near-clipped wall hides a box behind it");
+}
+
+static void benchmark() {
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f, 2.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+
+    // 1. A city: 1000 buildings on a grid in front of the camera
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> height(4.0f, 30.0f);
+    std::vector<glm::mat4> buildings;
+    for (int x = -20; x < 20; ++x) {
+        for (int z = 1; z <= 25; ++z) {
+            float h = height(rng);
+            glm::mat4 world = glm::translate(glm::mat4(1.0f), glm::vec3(x * 12.0f, h * 0.5f, -z * 12.0f));
+            buildings.push_back(glm::scale(world, glm::vec3(8.0f, h, 8.0f)));
+        }
+    }
+
+    // 2. 10k small props scattered through the streets
+    std::uniform_real_distribution<float> spread(-240.0f, 240.0f);
+    std::uniform_real_distribution<float> depth(-300.0f, -5.0f);
+    std::vector<AABB> props;
+    for (int i = 0; i < 10000; ++i) props.push_back(boxAt(glm::vec3(spread(rng), 1.0f, depth(rng)), 1.0f));
+
+    OcclusionCuller culler;
+    const int frames = 20;
+    double rasterTime = 0.0, testTime = 0.0;
+    int hidden = 0;
+    for (int frame = 0; frame < frames; ++frame) {
+        auto start = std::chrono::steady_clock::now();
+        culler.beginFrame(projection * view);
+        for (const auto& world : buildings) culler.addOccluder(cubePositions, cubeIndices, 36, world);
+        culler.rasterize();
+        rasterTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        hidden = 0;
+        for (const auto& prop : props) hidden += culler.isOccluded(prop) ? 1 : 0;
+        testTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::cout << buildings.size() << " occluders (" << culler.getTrianglesRasterized() << " triangles) on "
+              << JobSystem::getThreadCount() << " threads: raster " << rasterTime / frames << " ms"
+              << " | " << props.size() << " boxes tested in " << testTime / frames << " ms, "
+              << hidden << " hidden" << std::endl;
+    expect(hidden > 0, "buildings hide some of the props");
+}
+
+int main() {
+    std::cout << "Starting Occlusion Culling Test..." << std::endl;
+    testWall();
+    benchmark();
+
+    if (failures == 0) {
+        std::cout << "SUCCESS: Occlusion culling works!" << std::endl;
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,71 @@
+// Checks radixSortByKey against std::stable_sort on render-queue-like keys.
+// Build: g++ -std=c++17 -I../include radix_sort.cpp
+
+#include "../include/RadixSort.h"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+struct Packet {
+    uint64_t key;
+    uint32_t order; // Submission order, to check stability
+};
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    if (!condition) {
+        std::cout << "FAIL: " << what << std::endl;
+        failures++;
+    }
+}
+
+static bool sameOrder(const std::vector<Packet>& a, const std::vector<Packet>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].key != b[i].key || a[i].order != b[i].order) return false;
+    }
+    return true;
+}
+
+static void sortBoth(std::vector<Packet> packets, const char* what) {
+    std::vector<Packet> expected = packets;
+    std::stable_sort(expected.begin(), expected.end(), [](const Packet& a, const Packet& b) { return a.key < b.key; });
+
+    std::vector<Packet> scratch;
+    radixSortByKey(packets, scratch);
+    check(sameOrder(packets, expected), what);
+}
+
+int main() {
+    std::cout << "Starting Radix Sort Test..." << std::endl;
+    std::mt19937_64 rng(1234);
+
+    // 1. Fully random keys (all eight passes run)
+    std::vector<Packet> packets;
+    for (uint32_t i = 0; i < 10000; ++i) packets.push_back({rng(), i});
+    sortBoth(packets, "random keys");
+
+    // 2. Few distinct states and many duplicates, like a real queue (most passes skipped)
+    packets.clear();
+    for (uint32_t i = 0; i < 10000; ++i) {
+        uint64_t state = rng() % 6;
+        uint64_t depth = rng() % 16;
+        packets.push_back({(state << 52) | depth, i});
+    }
+    sortBoth(packets, "duplicate keys stay in submission order");
+
+    // 3. Identical keys and tiny inputs
+    packets.assign(100, {42, 0});
+    for (uint32_t i = 0; i < packets.size(); ++i) packets[i].order = i;
+    sortBoth(packets, "identical keys");
+    sortBoth({}, "empty queue");
+    sortBoth({{7, 0}}, "single packet");
+
+    if (failures == 0) {
+        std::cout << "SUCCESS: Radix sort matches std::stable_sort!" << std::endl;
+        return 0;
+    }
+    return 1;
+}
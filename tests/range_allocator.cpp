@@ -0,0 +1,143 @@
+// Checks the free list behind the GeometryPool (RangeAllocator): first fit,
+// merging of freed neighbours, growth, and that compact() packs the live
+// ranges without losing or overlapping any. Then churns random mesh-sized
+// allocations against a plain ownership array and times it.
+// Build: g++ -std=c++17 -O2 -I../include range_allocator.cpp ../src/RangeAllocator.cpp
+
+#include "../include/RangeAllocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+static int failures = 0;
+
+static void expect(bool condition, const char* what) {
+    if (!condition) {
+        std::cout << "FAIL: " << what << std::endl;
+        failures++;
+    }
+}
+
+struct Live {
+    uint32_t offset;
+    uint32_t size;
+};
+
+// Every live range inside the space, none overlapping, and the counters agreeing
+static bool consistent(const RangeAllocator& allocator, const std::vector<Live>& live) {
+    std::vector<int> owner(allocator.getCapacity(), -1);
+    uint32_t used = 0;
+    for (size_t i = 0; i < live.size(); ++i) {
+        if (live[i].offset + live[i].size > allocator.getCapacity()) return false;
+        for (uint32_t j = live[i].offset; j < live[i].offset + live[i].size; ++j) {
+            if (owner[j] != -1) return false;
+            owner[j] = static_cast<int>(i);
+        }
+        used += live[i].size;
+    }
+    return used == allocator.getUsed() && live.size() == allocator.getAllocationCount();
+}
+
+int main() {
+    // 1. First fit, and freed neighbours merge back into one range
+    RangeAllocator allocator(100);
+    uint32_t a = allocator.allocate(10);
+    uint32_t b = allocator.allocate(20);
+    uint32_t c = allocator.allocate(30);
+    expect(a == 0 && b == 10 && c == 30, "allocations are packed from the start");
+    expect(allocator.allocate(50) == RangeAllocator::Invalid, "no hole is big enough for 50 of the 40 left");
+
+    allocator.free(b);
+    expect(allocator.getFreeRangeCount() == 2, "a freed middle range is its own hole");
+    expect(allocator.allocate(15) == 10, "first fit takes the lowest hole that is big enough");
+    allocator.free(10);
+    allocator.free(a);
+    expect(allocator.getFreeRangeCount() == 2 && allocator.getLargestFreeRange() == 40, "freeing next to a hole merges them");
+    allocator.free(c);
+    expect(allocator.getFreeRangeCount() == 1 && allocator.getUsed() == 0, "everything freed is one range again");
+    expect(allocator.getFragmentation() == 0.0f, "a single free range isn't fragmented");
+
+    // 2. Growing adds to the last hole; live offsets don't move
+    RangeAllocator growing(16);
+    uint32_t first = growing.allocate(8);
+    uint32_t second = growing.allocate(8);
+    growing.free(first);
+    growing.grow(32);
+    expect(growing.getFreeRangeCount() == 2 && growing.getLargestFreeRange() == 16, "the new space joins the tail");
+    expect(growing.allocate(12) == 16 && second == 8, "grown space is used after the holes that are too small");
+
+    // 3. Compacting slides the live ranges down in order and reports every move
+    RangeAllocator holes(64);
+    std::vector<Live> live;
+    for (int i = 0; i < 8; ++i) live.push_back({ holes.allocate(8), 8 });
+    for (int i = 0; i < 8; i += 2) holes.free(live[i].offset);
+    live = { live[1], live[3], live[5], live[7] };
+    expect(holes.getFragmentation() > 0.5f, "alternating holes are fragmented");
+
+    std::vector<RangeAllocator::Move> moves = holes.compact();
+    bool ordered = true;
+    for (const RangeAllocator::Move& move : moves) {
+        if (move.to >= move.from) ordered = false;
+        for (Live& range : live) {
+            if (range.offset == move.from) range.offset = move.to;
+        }
+    }
+    expect(moves.size() == 4 && ordered, "every live range moves down");
+    expect(consistent(holes, live), "compacted ranges don't overlap");
+    expect(holes.getFreeRangeCount() == 1 && holes.getLargestFreeRange() == 32, "all the free space ends up at the end");
+
+    // 4. Random churn: meshes of 24 to 20k vertices come and go, the allocator grows when it is
+    //    full and compacts once fragmented, and the live ranges never overlap
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<uint32_t> size(24, 20000);
+    RangeAllocator pool(1 << 16);
+    live.clear();
+    bool valid = true;
+    size_t grows = 0, compactions = 0, moved = 0;
+    const int operations = 20000;
+    auto start = std::chrono::steady_clock::now();
+    for (int op = 0; op < operations; ++op) {
+        if (live.empty() || rng() % 100 < 55) {
+            uint32_t count = size(rng);
+            uint32_t offset = pool.allocate(count);
+            if (offset == RangeAllocator::Invalid) {
+                uint32_t capacity = pool.getCapacity();
+                while (capacity < pool.getCapacity() + count) capacity *= 2;
+                pool.grow(capacity);
+                offset = pool.allocate(count);
+                grows++;
+            }
+            live.push_back({ offset, count });
+        } else {
+            size_t index = rng() % live.size();
+            pool.free(live[index].offset);
+            live[index] = live.back();
+            live.pop_back();
+        }
+
+        if (pool.getFragmentation() > 0.5f) {
+            for (const RangeAllocator::Move& move : pool.compact()) {
+                for (Live& range : live) {
+                    if (range.offset == move.from) range.offset = move.to;
+                }
+                moved++;
+            }
+            compactions++;
+        }
+        if (op % 2000 == 0 && !consistent(pool, live)) valid = false;
+    }
+    double churnTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    expect(valid && consistent(pool, live), "random churn keeps every live range intact");
+
+    std::cout << operations << " operations in " << churnTime << " ms (checks included): " << live.size() << " live ranges, "
+              << pool.getUsed() << " of " << pool.getCapacity() << " used, " << pool.getFreeRangeCount() << " holes, "
+              << grows << " grows, " << compactions << " compactions moving " << moved << " ranges" << std::endl;
+
+    if (failures == 0) {
+        std::cout << "SUCCESS: Range allocator works!" << std::endl;
+        return 0;
+    }
+    return 1;
+}
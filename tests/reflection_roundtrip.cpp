@@ -0,0 +1,81 @@
+// Checks that the reflection tables drive text parsing, binary blobs,
+// diffing and defaults the same way the old hand-written deserializers did.
+// Build: g++ -std=c++17 -I../include -I<glfw>/include reflection_roundtrip.cpp
+
+#include "../include/ComponentRegistry.h"
+#include "../include/LightComponent.h"
+#include "../include/CameraComponent.h"
+#include "../include/ColliderComponent.h"
+#include "../include/LinearMovementComponent.h"
+
+#include <iostream>
+
+std::vector<ColliderComponent*> ColliderComponent::allColliders;
+std::vector<LightComponent*> LightComponent::allLights;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    if (!condition) {
+        std::cout << "FAIL: " << what << std::endl;
+        failures++;
+    }
+}
+
+int main() {
+    std::cout << "Starting Reflection Round-Trip Test..." << std::endl;
+
+    ComponentRegistry::registerComponent<LightComponent>("LightComponent");
+    ComponentRegistry::registerComponent<CameraComponent>("CameraComponent");
+    ComponentRegistry::registerComponent<ColliderComponent>("ColliderComponent");
+    ComponentRegistry::registerComponent<LinearMovementComponent>("LinearMovementComponent");
+
+    // 1. Text parsing keeps the old formats, trailing fields fall back to defaults
+    std::istringstream lightText("1 0.5 0.25 3");
+    auto light = std::dynamic_pointer_cast<LightComponent>(ComponentRegistry::create("LightComponent", lightText, nullptr));
+    check(light != nullptr, "light created from text");
+    check(light && light->color == glm::vec3(1.0f, 0.5f, 0.25f), "light color parsed");
+    check(light && light->intensity == 3.0f, "light intensity parsed");
+    check(light && light->linear == 0.09f, "light linear keeps default");
+
+    std::istringstream cameraText("60");
+    auto camera = std::dynamic_pointer_cast<CameraComponent>(ComponentRegistry::create("CameraComponent", cameraText, nullptr));
+    check(camera && camera->fov == 60.0f, "camera fov parsed");
+    check(camera && camera->farPlane == 100.0f, "camera far plane keeps default");
+
+    std::istringstream colliderText("1 10 1 1");
+    auto collider = std::dynamic_pointer_cast<ColliderComponent>(ComponentRegistry::create("ColliderComponent", colliderText, nullptr));
+    check(collider && collider->size == glm::vec3(1.0f, 10.0f, 1.0f) && collider->isTrigger, "collider parsed");
+
+    // 2. Required fields are still enforced
+    std::istringstream emptyText("");
+    check(ComponentRegistry::create("LinearMovementComponent", emptyText, nullptr) == nullptr, "movement without velocity rejected");
+
+    // 3. Binary blobs only carry fields that differ from the defaults
+    std::vector<uint8_t> blob;
+    check(ComponentRegistry::writeBinary(*light, blob), "light written to binary");
+    check(blob.size() == sizeof(uint32_t) + sizeof(glm::vec3) + sizeof(float), "blob holds only changed fields");
+
+    const uint8_t* cursor = blob.data();
+    auto loaded = std::dynamic_pointer_cast<LightComponent>(
+        ComponentRegistry::createFromBinary(*ComponentRegistry::findType("LightComponent"), cursor, blob.data() + blob.size(), nullptr));
+    check(loaded != nullptr, "light created from binary");
+    check(cursor == blob.data() + blob.size(), "whole blob consumed");
+
+    // 4. Diffing a round-tripped snapshot finds no changes
+    const Reflection::TypeInfo& info = LightComponent::staticTypeInfo();
+    check(loaded && Reflection::diff(info, light.get(), loaded.get()) == 0, "binary round trip is lossless");
+
+    loaded->quadratic = 0.5f;
+    check(Reflection::diff(info, light.get(), loaded.get()) == Reflection::fieldBit(Reflection::findField(info, "quadratic")), "diff reports the changed field");
+
+    // 5. Defaults can be restored
+    Reflection::resetToDefaults(info, loaded.get());
+    check(loaded->color == glm::vec3(1.0f) && loaded->intensity == 1.0f && loaded->quadratic == 0.032f, "reset to defaults");
+
+    if (failures == 0) {
+        std::cout << "SUCCESS: Reflection round trip passed!" << std::endl;
+        return 0;
+    }
+    return 1;
+}
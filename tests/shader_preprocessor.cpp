@@ -0,0 +1,100 @@
+// Checks the GLSL preprocessing behind ShaderVariants: #include expansion
+// (relative paths, nesting, each file once, #line numbering, missing files),
+// #define insertion after #version, and finding the macros a source tests.
+// Then times expanding a shader with a few includes.
+// Build: g++ -std=c++17 -O2 -I../include shader_preprocessor.cpp ../src/ShaderPreprocessor.cpp
+
+#include "../include/ShaderPreprocessor.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+static int failures = 0;
+
+static void expect(bool condition, const char* what) {
+    if (!condition) {
+        std::cout << "FAIL: " << what << std::endl;
+        failures++;
+    }
+}
+
+static void writeFile(const std::filesystem::path& path, const std::string& contents) {
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream(path) << contents;
+}
+
+static bool contains(const std::string& text, const std::string& part) {
+    return text.find(part) != std::string::npos;
+}
+
+int main() {
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "force_shader_preprocessor";
+    std::filesystem::remove_all(root);
+
+    // 1. Includes are relative to the including file, nest, and each file is expanded once
+    writeFile(root / "main.fs", "#version 330 core\n#include \"lib/lighting.glsl\"\n  #  include \"lib/common.glsl\"\nvoid main() {}\n");
+    writeFile(root / "lib/lighting.glsl", "#include \"common.glsl\"\nvec3 shade() { return COMMON; }\n");
+    writeFile(root / "lib/common.glsl", "#define COMMON vec3(1.0)\n");
+
+    std::string out;
+    std::vector<std::string> files;
+    expect(ShaderPreprocessor::loadFile((root / "main.fs").string(), out, &files), "a shader with includes loads");
+    expect(files.size() == 2, "two distinct files were included");
+    expect(contains(out, "#define COMMON vec3(1.0)") && contains(out, "vec3 shade()"), "included code is in the output");
+    expect(out.find("#define COMMON") == out.rfind("#define COMMON"), "a file included twice is expanded once");
+    expect(out.find("#include") == std::string::npos, "no #include is left");
+    expect(out.rfind("#version 330 core", 0) == 0, "#version stays the first line");
+
+    // 2. #line: the included file counts from 1 as its own source string, then the includer resumes
+    expect(contains(out, "#line 1 1\n#line 1 2\n#define COMMON"), "nested includes get their own source string numbers");
+    expect(contains(out, "#line 2 1\nvec3 shade()"), "lighting.glsl resumes on its line 2");
+    expect(contains(out, "#line 3 0\n\nvoid main()"), "the second include of common.glsl keeps the line count");
+
+    // 3. Cycles end by themselves, also one back to the loaded file (no second #version), missing files fail
+    writeFile(root / "a.glsl", "#include \"b.glsl\"\nfloat a;\n");
+    writeFile(root / "b.glsl", "#include \"a.glsl\"\nfloat b;\n");
+    expect(ShaderPreprocessor::expand("#include \"a.glsl\"\n", root.string(), out, &files) && files.size() == 2,
+           "an include cycle stops at the second visit");
+    writeFile(root / "cycle.fs", "#version 330 core\n#include \"lib/back.glsl\"\nvoid main() {}\n");
+    writeFile(root / "lib/back.glsl", "#include \"../cycle.fs\"\nfloat back;\n");
+    expect(ShaderPreprocessor::loadFile((root / "cycle.fs").string(), out, &files) && files.size() == 1,
+           "a cycle through the loaded file stops there");
+    expect(out.find("#version") == out.rfind("#version") && out.find("void main()") == out.rfind("void main()"),
+           "the loaded file is expanded once");
+    expect(!ShaderPreprocessor::expand("#include \"missing.glsl\"\n", root.string(), out), "a missing include fails");
+
+    // 4. Defines go after #version and the source keeps its line numbers
+    std::string defined = ShaderPreprocessor::addDefines("// header\n#version 430 core\nvoid main() {}\n", { "HAS_DIFFUSE_MAP", "TRANSFORM_DATA" });
+    expect(defined == "// header\n#version 430 core\n#define HAS_DIFFUSE_MAP\n#define TRANSFORM_DATA\n#line 3\nvoid main() {}\n",
+           "defines follow the #version line");
+    expect(ShaderPreprocessor::addDefines("void main() {}\n", { "X" }) == "#define X\n#line 1\nvoid main() {}\n",
+           "without #version the defines go on top");
+    expect(ShaderPreprocessor::addDefines("#version 330 core\n", {}) == "#version 330 core\n", "no defines, no change");
+
+    // 5. Only whole identifiers count as mentions
+    expect(ShaderPreprocessor::mentions("#ifdef HAS_NORMAL_MAP\n", "HAS_NORMAL_MAP"), "an #ifdef mentions its macro");
+    expect(!ShaderPreprocessor::mentions("#ifdef HAS_NORMAL_MAPS\n", "HAS_NORMAL_MAP"), "a longer name doesn't count");
+    expect(!ShaderPreprocessor::mentions("uniform float XHAS_NORMAL_MAP;\n", "HAS_NORMAL_MAP"), "a prefixed name doesn't count");
+
+    // 6. Timing: a shader with a few includes, expanded over and over
+    const int iterations = 2000;
+    size_t bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        ShaderPreprocessor::loadFile((root / "main.fs").string(), out);
+        bytes += ShaderPreprocessor::addDefines(out, { "HAS_DIFFUSE_MAP", "HAS_NORMAL_MAP" }).size();
+    }
+    double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << iterations << " expansions (files read each time) in " << time << " ms, " << time * 1000.0 / iterations
+              << " us each, " << bytes / iterations << " bytes of source" << std::endl;
+
+    std::filesystem::remove_all(root);
+
+    if (failures == 0) {
+        std::cout << "SUCCESS: Shader preprocessor works!" << std::endl;
+        return 0;
+    }
+    return 1;
+}